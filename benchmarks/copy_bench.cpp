@@ -0,0 +1,162 @@
+/*-
+ * Copyright (c) 2022-23 Simon Peter <probono@puredarwin.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Measures how fast CopyEngine copies a workload of many small files and one of a large file.
+ *
+ * Usage: copy_bench [directory] [number of small files] [size of the large file in MiB]
+ *
+ * The workloads are generated in a temporary directory inside the given directory (by default,
+ * the current one) and copied within it. The sources were just written and are therefore in the
+ * page cache; the rates are given both up to the point where CopyEngine is done and including
+ * the sync() that writes everything to the disk.
+ */
+
+#include "CopyEngine.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <cstdlib>
+#include <unistd.h>
+
+namespace {
+
+const qint64 smallFileSize = 4 * 1024;
+const qint64 chunkSize = 1024 * 1024;
+
+// Not zeros, so that no file system can store the data as holes or compress it away
+QByteArray makeData(qint64 size, int seed)
+{
+    QByteArray data(static_cast<int>(size), Qt::Uninitialized);
+    quint32 state = 2463534242u + static_cast<quint32>(seed);
+    for (int i = 0; i < data.size(); i++) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        data[i] = static_cast<char>(state);
+    }
+    return data;
+}
+
+bool writeFile(const QString &path, const QByteArray &chunk, qint64 size)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    for (qint64 written = 0; written < size; written += chunk.size()) {
+        const qint64 length = qMin<qint64>(chunk.size(), size - written);
+        if (file.write(chunk.constData(), length) != length) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Copies the files into targetDirectory with one CopyEngine, as CopyThread does, and prints the rates
+bool measure(QTextStream &out, const QString &label, const QStringList &fromPaths, const QString &targetDirectory,
+             qint64 totalBytes)
+{
+    if (!QDir().mkpath(targetDirectory)) {
+        out << "Cannot create " << targetDirectory << "\n";
+        return false;
+    }
+    sync();
+
+    CopyEngine engine;
+    QElapsedTimer timer;
+    timer.start();
+    for (const QString &fromPath : fromPaths) {
+        if (!engine.copyFile(fromPath, targetDirectory + "/" + QFileInfo(fromPath).fileName())) {
+            break;
+        }
+    }
+    const bool copied = engine.waitForDone();
+    const double copySeconds = timer.nsecsElapsed() / 1e9;
+    sync();
+    const double syncedSeconds = timer.nsecsElapsed() / 1e9;
+
+    if (!copied) {
+        out << label << ": " << engine.errorMessage() << "\n";
+        return false;
+    }
+    const double megabytes = totalBytes / (1024.0 * 1024.0);
+    out << label.leftJustified(12)
+        << QString::number(megabytes / copySeconds, 'f', 1).rightJustified(10) << " MB/s"
+        << QString::number(fromPaths.size() / copySeconds, 'f', 0).rightJustified(10) << " files/s"
+        << "   with sync:"
+        << QString::number(megabytes / syncedSeconds, 'f', 1).rightJustified(10) << " MB/s"
+        << QString::number(fromPaths.size() / syncedSeconds, 'f', 0).rightJustified(10) << " files/s\n";
+    out.flush();
+    return true;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    const QString baseDirectory = argc > 1 ? QString::fromLocal8Bit(argv[1]) : QDir::currentPath();
+    const int smallFileCount = argc > 2 ? qMax(1, atoi(argv[2])) : 10000;
+    const qint64 largeFileSize = (argc > 3 ? qMax(1, atoi(argv[3])) : 1024) * chunkSize;
+
+    QTemporaryDir directory(baseDirectory + "/copy_bench-XXXXXX");
+    if (!directory.isValid()) {
+        out << "Cannot create a temporary directory in " << baseDirectory << "\n";
+        return 1;
+    }
+
+    out << "Generating the workloads in " << directory.path() << "\n";
+    out.flush();
+    const QString smallDirectory = directory.filePath("small");
+    QDir().mkpath(smallDirectory);
+    QStringList smallPaths;
+    for (int i = 0; i < smallFileCount; i++) {
+        const QString path = smallDirectory + "/" + QString::number(i);
+        if (!writeFile(path, makeData(smallFileSize, i), smallFileSize)) {
+            out << "Cannot write " << path << "\n";
+            return 1;
+        }
+        smallPaths.append(path);
+    }
+    const QString largePath = directory.filePath("large");
+    if (!writeFile(largePath, makeData(chunkSize, -1), largeFileSize)) {
+        out << "Cannot write " << largePath << "\n";
+        return 1;
+    }
+
+    bool ok = measure(out, "small files", smallPaths, directory.filePath("small-copy"),
+                      smallFileCount * smallFileSize);
+    ok = measure(out, "large file", QStringList() << largePath, directory.filePath("large-copy"),
+                 largeFileSize) && ok;
+    return ok ? 0 : 1;
+}
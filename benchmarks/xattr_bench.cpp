@@ -0,0 +1,162 @@
+/*-
+ * Copyright (c) 2022-23 Simon Peter <probono@puredarwin.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Times reading and writing extended attributes through the system calls that
+ * ExtendedAttributes uses against running the command line tools, as Filer did before.
+ *
+ * Usage: xattr_bench [directory] [number of files]
+ *
+ * The files are created in a temporary directory inside the given directory (by default,
+ * the current one), which must be on a file system that supports extended attributes
+ * in the "user" namespace; /tmp often is not.
+ */
+
+#include "ExtendedAttributes.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QProcess>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <cstdlib>
+#include <functional>
+
+namespace {
+
+const QString attributeName = "open-with";
+const QByteArray attributeValue = "/Applications/TextEdit.app";
+
+#if defined(__linux__)
+bool writeWithProcess(const QString &path)
+{
+    QProcess process;
+    process.start("setfattr", QStringList() << "-n" << "user." + attributeName
+                                            << "-v" << QString::fromUtf8(attributeValue) << path);
+    return process.waitForFinished() && process.exitCode() == 0;
+}
+
+QByteArray readWithProcess(const QString &path)
+{
+    QProcess process;
+    process.start("getfattr", QStringList() << "--only-values" << "-n" << "user." + attributeName << path);
+    process.waitForFinished();
+    return process.readAllStandardOutput();
+}
+#else
+bool writeWithProcess(const QString &path)
+{
+    QProcess process;
+    process.start("setextattr", QStringList() << "user" << attributeName
+                                              << QString::fromUtf8(attributeValue) << path);
+    return process.waitForFinished() && process.exitCode() == 0;
+}
+
+QByteArray readWithProcess(const QString &path)
+{
+    QProcess process;
+    process.start("getextattr", QStringList() << "-q" << "user" << attributeName << path);
+    process.waitForFinished();
+    return process.readAllStandardOutput().trimmed();
+}
+#endif
+
+// Runs operation on every path and prints the time it took per file
+void measure(QTextStream &out, const QString &label, const QStringList &paths,
+             const std::function<bool(const QString &)> &operation)
+{
+    int failures = 0;
+    QElapsedTimer timer;
+    timer.start();
+    for (const QString &path : paths) {
+        if (!operation(path)) {
+            failures++;
+        }
+    }
+    const double seconds = timer.nsecsElapsed() / 1e9;
+    out << label.leftJustified(32)
+        << QString::number(seconds * 1e6 / paths.size(), 'f', 1) << " us/file  "
+        << QString::number(paths.size() / seconds, 'f', 0) << " files/s";
+    if (failures > 0) {
+        out << "  (" << failures << " failed)";
+    }
+    out << "\n";
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    const QString baseDirectory = argc > 1 ? QString::fromLocal8Bit(argv[1]) : QDir::currentPath();
+    const int count = argc > 2 ? qMax(1, atoi(argv[2])) : 1000;
+
+    QTemporaryDir directory(baseDirectory + "/xattr_bench-XXXXXX");
+    if (!directory.isValid()) {
+        out << "Cannot create a temporary directory in " << baseDirectory << "\n";
+        return 1;
+    }
+    QStringList paths;
+    for (int i = 0; i < count; i++) {
+        QString path = directory.filePath(QString::number(i));
+        QFile file(path);
+        if (!file.open(QIODevice::WriteOnly)) {
+            out << "Cannot create " << path << "\n";
+            return 1;
+        }
+        paths.append(path);
+    }
+    out << count << " files in " << directory.path() << "\n";
+
+    measure(out, "write, system calls", paths, [](const QString &path) {
+        return ExtendedAttributes(path).write(attributeName, attributeValue);
+    });
+    measure(out, "read, system calls", paths, [](const QString &path) {
+        return ExtendedAttributes(path).read(attributeName) == attributeValue;
+    });
+
+    // The whole directory in one sweep, as CustomFileSystemModel prefetches it
+    QElapsedTimer timer;
+    timer.start();
+    ExtendedAttributes::AttributeTable table = ExtendedAttributes::readDirectory(directory.path(),
+                                                                                 QStringList() << attributeName);
+    const double seconds = timer.nsecsElapsed() / 1e9;
+    out << QString("read, readDirectory()").leftJustified(32)
+        << QString::number(seconds * 1e6 / count, 'f', 1) << " us/file  "
+        << QString::number(count / seconds, 'f', 0) << " files/s  (" << table.size() << " entries)" << "\n";
+
+    measure(out, "write, command line tool", paths, [](const QString &path) {
+        return writeWithProcess(path);
+    });
+    measure(out, "read, command line tool", paths, [](const QString &path) {
+        return readWithProcess(path) == attributeValue;
+    });
+
+    return 0;
+}
@@ -0,0 +1,264 @@
+/*-
+ * Copyright (c) 2022-23 Simon Peter <probono@puredarwin.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "AccessChecker.h"
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QDebug>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace {
+
+// Shared by the threads that check one set of trees
+struct CheckState
+{
+    int fileMode;
+    int directoryMode;
+    QThreadPool *pool;  // nullptr if everything is checked on the calling thread
+    std::atomic<bool> failed;
+    QMutex mutex;
+    QList<AccessChecker::Problem> problems;
+
+    void fail(const QByteArray &path, int error)
+    {
+        QMutexLocker locker(&mutex);
+        problems.append({QFile::decodeName(path), error});
+        failed = true;
+    }
+};
+
+// Running out of file descriptors says nothing about the permissions; what cannot be opened for that
+// reason is not checked, and if there is a problem, the file operation itself will report it
+bool isOutOfDescriptors(const QByteArray &path, int error)
+{
+    if (error != EMFILE && error != ENFILE) {
+        return false;
+    }
+    qWarning() << "Cannot check" << QFile::decodeName(path) << ":" << strerror(error);
+    return true;
+}
+
+int openDirectory(int parentFd, const char *name)
+{
+    return openat(parentFd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+}
+
+void checkDirectory(CheckState &state, int directoryFd, const QByteArray &path, bool dispatch);
+
+// Opens the directory only when it is its turn, so that a directory with thousands of
+// subdirectories does not have a descriptor open for each of them at once
+class SubtreeCheck : public QRunnable
+{
+public:
+    SubtreeCheck(CheckState &state, const QByteArray &path)
+        : m_state(state), m_path(path)
+    {
+    }
+
+    void run() override
+    {
+        if (m_state.failed) {
+            return;
+        }
+        int fd = openDirectory(AT_FDCWD, m_path.constData());
+        if (fd < 0) {
+            if (!isOutOfDescriptors(m_path, errno)) {
+                m_state.fail(m_path, errno);
+            }
+            return;
+        }
+        checkDirectory(m_state, fd, m_path, false);
+    }
+
+private:
+    CheckState &m_state;
+    QByteArray m_path;
+};
+
+// Checks the entries of a directory and everything below them; takes ownership of directoryFd.
+// If dispatch is true, the subdirectories are handed to the thread pool rather than checked right away
+void checkDirectory(CheckState &state, int directoryFd, const QByteArray &path, bool dispatch)
+{
+    DIR *dir = fdopendir(directoryFd);
+    if (!dir) {
+        int error = errno;
+        ::close(directoryFd);
+        if (!isOutOfDescriptors(path, error)) {
+            state.fail(path, error);
+        }
+        return;
+    }
+
+    while (!state.failed) {
+        errno = 0;
+        struct dirent *entry = readdir(dir);
+        if (!entry) {
+            if (errno != 0) {
+                state.fail(path, errno);
+            }
+            break;
+        }
+        const char *name = entry->d_name;
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+            continue;
+        }
+
+        // Most file systems tell the type in the directory entry, which saves a stat per entry
+        unsigned char type = entry->d_type;
+        if (type == DT_UNKNOWN) {
+            struct stat st;
+            if (fstatat(dirfd(dir), name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+                state.fail(path + '/' + name, errno);
+                break;
+            }
+            type = S_ISDIR(st.st_mode) ? DT_DIR : (S_ISLNK(st.st_mode) ? DT_LNK : DT_REG);
+        }
+        if (type == DT_LNK) {
+            continue;
+        }
+
+        const bool isDirectory = type == DT_DIR;
+        if (faccessat(dirfd(dir), name, isDirectory ? state.directoryMode : state.fileMode, 0) != 0) {
+            state.fail(path + '/' + name, errno);
+            break;
+        }
+        if (!isDirectory) {
+            continue;
+        }
+
+        if (dispatch) {
+            state.pool->start(new SubtreeCheck(state, path + '/' + name));
+            continue;
+        }
+        int fd = openDirectory(dirfd(dir), name);
+        if (fd < 0) {
+            if (isOutOfDescriptors(path + '/' + name, errno)) {
+                continue;
+            }
+            state.fail(path + '/' + name, errno);
+            break;
+        }
+        checkDirectory(state, fd, path + '/' + name, false);
+    }
+
+    closedir(dir);
+}
+
+}
+
+bool AccessChecker::Report::isAccessible() const
+{
+    return problems.isEmpty();
+}
+
+bool AccessChecker::Report::isReadOnly() const
+{
+    for (const Problem &problem : problems) {
+        if (problem.error == EROFS) {
+            return true;
+        }
+    }
+    return false;
+}
+
+AccessChecker::Report AccessChecker::check(const QStringList &paths, Access access, int threadCount)
+{
+    CheckState state;
+    state.fileMode = access == Readable ? R_OK : W_OK;
+    // Directories also have to be searchable, both to be walked and to have their entries changed
+    state.directoryMode = state.fileMode | X_OK;
+    state.failed = false;
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(1, threadCount));
+    state.pool = threadCount > 1 ? &pool : nullptr;
+
+    for (const QString &path : paths) {
+        if (state.failed) {
+            break;
+        }
+        const QByteArray rootPath = QFile::encodeName(path);
+        struct stat st;
+        if (fstatat(AT_FDCWD, rootPath.constData(), &st, AT_SYMLINK_NOFOLLOW) != 0) {
+            state.fail(rootPath, errno);
+            break;
+        }
+        if (S_ISLNK(st.st_mode)) {
+            continue;
+        }
+        const bool isDirectory = S_ISDIR(st.st_mode);
+        if (faccessat(AT_FDCWD, rootPath.constData(), isDirectory ? state.directoryMode : state.fileMode, 0) != 0) {
+            state.fail(rootPath, errno);
+            break;
+        }
+        if (!isDirectory) {
+            continue;
+        }
+        int fd = openDirectory(AT_FDCWD, rootPath.constData());
+        if (fd < 0) {
+            if (isOutOfDescriptors(rootPath, errno)) {
+                continue;
+            }
+            state.fail(rootPath, errno);
+            break;
+        }
+        checkDirectory(state, fd, rootPath, state.pool != nullptr);
+    }
+
+    // The subtrees notice the failure of another one and return early
+    pool.waitForDone();
+
+    Report report;
+    report.problems = state.problems;
+    if (!report.isAccessible()) {
+        qDebug() << "Not accessible:" << report.problems.first().path << strerror(report.problems.first().error);
+    }
+    return report;
+}
+
+AccessChecker::Report AccessChecker::checkEntry(const QString &path, Access access)
+{
+    const QByteArray name = QFile::encodeName(path);
+    int mode = access == Readable ? R_OK : W_OK;
+    struct stat st;
+    if (stat(name.constData(), &st) == 0 && S_ISDIR(st.st_mode)) {
+        mode |= X_OK;
+    }
+
+    Report report;
+    if (faccessat(AT_FDCWD, name.constData(), mode, 0) != 0) {
+        report.problems.append({path, errno});
+    }
+    return report;
+}
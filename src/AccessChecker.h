@@ -0,0 +1,98 @@
+/*-
+ * Copyright (c) 2022-23 Simon Peter <probono@puredarwin.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef ACCESSCHECKER_H
+#define ACCESSCHECKER_H
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+/**
+ * @file AccessChecker.h
+ * @class AccessChecker
+ * @brief Checks whether whole directory trees can be read or written by the current user.
+ *
+ * The trees are walked with openat() and readdir(), and each entry is checked with faccessat()
+ * relative to its directory, so that no paths have to be resolved and no QFileInfo objects built.
+ * The walk stops at the first entry that is not accessible. The subdirectories of the given paths
+ * can be checked on several threads at once, which helps when the metadata is not cached yet.
+ * Symbolic links are neither checked nor followed, since what they point to is not part of the tree.
+ * Directories that cannot be opened because the process is out of file descriptors are skipped
+ * rather than reported, since that says nothing about their permissions.
+ */
+class AccessChecker
+{
+public:
+    /**
+     * @brief The kind of access to check for.
+     */
+    enum Access {
+        Readable,   ///< Files can be read and directories listed.
+        Writable    ///< Files and directories can be changed, renamed and removed.
+    };
+
+    /**
+     * @brief An entry that is not accessible.
+     */
+    struct Problem {
+        QString path;
+        int error;      ///< The errno of the check, e.g., EACCES or EROFS.
+    };
+
+    /**
+     * @brief The result of a check.
+     */
+    struct Report {
+        QList<Problem> problems;  ///< Usually one, since the check stops at the first problem.
+
+        /**
+         * @brief True if every entry of the trees is accessible.
+         */
+        bool isAccessible() const;
+
+        /**
+         * @brief True if a tree is on a read-only file system, which not even root can write to.
+         */
+        bool isReadOnly() const;
+    };
+
+    /**
+     * @brief Checks the given paths and everything below them.
+     * @param paths The roots of the trees.
+     * @param access The kind of access to check for.
+     * @param threadCount The number of threads to check subdirectories on; 1 checks on the calling thread only.
+     * @return A report that names the entries that are not accessible.
+     */
+    static Report check(const QStringList &paths, Access access, int threadCount = 1);
+
+    /**
+     * @brief Checks only the given path itself, e.g., a directory that files are to be created in.
+     */
+    static Report checkEntry(const QString &path, Access access);
+};
+
+#endif // ACCESSCHECKER_H
@@ -37,9 +37,13 @@
 
 #include "ElfSizeCalculator.h"
 #include "SqshArchiveReader.h"
+#include "SqshArchivePool.h"
+#include "IconCache.h"
+#include "FileClassifier.h"
 
 #include <DesktopFile.h>
 #include <QPainter>
+#include <QImageReader>
 
 ApplicationBundle::ApplicationBundle(const QString& path)
         : m_path(path),
@@ -50,61 +54,48 @@ ApplicationBundle::ApplicationBundle(const QString& path)
           m_executable(),
           m_arguments()
 {
-    QFileInfo fileInfo(path);
-    if (!fileInfo.exists()) {
+    // The type is determined by FileClassifier, which remembers it for as long as the file does not change
+    FileClassifier::Classification classification = FileClassifier::classify(path);
+    if (!(classification.flags & FileClassifier::Exists)) {
         return;
     }
+    m_type = classification.bundleType;
+    QFileInfo fileInfo(path);
 
-    // Check if the path is an application bundle or AppDir
-    if (fileInfo.isDir()) {
+    if (m_type == Type::AppBundle) {
         QDir dir(path);
-        // qDebug() << "Checking if" << path << "is an application bundle or AppDir";
-        if (dir.exists("Resources")
-            && QFileInfo(dir.filePath(fileInfo.completeBaseName())).isExecutable()) {
-            m_type = Type::AppBundle;
-            // qDebug() << path << "is an application bundle";
-            m_name = QFileInfo(dir.path()).completeBaseName();
-            // qDebug() << "Name:" << m_name;
-            // Check if the Resources directory contains an icon file with the same name as the dir
-            QDir resourcesDir(dir.filePath("Resources"));
-            // qDebug() << "resourcesDir: " << resourcesDir;
-            QStringList filters;
-            filters << m_name + ".png" << m_name + ".jpg" << m_name + ".svg" << m_name + ".svgz"
-                    << m_name + ".ico" << m_name + ".icns";
-            resourcesDir.setNameFilters(filters);
-            if (resourcesDir.exists()) {
-                QStringList icons = resourcesDir.entryList();
-                // qDebug() << icons;
-                if (icons.size() > 0) {
-                    m_icon = resourcesDir.filePath(icons.at(0));
-                }
-            }
-            m_executable = dir.filePath(fileInfo.completeBaseName());
-        } else if (QFileInfo(dir.filePath("AppRun")).isExecutable()) {
-            m_type = Type::AppDir;
-            // qDebug() << path << "is an AppDir";
-            m_name = QFileInfo(dir.path()).completeBaseName();
-            // qDebug() << "Name:" << m_name;
-            // Check if the AppDir contains a .DirIcon file
-            if (dir.exists(".DirIcon")) {
-                m_icon = dir.filePath(".DirIcon");
+        // qDebug() << path << "is an application bundle";
+        m_name = QFileInfo(dir.path()).completeBaseName();
+        // qDebug() << "Name:" << m_name;
+        // Check if the Resources directory contains an icon file with the same name as the dir
+        QDir resourcesDir(dir.filePath("Resources"));
+        // qDebug() << "resourcesDir: " << resourcesDir;
+        QStringList filters;
+        filters << m_name + ".png" << m_name + ".jpg" << m_name + ".svg" << m_name + ".svgz"
+                << m_name + ".ico" << m_name + ".icns";
+        resourcesDir.setNameFilters(filters);
+        if (resourcesDir.exists()) {
+            QStringList icons = resourcesDir.entryList();
+            // qDebug() << icons;
+            if (icons.size() > 0) {
+                m_icon = resourcesDir.filePath(icons.at(0));
             }
-            m_executable = dir.filePath("AppRun");
         }
-    }
-
-    // Check if the path is an AppImage
-    // TODO: Use MIME type instead of file extension; measure performance impact
-    if (fileInfo.fileName().toLower().endsWith(".appimage")) {
-        m_type = Type::AppImage;
+        m_executable = dir.filePath(fileInfo.completeBaseName());
+    } else if (m_type == Type::AppDir) {
+        QDir dir(path);
+        // qDebug() << path << "is an AppDir";
+        m_name = QFileInfo(dir.path()).completeBaseName();
+        // qDebug() << "Name:" << m_name;
+        // Check if the AppDir contains a .DirIcon file
+        if (dir.exists(".DirIcon")) {
+            m_icon = dir.filePath(".DirIcon");
+        }
+        m_executable = dir.filePath("AppRun");
+    } else if (m_type == Type::AppImage) {
         m_name = fileInfo.completeBaseName();
         m_executable = fileInfo.fileName();
-    }
-
-    // Check if the path is a desktop file
-    // TODO: Use MIME type instead of file extension; measure performance impact
-    if (fileInfo.fileName().toLower().endsWith(".desktop")) {
-        m_type = Type::DesktopFile;
+    } else if (m_type == Type::DesktopFile) {
         // qDebug() << path << "is a desktop file";
         m_name = fileInfo.completeBaseName();
         // qDebug() << "Name:" << m_name;
@@ -136,6 +127,14 @@ ApplicationBundle::Type ApplicationBundle::type() const
 }
 
 QIcon ApplicationBundle::icon() const
+{
+    if (m_type == Type::DesktopFile) {
+        return icon(QImage());
+    }
+    return icon(iconImage());
+}
+
+QIcon ApplicationBundle::icon(const QImage &image) const
 {
     // qDebug() << "m_icon:" << m_icon;
     if (m_type == Type::DesktopFile) {
@@ -146,9 +145,32 @@ QIcon ApplicationBundle::icon() const
             return QIcon::fromTheme("application-x-executable");
         }
         return icon;
+    }
+    if (image.isNull()) {
+        if (m_type != Type::AppImage && !m_icon.isEmpty() && QFile::exists(m_icon)) {
+            // A quadratic icon file is loaded by QIcon itself, so that SVG icons are rendered at the size
+            // they are drawn at and all sizes in an .icns file are used
+            return QIcon(m_icon);
+        }
+        // Get the default icon if the bundle has no icon of its own
+        return QIcon::fromTheme("application-x-executable");
+    }
+    return QIcon(QPixmap::fromImage(image));
+}
+
+QImage ApplicationBundle::iconImage() const
+{
+    if (m_type == Type::DesktopFile) {
+        // Desktop files name an icon of the icon theme
+        return QImage();
     } else if (m_type == Type::AppImage) {
+        // Reading the squashfs is expensive, so try the icon cache first
+        QImage cachedImage = IconCache::load(m_path);
+        if (!cachedImage.isNull()) {
+            return cachedImage;
+        }
         // Determine the ELF offset
-        qint64 offset = ElfSizeCalculator::calculateElfSize(m_path);
+        qint64 offset = SqshArchivePool::instance()->appImageOffset(m_path);
         // qDebug() << "offset:" << offset << "for file" << m_path;
         // Get the data of the .DirIcon file from the squashfs
         SqshArchiveReader *reader = new SqshArchiveReader(offset);
@@ -156,51 +178,45 @@ QIcon ApplicationBundle::icon() const
         QByteArray fileData = reader->readFileFromArchive(m_path, ".DirIcon");
         // qDebug() << "Finished extracting AppImage icon data for file" << m_path;
         delete reader;
-        // If fileData is empty, return default icon
         if (fileData.isEmpty()) {
-            return QIcon::fromTheme("application-x-executable");
             qDebug() << "Icon fileData is empty for file" << m_path;
+            return QImage();
         }
-        // Turn the data of the .DirIcon into a QIcon
+        // Turn the data of the .DirIcon into an image
         QImage image = QImage::fromData(fileData);
         if (image.isNull()) {
-            return QIcon::fromTheme("application-x-executable");
             qDebug() << "Icon image is null for file" << m_path;
         } else {
             qDebug() << "Icon image is not null for file" << m_path;
-            // return quadraticIcon(QPixmap::fromImage(image));
-            return QIcon(QPixmap::fromImage(image));
+            IconCache::store(m_path, image);
         }
+        return image;
     } else {
         // Get the icon from the icon file if it exists
-        if (m_icon.isEmpty()) {
-            // Get the default icon if the icon file does not exist
-            return QIcon::fromTheme("application-x-executable");
+        if (m_icon.isEmpty() || !QFile::exists(m_icon)) {
+            return QImage();
         }
-        QFile file(m_icon);
-        if (file.exists()) {
-            // If the icon is not quadratic, extend it to a quadratic shape and align it in the center bottom
-            return quadraticIcon(QIcon(m_icon));
-        } else {
-            // Get the default icon if the icon file does not exist
-            return QIcon::fromTheme("application-x-executable");
+        // Only icons that are not quadratic need to be drawn into a new image; icon() loads the others
+        QSize size = QImageReader(m_icon).size();
+        if (size.isValid() && size.width() == size.height()) {
+            return QImage();
         }
+        return quadraticImage(QImage(m_icon));
     }
 }
 
-QIcon ApplicationBundle::quadraticIcon(QIcon icon) const {
-    if (QPixmap(m_icon).width() != QPixmap(m_icon).height()) {
-        QPixmap pixmap(m_icon);
-        QPixmap squaredPixmap = QPixmap(pixmap.width(), pixmap.width());
-        squaredPixmap.fill(Qt::transparent);
-        QPainter painter(&squaredPixmap);
-        painter.setRenderHint(QPainter::Antialiasing);
-        painter.setRenderHint(QPainter::SmoothPixmapTransform);
-        painter.drawPixmap((pixmap.width() - pixmap.height()) / 2, 0, pixmap);
-        return QIcon(squaredPixmap);
-    } else {
-        return QIcon(m_icon);
+QImage ApplicationBundle::quadraticImage(const QImage &image) const {
+    // If the icon is not quadratic, extend it to a quadratic shape and align it in the center bottom
+    if (image.isNull() || image.width() == image.height()) {
+        return image;
     }
+    QImage squaredImage(image.width(), image.width(), QImage::Format_ARGB32_Premultiplied);
+    squaredImage.fill(Qt::transparent);
+    QPainter painter(&squaredImage);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform);
+    painter.drawImage((image.width() - image.height()) / 2, 0, image);
+    return squaredImage;
 }
 
 QString ApplicationBundle::iconName() const
@@ -230,7 +246,7 @@ bool ApplicationBundle::isCommandLineTool() const
     if (m_type == Type::DesktopFile) {
         return DesktopFile::isCommandLineTool(m_path);
     } else if (m_type == Type::AppImage) {
-        qint64 offset = ElfSizeCalculator::calculateElfSize(m_path);
+        qint64 offset = SqshArchivePool::instance()->appImageOffset(m_path);
         qDebug() << "Offset:" << offset << "for file" << m_path;
 
         SqshArchiveReader *reader = new SqshArchiveReader(offset);
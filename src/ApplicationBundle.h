@@ -35,6 +35,7 @@
 #include <QString>
 #include <QStringList>
 #include <QIcon>
+#include <QImage>
 #include <QObject>
 
 /**
@@ -95,6 +96,23 @@ public:
      */
     QIcon icon() const;
 
+    /**
+     * @brief Retrieves the icon of the application bundle from an image read with iconImage().
+     *        Uses the icon theme, so must be called on the GUI thread.
+     * @param image The image returned by iconImage().
+     * @return The icon.
+     */
+    QIcon icon(const QImage &image) const;
+
+    /**
+     * @brief Reads the icon image that comes with the application bundle, e.g., from the
+     *        squashfs of an AppImage. May be slow, but does not use the icon theme, so it
+     *        can be called on any thread.
+     * @return The image, or a null image if the icon comes from the icon theme or from a
+     *         quadratic icon file, which icon() loads itself.
+     */
+    QImage iconImage() const;
+
     /**
      * @brief Retrieves the name of the icon file.
      * @return The icon name.
@@ -145,7 +163,7 @@ QString m_path;         /**< The path of the application bundle. */
     QString m_icon;         /**< The path of the application's icon. */
     QString m_executable;   /**< The path to the executable. */
     QStringList m_arguments;/**< The list of arguments. */
-    QIcon quadraticIcon(QIcon icon) const;
+    QImage quadraticImage(const QImage &image) const;
 };
 
 #endif // APPLICATIONBUNDLE_H
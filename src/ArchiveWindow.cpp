@@ -0,0 +1,63 @@
+/*-
+ * Copyright (c) 2022-23 Simon Peter <probono@puredarwin.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "ArchiveWindow.h"
+
+#include <QFileInfo>
+#include <QHeaderView>
+#include <QStatusBar>
+#include <QMenuBar>
+#include <QAction>
+
+ArchiveWindow::ArchiveWindow(const QString &appImagePath, QWidget *parent)
+    : QMainWindow(parent)
+{
+    setAttribute(Qt::WA_DeleteOnClose);
+    setWindowTitle(QFileInfo(appImagePath).fileName());
+
+    m_model = new SqshArchiveModel(appImagePath, -1, this);
+
+    m_treeView = new QTreeView(this);
+    m_treeView->setModel(m_model);
+    m_treeView->setFrameStyle(QFrame::NoFrame);
+    m_treeView->setUniformRowHeights(true);
+    m_treeView->header()->setStretchLastSection(false);
+    m_treeView->header()->setSectionResizeMode(SqshArchiveModel::NameColumn, QHeaderView::Stretch);
+    m_treeView->header()->setSectionResizeMode(SqshArchiveModel::SizeColumn, QHeaderView::ResizeToContents);
+    setCentralWidget(m_treeView);
+
+    connect(m_model, &SqshArchiveModel::errorOccurred, this, [this](const QString &message) {
+        statusBar()->showMessage(message);
+    });
+
+    QMenu *fileMenu = menuBar()->addMenu(tr("File"));
+    QAction *closeAction = new QAction(tr("Close"), this);
+    closeAction->setShortcut(QKeySequence("Ctrl+W"));
+    fileMenu->addAction(closeAction);
+    connect(closeAction, &QAction::triggered, this, &QWidget::close);
+
+    resize(600, 400);
+}
@@ -0,0 +1,63 @@
+/*-
+ * Copyright (c) 2022-23 Simon Peter <probono@puredarwin.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef ARCHIVEWINDOW_H
+#define ARCHIVEWINDOW_H
+
+#include <QMainWindow>
+#include <QTreeView>
+#include "SqshArchiveModel.h"
+
+/**
+ * @file ArchiveWindow.h
+ * @class ArchiveWindow
+ * @brief A window that shows the contents of an AppImage as a read-only folder.
+ *
+ * This is what "Show Contents" opens for AppImages, which unlike AppDirs and .app bundles
+ * are files rather than directories. FileManagerMainWindow is built around QFileSystemModel:
+ * its actions work on paths in the file system, with QFileInfo, extended attributes and drag and
+ * drop, none of which exist for the entries inside a squashfs. So the contents are shown in a
+ * read-only window of their own rather than in a file manager window. The window deletes itself
+ * when it is closed.
+ */
+class ArchiveWindow : public QMainWindow
+{
+Q_OBJECT
+
+public:
+    /**
+     * @brief Constructs a window that shows the contents of an AppImage.
+     * @param appImagePath The path of the AppImage.
+     * @param parent The parent widget.
+     */
+    explicit ArchiveWindow(const QString &appImagePath, QWidget *parent = nullptr);
+
+private:
+    SqshArchiveModel *m_model;
+    QTreeView *m_treeView;
+};
+
+#endif // ARCHIVEWINDOW_H
@@ -3,6 +3,7 @@
 
 #include "CombinedIconCreator.h"
 #include "ExtendedAttributes.h"
+#include "IconCache.h"
 
 #include <QDebug>
 #include <QProcess>
@@ -12,11 +13,14 @@
 #include <QApplication>
 #include <QThread>
 #include <QImageReader>
+#include <QTemporaryFile>
 #include "AppGlobals.h"
 #include "TrashHandler.h"
 #include "Mountpoints.h"
+#include "MountTable.h"
 
 #include "Executable.h"
+#include "FileClassifier.h"
 
 CustomFileIconProvider::CustomFileIconProvider()
 {
@@ -28,37 +32,60 @@ CustomFileIconProvider::~CustomFileIconProvider()
     delete m_iconCreator;
 }
 
-QIcon CustomFileIconProvider::userIcon(const QFileInfo &info) const {
+QByteArray CustomFileIconProvider::readUserIconData(const QFileInfo &info) const {
     // Try to read the "user-icon" extended attribute
     ExtendedAttributes *ea = new ExtendedAttributes(info.absoluteFilePath());
-    QString base64IconData = ea->read("user-icon");
+    QByteArray base64IconData = ea->read("user-icon");
     delete ea;
+    return base64IconData;
+}
+
+QImage CustomFileIconProvider::userIconImage(const QByteArray &base64IconData) const {
     if (!base64IconData.isEmpty()) {
         qDebug() << "Found user-icon extended attribute";
         // qDebug() << "base64IconData: " << base64IconData;
-        QByteArray iconData = QByteArray::fromBase64(base64IconData.toUtf8());
+        QByteArray iconData = QByteArray::fromBase64(base64IconData);
         QImage image;
         image.loadFromData(iconData);
-        return (QIcon(QPixmap::fromImage(image)));
+        return image;
     } else {
-        return (QIcon());
+        return QImage();
+    }
+}
+
+QImage CustomFileIconProvider::fileIconImage(const QFileInfo &info) const
+{
+    // Application bundles and AppImages bring their own icons
+    ApplicationBundle app(info.absoluteFilePath());
+    if (app.isValid()) {
+        return app.iconImage();
+    }
+
+    // .exe files contain an ICO
+    if (info.suffix().compare("exe", Qt::CaseInsensitive) == 0) {
+        return exeIconImage(info);
     }
+
+    return QImage();
 }
 
 QIcon CustomFileIconProvider::icon(const QFileInfo &info) const
 {
     // If the user has set a custom icon, return it
-    QIcon icon = userIcon(info);
-    if (!icon.isNull()) {
-        return (icon);
+    QImage image = userIconImage(readUserIconData(info));
+    if (!image.isNull()) {
+        return QIcon(QPixmap::fromImage(image));
     }
+    return icon(info, fileIconImage(info));
+}
 
+QIcon CustomFileIconProvider::icon(const QFileInfo &info, const QImage &fileImage) const
+{
     // Check if the item is an application bundle and return the icon
-    ApplicationBundle *app = new ApplicationBundle(info.absoluteFilePath());
-    if (app->isValid()) {
-        return (app->icon());
+    ApplicationBundle app(info.absoluteFilePath());
+    if (app.isValid()) {
+        return app.icon(fileImage);
     }
-    delete app;
 
     // If ~/Desktop, ~/Documents, ~/Downloads, ~/Music, ~/Pictures, or ~/Videos, show the respective icon
     // from the current icon theme
@@ -106,22 +133,18 @@ QIcon CustomFileIconProvider::icon(const QFileInfo &info) const
         // Using Qt, get the device node of the mount point
         // and then use the device node to get the icon
         // qDebug() << "Mount point: " << info.absoluteFilePath();
-        QStorageInfo storageInfo(info.absoluteFilePath());
-        QString deviceNode = storageInfo.device();
+        MountTable *mountTable = MountTable::instance();
+        QString deviceNode = mountTable->deviceFor(info.absoluteFilePath());
         qDebug() << "Device node: " << deviceNode;
 
         // If it is not mounted, then show the folder icon
-        QStringList mountPoints;
-        for (const QStorageInfo &storage : QStorageInfo::mountedVolumes()) {
-            mountPoints << storage.rootPath();
-        }
-        if (! mountPoints.contains(absoluteFilePathWithSymLinksResolved)) {
+        if (!mountTable->isMountpoint(absoluteFilePathWithSymLinksResolved)) {
             return (QIcon::fromTheme("folder"));
         }
 
         // Set the icon depending on the file system type; unlike device nodes,
         // this also works for mounted disk images
-        QString fileSystemType = storageInfo.fileSystemType();
+        QString fileSystemType = mountTable->fsTypeFor(info.absoluteFilePath());
         qDebug() << "File system type: " << fileSystemType;
         if (fileSystemType == "iso9660" | fileSystemType == "udf" | fileSystemType == "cd9660") {
             return (QIcon::fromTheme("media-optical"));
@@ -154,7 +177,8 @@ QIcon CustomFileIconProvider::icon(const QFileInfo &info) const
             }
         }
         // If it is lacking permissions, then we want to show the locked folder icon; TODO: Use emblem instead?
-        if (!QFileInfo(info.absoluteFilePath()).isReadable() || !QFileInfo(info.absoluteFilePath()).isExecutable()) {
+        FileClassifier::Flags flags = FileClassifier::classify(info.absoluteFilePath()).flags;
+        if (!(flags & FileClassifier::IsReadable) || !(flags & FileClassifier::IsExecutable)) {
             // Try to get folder-locked icon from the current theme,
             // fall back to other icons if it is not available
             if (QIcon::hasThemeIcon("folder-locked")) {
@@ -170,7 +194,7 @@ QIcon CustomFileIconProvider::icon(const QFileInfo &info) const
     }
 
     // If we have no read permissions, show the lock icon; TODO: Use emblem instead?
-    if (!QFileInfo(info.absoluteFilePath()).isReadable()) {
+    if (!(FileClassifier::classify(info.absoluteFilePath()).flags & FileClassifier::IsReadable)) {
         // Try to get lock icon from the current theme,
         // fall back to other icons if it is not available
         if (QIcon::hasThemeIcon("lock")) {
@@ -181,47 +205,13 @@ QIcon CustomFileIconProvider::icon(const QFileInfo &info) const
     }
 
     // If it is an .exe file, then we want to show the ICO from the .exe file
-    if (info.suffix().compare("exe", Qt::CaseInsensitive) == 0)
-    {
-        qDebug() << "File extension is .exe: " << info.absoluteFilePath();
-
-        // Call icoextract executable to extract the icon
-        QProcess icoExtractProcess;
-        QStringList arguments;
-        arguments << info.absoluteFilePath() << "/tmp/icoextract.ico";
-        icoExtractProcess.start("icoextract", arguments);
-        if (!icoExtractProcess.waitForStarted() || !icoExtractProcess.waitForFinished())
-        {
-            qDebug() << "Failed to run icoextract.";
-            return QIcon::fromTheme("application-x-ms-dos-executable");
-        }
-
-        // Read the extracted icon
-        QFile iconFile("/tmp/icoextract.ico");
-        if (!iconFile.open(QIODevice::ReadOnly))
-        {
-            qDebug() << "Failed to open icon file.";
-            return QIcon::fromTheme("application-x-ms-dos-executable");
-        }
-        QByteArray iconData = iconFile.readAll();
-        iconFile.close();
-        qDebug() << "Icon data size: " << iconData.size();
-
-        // Load the icon data into a QImage
-        QImage iconImage;
-        if (iconImage.loadFromData(reinterpret_cast<const uchar*>(iconData.constData()), iconData.size(), "ico"))
-        {
-            // Create a QIcon from the QImage
-            QIcon extractedIcon;
-            // Scale to 32x32; FIXME: Extract the best fitting size from the .exe file to begin with
-            extractedIcon.addPixmap(QPixmap::fromImage(iconImage.scaled(32, 32, Qt::KeepAspectRatio, Qt::SmoothTransformation)));
-            return extractedIcon;
-        }
-        else
-        {
-            qDebug() << "Failed to load icon image.";
+    if (info.suffix().compare("exe", Qt::CaseInsensitive) == 0) {
+        if (fileImage.isNull()) {
             return QIcon::fromTheme("application-x-ms-dos-executable");
         }
+        QIcon extractedIcon;
+        extractedIcon.addPixmap(QPixmap::fromImage(fileImage));
+        return extractedIcon;
     }
 
     // If the file has the executable bit set and is not a directory,
@@ -259,19 +249,75 @@ QIcon CustomFileIconProvider::icon(const QFileInfo &info) const
 
 }
 
+QImage CustomFileIconProvider::exeIconImage(const QFileInfo &info) const
+{
+    qDebug() << "File extension is .exe: " << info.absoluteFilePath();
+
+    // Running icoextract is expensive, so try the icon cache first
+    QImage cachedImage = IconCache::load(info.absoluteFilePath());
+    if (!cachedImage.isNull()) {
+        return cachedImage;
+    }
+
+    // Call icoextract executable to extract the icon; icons are read on several
+    // threads at once, so each extraction needs its own temporary file
+    QTemporaryFile temporaryIconFile(QDir::tempPath() + "/icoextract-XXXXXX.ico");
+    if (!temporaryIconFile.open()) {
+        qDebug() << "Failed to create temporary icon file.";
+        return QImage();
+    }
+    QProcess icoExtractProcess;
+    QStringList arguments;
+    arguments << info.absoluteFilePath() << temporaryIconFile.fileName();
+    icoExtractProcess.start("icoextract", arguments);
+    if (!icoExtractProcess.waitForStarted() || !icoExtractProcess.waitForFinished())
+    {
+        qDebug() << "Failed to run icoextract.";
+        return QImage();
+    }
+
+    // Read the extracted icon
+    QFile iconFile(temporaryIconFile.fileName());
+    if (!iconFile.open(QIODevice::ReadOnly))
+    {
+        qDebug() << "Failed to open icon file.";
+        return QImage();
+    }
+    QByteArray iconData = iconFile.readAll();
+    iconFile.close();
+    qDebug() << "Icon data size: " << iconData.size();
+
+    // Load the icon data into a QImage
+    QImage iconImage;
+    if (!iconImage.loadFromData(reinterpret_cast<const uchar*>(iconData.constData()), iconData.size(), "ico"))
+    {
+        qDebug() << "Failed to load icon image.";
+        return QImage();
+    }
+    // Scale to 32x32; FIXME: Extract the best fitting size from the .exe file to begin with
+    QImage scaledImage = iconImage.scaled(32, 32, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    IconCache::store(info.absoluteFilePath(), scaledImage);
+    return scaledImage;
+}
+
 QIcon CustomFileIconProvider::documentIcon(const QFileInfo &info, QString openWith) const
 {
     // If the user has set a custom icon, return it
-    QIcon icon = userIcon(info);
-    if (!icon.isNull()) {
-        return (icon);
+    QImage image = userIconImage(readUserIconData(info));
+    if (!image.isNull()) {
+        return QIcon(QPixmap::fromImage(image));
     }
+    return documentIcon(info, openWith, fileIconImage(QFileInfo(openWith)));
+}
 
+QIcon CustomFileIconProvider::documentIcon(const QFileInfo &info, QString openWith, const QImage &applicationImage) const
+{
+    Q_UNUSED(info);
     QFileInfo openWithInfo(openWith);
-    ApplicationBundle *app = new ApplicationBundle(openWithInfo.absoluteFilePath());
-    if (app->isValid()) {
+    ApplicationBundle app(openWithInfo.absoluteFilePath());
+    if (app.isValid()) {
         // qDebug("Info: %s is a valid application bundle", qPrintable(openWith));
-        QIcon applicationIcon = QIcon(app->icon()).pixmap(16, 16);
+        QIcon applicationIcon = QIcon(app.icon(applicationImage)).pixmap(16, 16);
         if (applicationIcon.isNull()) {
             qDebug("Warning: %s does not have an icon", qPrintable(openWith));
             applicationIcon = QIcon::fromTheme("unknown");
@@ -283,5 +329,4 @@ QIcon CustomFileIconProvider::documentIcon(const QFileInfo &info, QString openWi
         // Return generic application icon from theme
         return (QIcon::fromTheme("document"));
     }
-    delete app;
-}
\ No newline at end of file
+}
@@ -2,6 +2,7 @@
 #define ICONPROVIDER_H
 
 #include <QFileIconProvider>
+#include <QImage>
 #include "CombinedIconCreator.h"
 #include <QAbstractItemModel>
 
@@ -15,12 +16,25 @@ public:
     QIcon icon(const QFileInfo &info) const override;
     QIcon documentIcon(const QFileInfo &info, QString openWith) const;
 
+    // Icons can also be made in two steps so that the slow part can run on a worker thread
+    // (see IconResolver). First, the images that come with the files are read; this may be slow,
+    // but does not use the icon theme, which must only be used on the GUI thread.
+    // userIconData is the value of the "user-icon" extended attribute, e.g., as prefetched
+    // by CustomFileSystemModel; for documents, fileIconImage() is given the application
+    QImage userIconImage(const QByteArray &userIconData) const;
+    QImage fileIconImage(const QFileInfo &info) const;
+
+    // Then, on the GUI thread, the icon is made from the image returned by fileIconImage()
+    QIcon icon(const QFileInfo &info, const QImage &fileImage) const;
+    QIcon documentIcon(const QFileInfo &info, QString openWith, const QImage &applicationImage) const;
+
     void setModel(QAbstractItemModel *model);
 
 private:
     CombinedIconCreator* m_iconCreator;
 
-    QIcon userIcon(const QFileInfo &info) const;
+    QByteArray readUserIconData(const QFileInfo &info) const;
+    QImage exeIconImage(const QFileInfo &info) const;
 };
 
 #endif // ICONPROVIDER_H
@@ -34,10 +34,63 @@
 #include "CustomFileIconProvider.h"
 #include <QRegExpValidator>
 #include "Mountpoints.h"
+#include "MountTable.h"
 #include <QApplication>
 #include <QProcess>
 #include <QTimer>
 #include <QDir>
+#include <QRunnable>
+#include <QMap>
+#include <QVector>
+
+// The extended attributes that are prefetched for every item
+static const QStringList prefetchedAttributeNames = { "open-with", "can-open", "coordinates", "user-icon" };
+
+// The number of items whose prefetched extended attributes are kept; the least recently used are dropped
+static const int maxPrefetchedItems = 65536;
+
+// The number of directories whose new items are prefetched as they appear
+static const int maxPrefetchedDirectories = 1024;
+
+/**
+ * @brief Reads the prefetched extended attributes of items of one directory on a worker thread.
+ *
+ * Reading the attributes of all items in one sweep, instead of one attribute of one item
+ * at a time whenever a view asks for a role, keeps the system calls off the GUI thread.
+ */
+class AttributePrefetchJob : public QRunnable
+{
+public:
+    AttributePrefetchJob(const CustomFileSystemModel *model, const QString &directoryPath,
+                         const QHash<QString, qint64> &metadataChangeTimes)
+        : m_model(const_cast<CustomFileSystemModel *>(model)),
+          m_directoryPath(directoryPath),
+          m_metadataChangeTimes(metadataChangeTimes)
+    {
+    }
+
+    void run() override
+    {
+        ExtendedAttributes::AttributeTable table = ExtendedAttributes::readDirectory(
+                m_directoryPath, prefetchedAttributeNames, m_metadataChangeTimes.keys());
+
+        // Hand the result over to the thread the model lives in
+        CustomFileSystemModel *model = m_model;
+        QString directoryPath = m_directoryPath;
+        QHash<QString, qint64> metadataChangeTimes = m_metadataChangeTimes;
+        QMetaObject::invokeMethod(
+                model,
+                [model, directoryPath, table, metadataChangeTimes]() {
+                    model->handleAttributesPrefetched(directoryPath, table, metadataChangeTimes);
+                },
+                Qt::QueuedConnection);
+    }
+
+private:
+    CustomFileSystemModel *m_model;
+    QString m_directoryPath;
+    QHash<QString, qint64> m_metadataChangeTimes; // By file name
+};
 
 CustomFileSystemModel::CustomFileSystemModel(QObject* parent)
         : QFileSystemModel(parent)
@@ -45,13 +98,242 @@ CustomFileSystemModel::CustomFileSystemModel(QObject* parent)
     LaunchDB ldb;
 
     m_IconProvider = new CustomFileIconProvider();
+
+    m_iconResolver = new IconResolver(m_IconProvider, this);
+    connect(m_iconResolver, &IconResolver::iconReady, this, &CustomFileSystemModel::handleIconReady);
+
+    // One worker is enough; the jobs are bound by the disk rather than by the CPU
+    m_attributeThreadPool.setMaxThreadCount(1);
+    m_prefetchedAttributes.setMaxCost(maxPrefetchedItems);
+    connect(this, &QFileSystemModel::directoryLoaded, this, &CustomFileSystemModel::handleDirectoryLoaded);
+    connect(this, &QAbstractItemModel::rowsInserted, this, &CustomFileSystemModel::handleRowsInserted);
 }
 
 CustomFileSystemModel::~CustomFileSystemModel()
 {
+    // Prefetch jobs post their results to this object, so none of them may outlive it
+    m_attributeThreadPool.clear();
+    m_attributeThreadPool.waitForDone();
+
+    // The worker threads of the resolver use the icon provider, so stop them first
+    delete m_iconResolver;
     delete m_IconProvider;
 }
 
+void CustomFileSystemModel::handleDirectoryLoaded(const QString& directoryPath)
+{
+    QModelIndex parent = index(directoryPath);
+    if (!parent.isValid()) {
+        return;
+    }
+    if (m_prefetchedDirectories.size() >= maxPrefetchedDirectories) {
+        // Items that appear in the directories we forget are prefetched once they are shown
+        m_prefetchedDirectories.clear();
+    }
+    m_prefetchedDirectories.insert(filePath(parent));
+
+    QStringList fileNames;
+    const int rows = rowCount(parent);
+    for (int row = 0; row < rows; ++row) {
+        fileNames.append(fileName(index(row, 0, parent)));
+    }
+    prefetchAttributes(filePath(parent), fileNames);
+}
+
+void CustomFileSystemModel::handleRowsInserted(const QModelIndex& parent, int first, int last)
+{
+    // Items that are inserted before the directory has finished loading are
+    // prefetched by handleDirectoryLoaded()
+    QString directoryPath = filePath(parent);
+    if (!m_prefetchedDirectories.contains(directoryPath)) {
+        return;
+    }
+
+    QStringList fileNames;
+    for (int row = first; row <= last; ++row) {
+        fileNames.append(fileName(index(row, 0, parent)));
+    }
+    prefetchAttributes(directoryPath, fileNames);
+}
+
+void CustomFileSystemModel::prefetchAttributes(const QString& directoryPath, const QStringList& fileNames) const
+{
+    QDir directory(directoryPath);
+    QHash<QString, qint64> metadataChangeTimes;
+    for (const QString &fileName : fileNames) {
+        QString path = directory.absoluteFilePath(fileName);
+        if (m_pendingAttributes.contains(path)) {
+            continue;
+        }
+        QModelIndex index = this->index(path);
+        if (!index.isValid()) {
+            continue;
+        }
+        // Remember what the model knew about the item when we asked; if the attributes
+        // change after this, so does the change time, and prefetchedAttributes() asks again
+        m_pendingAttributes.insert(path);
+        metadataChangeTimes.insert(fileName, fileInfo(index).metadataChangeTime().toMSecsSinceEpoch());
+    }
+    if (metadataChangeTimes.isEmpty()) {
+        return;
+    }
+    m_attributeThreadPool.start(new AttributePrefetchJob(this, directoryPath, metadataChangeTimes));
+}
+
+void CustomFileSystemModel::prefetchRequestedAttributes() const
+{
+    QHash<QString, QStringList> requested;
+    requested.swap(m_requestedAttributes);
+    for (auto it = requested.constBegin(); it != requested.constEnd(); ++it) {
+        prefetchAttributes(it.key(), it.value());
+    }
+}
+
+const QHash<QString, QByteArray>* CustomFileSystemModel::prefetchedAttributes(const QModelIndex& index) const
+{
+    QFileInfo fileInfo = this->fileInfo(index);
+    QString path = fileInfo.absoluteFilePath();
+    const PrefetchedAttributes *attributes = m_prefetchedAttributes.object(path);
+    if (!attributes) {
+        // Not read yet, or dropped from the cache since; ask for them together with those
+        // of the other items that are being shown, unless a prefetch is queued already
+        if (!m_pendingAttributes.contains(path)) {
+            if (m_requestedAttributes.isEmpty()) {
+                QTimer::singleShot(0, this, [this]() { prefetchRequestedAttributes(); });
+            }
+            m_requestedAttributes[fileInfo.absolutePath()].append(fileInfo.fileName());
+        }
+        return nullptr;
+    }
+    if (attributes->metadataChangeTime != fileInfo.metadataChangeTime().toMSecsSinceEpoch()) {
+        prefetchAttributes(fileInfo.absolutePath(), { fileInfo.fileName() });
+    }
+    return &attributes->values;
+}
+
+void CustomFileSystemModel::handleAttributesPrefetched(const QString& directoryPath,
+                                                       const ExtendedAttributes::AttributeTable& table,
+                                                       const QHash<QString, qint64>& metadataChangeTimes)
+{
+    QDir directory(directoryPath);
+    QModelIndex parent;
+    // The rows whose data changed, and in which roles
+    QMap<int, QVector<int>> changedRows;
+    bool updated = false;
+
+    for (auto it = metadataChangeTimes.constBegin(); it != metadataChangeTimes.constEnd(); ++it) {
+        QString path = directory.absoluteFilePath(it.key());
+        m_pendingAttributes.remove(path);
+
+        QModelIndex index = this->index(path);
+        if (!index.isValid() || !table.contains(it.key())) {
+            // The item is gone
+            m_prefetchedAttributes.remove(path);
+            continue;
+        }
+
+        const QHash<QString, QByteArray> &values = table.value(it.key());
+        QVector<int> roles;
+        const PrefetchedAttributes *previous = m_prefetchedAttributes.object(path);
+        if (!previous) {
+            // Until now, these roles had placeholders; if the attributes had been dropped from the cache,
+            // whatever was derived from them may be outdated
+            roles = { Qt::DecorationRole, OpenWithRole, CanOpenRole };
+            openWithAttributes.remove(index);
+            canOpenAttributes.remove(index);
+        } else {
+            // The attributes were read again because the item changed;
+            // drop whatever we derived from the outdated values
+            if (previous->values.value("open-with") != values.value("open-with")) {
+                openWithAttributes.remove(index);
+                roles << OpenWithRole << Qt::DecorationRole;
+            }
+            if (previous->values.value("can-open") != values.value("can-open")) {
+                canOpenAttributes.remove(index);
+                roles << CanOpenRole;
+            }
+            if (previous->values.value("coordinates") != values.value("coordinates")) {
+                // Not a role; the views lay the items out again on attributesPrefetched()
+                iconCoordinates.remove(index);
+            }
+            if (previous->values.value("user-icon") != values.value("user-icon")) {
+                m_iconResolver->invalidate(path);
+                if (!roles.contains(Qt::DecorationRole)) {
+                    roles << Qt::DecorationRole;
+                }
+            }
+        }
+        m_prefetchedAttributes.insert(path, new PrefetchedAttributes { it.value(), values });
+
+        parent = index.parent();
+        updated = true;
+        if (!roles.isEmpty()) {
+            changedRows.insert(index.row(), roles);
+        }
+    }
+
+    // All items of a job are in the same directory. Neighbouring rows that changed in the same
+    // roles share a signal; the roles tell the proxy that neither sorting nor filtering is affected
+    for (auto it = changedRows.constBegin(); it != changedRows.constEnd();) {
+        const int firstRow = it.key();
+        const QVector<int> roles = it.value();
+        int lastRow = firstRow;
+        for (++it; it != changedRows.constEnd() && it.key() == lastRow + 1 && it.value() == roles; ++it) {
+            lastRow = it.key();
+        }
+        emit dataChanged(this->index(firstRow, 0, parent), this->index(lastRow, 0, parent), roles);
+    }
+    if (updated) {
+        emit attributesPrefetched(directoryPath);
+    }
+}
+
+void CustomFileSystemModel::updatePrefetchedAttribute(const QString& filePath, const QString& attributeName,
+                                                      const QByteArray& value) const
+{
+    PrefetchedAttributes *attributes = m_prefetchedAttributes.object(filePath);
+    if (!attributes) {
+        return;
+    }
+    if (value.isEmpty()) {
+        attributes->values.remove(attributeName);
+    } else {
+        attributes->values.insert(attributeName, value);
+    }
+    // Writing the attribute changed the change time of the item, so once the model notices,
+    // prefetchedAttributes() reads the attributes again; we keep the time stamp the model
+    // knew so that this happens only once
+}
+
+void CustomFileSystemModel::handleIconReady(const QString& filePath)
+{
+    QModelIndex index = this->index(filePath);
+    if (index.isValid()) {
+        emit dataChanged(index, index, { Qt::DecorationRole });
+    }
+}
+
+QIcon CustomFileSystemModel::resolvedIcon(const QModelIndex& index) const
+{
+    QFileInfo fileInfo = this->fileInfo(index);
+    // Unlike data(index, OpenWithRole), this also works before the attributes have been prefetched
+    QString openWithString = openWith(fileInfo);
+    if (openWithString != "") {
+        return m_IconProvider->documentIcon(fileInfo, openWithString);
+    } else {
+        return m_IconProvider->icon(fileInfo);
+    }
+}
+
+void CustomFileSystemModel::refreshRow(const QModelIndex& index)
+{
+    if (!index.isValid()) {
+        return;
+    }
+    const int lastColumn = columnCount(index.parent()) - 1;
+    emit dataChanged(index.sibling(index.row(), 0), index.sibling(index.row(), lastColumn), { Qt::DisplayRole });
+}
+
 QByteArray CustomFileSystemModel::readExtendedAttribute(const QModelIndex& index, const QString& attributeName) const
 {
     if (!index.isValid() || index.column() != 0) {
@@ -81,10 +363,15 @@ QString CustomFileSystemModel::openWith(const QFileInfo& fileInfo) const {
         return openWithAttributes[index];
     }
 
-    // Otherwise, get it from the file's extended attributes
+    // Otherwise, get it from the prefetched extended attributes, or from the file if we have none
     QString attributeValue;
-    ExtendedAttributes ea(filePath);
-    attributeValue = QString(ea.read("open-with"));
+    const QHash<QString, QByteArray> *attributes = index.isValid() ? prefetchedAttributes(index) : nullptr;
+    if (attributes) {
+        attributeValue = QString(attributes->value("open-with"));
+    } else {
+        ExtendedAttributes ea(filePath);
+        attributeValue = QString(ea.read("open-with"));
+    }
 
     // If it's empty, get it from the LaunchDB
     if (attributeValue.isEmpty()) {
@@ -295,7 +582,9 @@ void CustomFileSystemModel::persistItemPositions() const {
             // Write extended attribute
             ExtendedAttributes *ea = new ExtendedAttributes(itemPath);
             QString coordinates = QString::number(iconCoordinates[index].x()) + "," + QString::number(iconCoordinates[index].y());
-            ea->write("coordinates", coordinates.toUtf8());
+            if (ea->write("coordinates", coordinates.toUtf8())) {
+                updatePrefetchedAttribute(itemPath, "coordinates", coordinates.toUtf8());
+            }
             delete ea;
     }
 }
@@ -311,9 +600,10 @@ QPoint& CustomFileSystemModel::getPositionForIndex(const QModelIndex& index) con
     QPoint *coords = new QPoint(-1, -1); // Invalid coordinates; we'll use this to indicate that we didn't find any
     // FIXME: Destroy coords later, otherwise we'll leak memory?
 
-    QString filePath = this->filePath(index);
-    ExtendedAttributes ea(filePath);
-    QString coordinates = ea.read("coordinates");
+    // Items whose attributes have not been prefetched yet are laid out again
+    // once they are, see attributesPrefetched()
+    const QHash<QString, QByteArray> *attributes = prefetchedAttributes(index);
+    QString coordinates = attributes ? QString(attributes->value("coordinates")) : QString();
     if (!coordinates.isEmpty()) {
         qDebug() << "Read coordinates from extended attributes: " << coordinates;
         QStringList coordinatesList = coordinates.split(",");
@@ -358,17 +648,26 @@ QVariant CustomFileSystemModel::data(const QModelIndex& index, int role) const
     }
 
     if (role == Qt::DecorationRole) {
-        // TODO: Icon generation can be slow; is there a way to use async/threaded/callbacks
-        // so that icons are generated in the background and are shown whenever they are ready?
+        // Icon generation can be slow, so icons are generated in the background by m_iconResolver;
+        // until an icon is ready, the generic icon from QFileSystemModel is shown in its place
+        // and handleIconReady() tells the views to repaint the item
         if (index.column() == 0) {
+            // The icon depends on the open-with and user-icon attributes, so wait for those
+            const QHash<QString, QByteArray> *attributes = prefetchedAttributes(index);
+            if (!attributes) {
+                return QFileSystemModel::data(index, role);
+            }
             QFileInfo fileInfo = this->fileInfo(index);
-            // If openWith, we use m_IconProvider->documentIcon
+            // If openWith, m_iconResolver uses m_IconProvider->documentIcon
             QString openWithString = data(index, OpenWithRole).toString();
-            if (openWithString != "") {
-                return m_IconProvider->documentIcon(fileInfo, openWithString);
-            } else {
-                return m_IconProvider->icon(fileInfo);
+            QIcon icon = m_iconResolver->icon(fileInfo.absoluteFilePath(),
+                                              fileInfo.lastModified().toMSecsSinceEpoch(),
+                                              openWithString,
+                                              attributes->value("user-icon"));
+            if (!icon.isNull()) {
+                return icon;
             }
+            return QFileSystemModel::data(index, role);
         }
     }
 
@@ -380,17 +679,18 @@ QVariant CustomFileSystemModel::data(const QModelIndex& index, int role) const
             return openWithAttributes[index];
         }
 
-        // If we don't have it cached, read the open-with extended attribute
-        QString attributeValue;
-        ExtendedAttributes ea(filePath(index));
-        attributeValue = QString(ea.read("open-with"));
+        // If we don't have it cached, use the prefetched open-with extended attribute
+        const QHash<QString, QByteArray> *attributes = prefetchedAttributes(index);
+        if (!attributes) {
+            // Not prefetched yet; the views are told to ask again once it is
+            return QVariant();
+        }
+        QString attributeValue = QString(attributes->value("open-with"));
 
         // If it's empty, get it from the LaunchDB
         if (attributeValue.isEmpty()) {
             // Get it from the LaunchDB
-            LaunchDB *ldb = new LaunchDB();
-            attributeValue = QString(ldb->applicationForFile(filePath(index)));
-            delete ldb;
+            attributeValue = QString(ldb.applicationForFile(filePath(index)));
         }
         openWithAttributes[index] = attributeValue.toUtf8();
         return attributeValue;
@@ -403,10 +703,13 @@ QVariant CustomFileSystemModel::data(const QModelIndex& index, int role) const
             return canOpenAttributes[index];
         }
 
-        // If we don't have it cached, read the can-open extended attribute
-        QString attributeValue;
-        ExtendedAttributes ea(filePath(index));
-        attributeValue = QString(ea.read("can-open"));
+        // If we don't have it cached, use the prefetched can-open extended attribute
+        const QHash<QString, QByteArray> *attributes = prefetchedAttributes(index);
+        if (!attributes) {
+            // Not prefetched yet; the views are told to ask again once it is
+            return QVariant();
+        }
+        QString attributeValue = QString(attributes->value("can-open"));
 
         canOpenAttributes[index] = attributeValue.toUtf8();
         return attributeValue;
@@ -492,8 +795,7 @@ bool CustomFileSystemModel::setData(const QModelIndex &idx, const QVariant &valu
     qDebug() << "absoluteFilePath:" << absoluteFilePath;
 
     if (Mountpoints::isMountpoint(absoluteFilePath)) {
-        // Get the filesystem type using QStorageInfo
-        const QString filesystemType = QStorageInfo(absoluteFilePath).fileSystemType();
+        const QString filesystemType = MountTable::instance()->fsTypeFor(absoluteFilePath);
         qDebug() << "Filesystem type:" << filesystemType;
         QStringList renameableFilesystems = { "ext2", "ext3", "ext4", "reiserfs", "reiser4", "ufs", "vfat", "exfat", "ntfs" };
         // If the filesystem is not in the list of renameable filesystems, disable renaming
@@ -632,7 +934,9 @@ void CustomFileSystemModel::removeCustomCoordinates(const QModelIndex& index) co
             // qDebug() << "Removing" << pathToBeRemovedFromIconCoordinatesMap << "from iconCoordinates map";
             it = iconCoordinates.erase(it);
             ExtendedAttributes *ea = new ExtendedAttributes(path);
-            ea->clear("coordinates");
+            if (ea->clear("coordinates")) {
+                updatePrefetchedAttribute(path, "coordinates", QByteArray());
+            }
             delete ea;
         } else {
             ++it;
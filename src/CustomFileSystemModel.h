@@ -29,8 +29,14 @@
 
 #include <QFileSystemModel>
 #include <QByteArray>
+#include <QCache>
+#include <QHash>
+#include <QSet>
+#include <QThreadPool>
 #include "LaunchDB.h"
+#include "ExtendedAttributes.h"
 #include "CustomFileIconProvider.h"
+#include "IconResolver.h"
 
 // NOTE: Qt::UserRole + 1 is already used by QFileSystemModel for the file path
 static const int OpenWithRole = Qt::UserRole + 10;
@@ -75,6 +81,30 @@ public:
 
     void removeCustomCoordinates(const QModelIndex& index) const;
 
+    // Returns the icon for the given index, generating it on the calling thread if needed;
+    // unlike data(index, Qt::DecorationRole), this never returns a placeholder
+    QIcon resolvedIcon(const QModelIndex& index) const;
+
+    // Tells the views and proxies that the row of the given index needs to be displayed, sorted and filtered again,
+    // e.g., because whether it is hidden has changed
+    void refreshRow(const QModelIndex& index);
+
+signals:
+    // Emitted when the extended attributes of items in a directory have been prefetched,
+    // so that views can lay out the items at their stored coordinates
+    void attributesPrefetched(const QString& directoryPath);
+
+private slots:
+    // Called when the IconResolver has generated the icon for a file in the background
+    void handleIconReady(const QString& filePath);
+
+    // Called when QFileSystemModel has finished loading a directory; prefetches the
+    // extended attributes of all of its items
+    void handleDirectoryLoaded(const QString& directoryPath);
+
+    // Called when items appear in a directory that has already been prefetched
+    void handleRowsInserted(const QModelIndex& parent, int first, int last);
+
 private:
     // Private member variable to store "open-with" attributes.
     mutable QMap<QModelIndex, QByteArray> openWithAttributes;
@@ -90,6 +120,52 @@ private:
 
     LaunchDB ldb;
 
+    // The extended attributes of an item as read by an AttributePrefetchJob
+    struct PrefetchedAttributes {
+        qint64 metadataChangeTime; // The change time of the item when the attributes were requested
+        QHash<QString, QByteArray> values; // Only the attributes that are present
+    };
+
+    // Prefetched extended attributes by absolute file path; the roles that are
+    // based on extended attributes only read from here, never from the disk.
+    // The least recently used are dropped, and read again when they are needed
+    mutable QCache<QString, PrefetchedAttributes> m_prefetchedAttributes;
+
+    // Directories whose items get their extended attributes prefetched when they appear;
+    // forgotten once there are too many
+    QSet<QString> m_prefetchedDirectories;
+
+    // Absolute file paths for which a prefetch is queued or running
+    mutable QSet<QString> m_pendingAttributes;
+
+    // File names by directory whose attributes were asked for but are not in m_prefetchedAttributes
+    mutable QHash<QString, QStringList> m_requestedAttributes;
+
+    // Runs the AttributePrefetchJobs, one directory at a time
+    mutable QThreadPool m_attributeThreadPool;
+
+    // Queues a job that reads the extended attributes of the given items of a directory
+    void prefetchAttributes(const QString& directoryPath, const QStringList& fileNames) const;
+
+    // Queues one prefetch per directory for the items in m_requestedAttributes
+    void prefetchRequestedAttributes() const;
+
+    // Returns the prefetched extended attributes for the item, or nullptr if they have not
+    // been prefetched yet, in which case they are requested; if the item changed since,
+    // a new prefetch is queued and the outdated attributes are returned until it completes
+    const QHash<QString, QByteArray>* prefetchedAttributes(const QModelIndex& index) const;
+
+    // Called on the GUI thread with the result of an AttributePrefetchJob
+    void handleAttributesPrefetched(const QString& directoryPath,
+                                    const ExtendedAttributes::AttributeTable& table,
+                                    const QHash<QString, qint64>& metadataChangeTimes);
+
+    // Updates the prefetched value of an attribute after we have written it ourselves
+    void updatePrefetchedAttribute(const QString& filePath, const QString& attributeName,
+                                   const QByteArray& value) const;
+
+    friend class AttributePrefetchJob;
+
     // Private method to create a bookmark file via drag and drop, e.g., from a web browser
     bool createBrowserBookmarkFile(const QMimeData *data, QString dropTargetPath) const;
 
@@ -103,6 +179,9 @@ private:
     CustomFileIconProvider *m_IconProvider;
     // FIXME:  Why are we getting error: unknown type name 'CustomFileIconProvider'; did you mean 'QFileIconProvider'?
 
+    // Generates icons in the background using m_IconProvider
+    IconResolver *m_iconResolver;
+
 };
 
 #endif // CUSTOMFILESYSTEMMODEL_H
\ No newline at end of file
@@ -289,7 +289,7 @@ bool CustomItemDelegate::editorEvent(QEvent *event, QAbstractItemModel *model,
             for (QModelIndex index : selectedIndexes) {
                 // Get the absolute path of the item represented by the index, using the model
                 QString filePath = model->data(index, QFileSystemModel::FilePathRole).toString();
-                mainWindow->openFolderInNewWindow(filePath);
+                mainWindow->showContents(filePath);
             }
         });
         ApplicationBundle* bundle = new ApplicationBundle(filePath);
@@ -27,13 +27,13 @@
 #include "CustomProxyModel.h"
 #include <QIcon>
 #include <QDebug>
-#include <QStorageInfo>
 #include <QDir>
 #include "ApplicationBundle.h"
 #include <QMimeData>
 #include <QUrl>
 #include <QFileSystemModel>
 #include "Mountpoints.h"
+#include <QFileInfo>
 #include "CustomFileSystemModel.h"
 
 QSet<QString> hiddenFileNames;
@@ -46,6 +46,19 @@ CustomProxyModel::CustomProxyModel(QObject *parent)
 
 void CustomProxyModel::setSourceModel(QAbstractItemModel *sourceModel)
 {
+    if (this->sourceModel()) {
+        disconnect(this->sourceModel(), nullptr, this, nullptr);
+    }
+    sortKeys.clear();
+
+    // Connected before QSortFilterProxyModel connects its own handlers, so that rows which changed
+    // have their sort keys recomputed before they are sorted again
+    connect(sourceModel, &QAbstractItemModel::dataChanged, this, &CustomProxyModel::handleSourceDataChanged);
+    connect(sourceModel, &QAbstractItemModel::rowsAboutToBeRemoved, this, &CustomProxyModel::removeSortKeys);
+    connect(sourceModel, &QAbstractItemModel::rowsInserted, this, &CustomProxyModel::computeSortKeys);
+    connect(sourceModel, &QAbstractItemModel::modelAboutToBeReset, this, [this]() { sortKeys.clear(); });
+    connect(sourceModel, &QAbstractItemModel::layoutAboutToBeChanged, this, [this]() { sortKeys.clear(); });
+
     QSortFilterProxyModel::setSourceModel(sourceModel);
 
     if (QFileSystemModel *fileSystemModel = qobject_cast<QFileSystemModel *>(sourceModel)) {
@@ -58,93 +71,105 @@ void CustomProxyModel::setSourceModel(QAbstractItemModel *sourceModel)
         // Also watch the parent directory, in case the .hidden file gets deleted or created
         connect(fileSystemModel, &QFileSystemModel::directoryLoaded, this, &CustomProxyModel::handleHiddenFileChanged);
 
-        QFile hiddenFile(hiddenFilePath);
-        if (hiddenFile.open(QIODevice::ReadOnly)) {
-            QTextStream in(&hiddenFile);
-            while (!in.atEnd()) {
-                QString line = in.readLine();
-                hiddenFileNames.insert(line.trimmed());
-            }
-            hiddenFile.close();
-        }
+        hiddenFileNames = readHiddenFileNames(hiddenFilePath);
     }
 }
 
 bool CustomProxyModel::lessThan(const QModelIndex &left, const QModelIndex &right) const
 {
-    QString leftPath = sourceModel()->data(left, Qt::DisplayRole).toString();
-    QString rightPath = sourceModel()->data(right, Qt::DisplayRole).toString();
-
-    QString leftFullPath = sourceModel()->index(left.row(), 0, left.parent()).data(Qt::UserRole + 1).toString();
-
-    // Check if leftFullPath is on the Desktop and if not, just return the superclasses' lessThan
-    // for performance reasons
-    QString parentOfLeftFullPath = QFileInfo(leftFullPath).dir().path();
-    if (parentOfLeftFullPath != QDir::homePath() + "/Desktop") {
+    if (left.column() != 0 || right.column() != 0) {
         return QSortFilterProxyModel::lessThan(left, right);
     }
 
-    QString rightFullPath = sourceModel()->index(right.row(), 0, right.parent()).data(Qt::UserRole + 1).toString();
+    const SortKey leftKey = sortKey(left);
+    const SortKey rightKey = sortKey(right);
 
-    // Check if the fullPaths are symbolic links and if so, resolve them
-    if (QFileInfo(leftFullPath).isSymLink()) {
-        leftFullPath = QFileInfo(leftFullPath).symLinkTarget();
+    // On the desktop, the root directory comes before mount points, which come before
+    // application bundles, which come before everything else
+    if (leftKey.rank != rightKey.rank) {
+        return leftKey.rank < rightKey.rank;
     }
-    if (QFileInfo(rightFullPath).isSymLink()) {
-        rightFullPath = QFileInfo(rightFullPath).symLinkTarget();
-    }
-
-    bool leftIsDir = QFileInfo(leftFullPath).isDir();
-    bool rightIsDir = QFileInfo(rightFullPath).isDir();
 
-    if (leftIsDir && rightIsDir) {
-        // qDebug() << "leftFullPath:" << leftFullPath << "rightFullPath:" << rightFullPath;
+    const int order = leftKey.name.compare(rightKey.name);
+    if (order != 0) {
+        return order < 0;
+    }
+    return left.row() < right.row();
+}
 
-        bool leftIsMountPoint = Mountpoints::isMountpoint(leftFullPath);
-        bool rightIsMountPoint = Mountpoints::isMountpoint(rightFullPath);
-        // qDebug() << "leftIsMountPoint:" << leftIsMountPoint << "rightIsMountPoint:" << rightIsMountPoint;
+CustomProxyModel::SortKey CustomProxyModel::sortKey(const QModelIndex &sourceIndex) const
+{
+    auto it = sortKeys.constFind(sourceIndex.internalPointer());
+    if (it != sortKeys.constEnd()) {
+        return it.value();
+    }
+    // Rows that were there before the source model was set
+    SortKey key = computeSortKey(sourceIndex);
+    sortKeys.insert(sourceIndex.internalPointer(), key);
+    return key;
+}
 
-        ApplicationBundle *leftApplicationBundle = new ApplicationBundle(leftFullPath);
-        bool leftIsApplicationBundle = leftApplicationBundle->isValid();
-        ApplicationBundle *rightApplicationBundle = new ApplicationBundle(rightFullPath);
-        bool rightIsApplicationBundle = rightApplicationBundle->isValid();
-        delete leftApplicationBundle;
-        delete rightApplicationBundle;
+CustomProxyModel::SortKey CustomProxyModel::computeSortKey(const QModelIndex &sourceIndex) const
+{
+    const QModelIndex nameIndex = sourceIndex.sibling(sourceIndex.row(), 0);
+    SortKey key = { 0, collator.sortKey(nameIndex.data(Qt::DisplayRole).toString().toCaseFolded()) };
 
-        if ("/" == leftFullPath && "/" != rightFullPath) {
-            // Root directory comes before others
-            return false;
-        }
+    // Only items on the Desktop are ranked
+    QString fullPath = nameIndex.data(QFileSystemModel::FilePathRole).toString();
+    if (QFileInfo(fullPath).dir().path() != QDir::homePath() + "/Desktop") {
+        return key;
+    }
 
-        if ("/" != leftFullPath && "/" == rightFullPath) {
-            // Root directory comes before others
-            return true;
-        }
+    // Check if the fullPath is a symbolic link and if so, resolve it
+    QFileInfo fileInfo(fullPath);
+    if (fileInfo.isSymLink()) {
+        fullPath = fileInfo.symLinkTarget();
+    }
+    if (!QFileInfo(fullPath).isDir()) {
+        return key;
+    }
 
-        if (leftIsMountPoint && !rightIsMountPoint) {
-            // Mount points before non-mount points
-            return false;
-        }
+    if (fullPath == "/") {
+        key.rank = 3;
+    } else if (Mountpoints::isMountpoint(fullPath)) {
+        key.rank = 2;
+    } else if (ApplicationBundle(fullPath).isValid()) {
+        key.rank = 1;
+    }
+    return key;
+}
 
-        if (rightIsMountPoint && !leftIsMountPoint) {
-            // Mount points before non-mount points
-            return true;
-        }
+void CustomProxyModel::computeSortKeys(const QModelIndex &sourceParent, int first, int last)
+{
+    for (int row = first; row <= last; row++) {
+        const QModelIndex index = sourceModel()->index(row, 0, sourceParent);
+        sortKeys.insert(index.internalPointer(), computeSortKey(index));
+    }
+}
 
-        if (leftIsApplicationBundle && !rightIsApplicationBundle) {
-            // Application bundles before non-application bundles
-            return false;
-        }
+void CustomProxyModel::handleSourceDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight,
+                                               const QVector<int> &roles)
+{
+    // Icons and extended attributes arrive in the background; they do not change what a row is sorted by
+    if (!roles.isEmpty() && !roles.contains(Qt::DisplayRole) && !roles.contains(QFileSystemModel::FilePathRole)) {
+        return;
+    }
+    for (int row = topLeft.row(); row <= bottomRight.row(); row++) {
+        sortKeys.remove(sourceModel()->index(row, 0, topLeft.parent()).internalPointer());
+    }
+}
 
-        if (rightIsApplicationBundle && !leftIsApplicationBundle) {
-            // Application bundles before non-application bundles
-            return true;
+void CustomProxyModel::removeSortKeys(const QModelIndex &sourceParent, int first, int last)
+{
+    for (int row = first; row <= last; row++) {
+        const QModelIndex index = sourceModel()->index(row, 0, sourceParent);
+        if (sourceModel()->rowCount(index) > 0) {
+            // The children go away along with the row, without being removed one by one
+            sortKeys.clear();
+            return;
         }
-
+        sortKeys.remove(index.internalPointer());
     }
-
-    // Fallback to default sorting
-    return QSortFilterProxyModel::lessThan(left, right);
 }
 
 
@@ -219,39 +244,68 @@ void CustomProxyModel::handleHiddenFileChanged(const QString &path)
     updateFiltering();
 }
 
-void CustomProxyModel::loadHiddenFileNames(const QString &hiddenFilePath)
+QSet<QString> CustomProxyModel::readHiddenFileNames(const QString &hiddenFilePath)
 {
+    QSet<QString> names;
     QFile hiddenFile(hiddenFilePath);
     if (hiddenFile.open(QIODevice::ReadOnly)) {
         QTextStream in(&hiddenFile);
         while (!in.atEnd()) {
             QString line = in.readLine();
-            hiddenFileNames.insert(line.trimmed());
+            names.insert(line.trimmed());
         }
         hiddenFile.close();
         // trash-can.desktop is always hidden; it is a leftover from the old Filer
         // TODO: Once the old Filer has been out of use for a while, this can be removed
-        hiddenFileNames.insert("trash-can.desktop");
+        names.insert("trash-can.desktop");
     }
+    return names;
 }
 
 void CustomProxyModel::updateFiltering()
 {
-    hiddenFileNames.clear();
-    if (QFileSystemModel *fileSystemModel = qobject_cast<QFileSystemModel *>(sourceModel())) {
-        QString rootPath = fileSystemModel->rootPath();
-        QString hiddenFilePath = rootPath + "/.hidden";
-        loadHiddenFileNames(hiddenFilePath);
+    CustomFileSystemModel *fileSystemModel = qobject_cast<CustomFileSystemModel *>(sourceModel());
+    if (!fileSystemModel) {
+        return;
     }
+    const QString rootPath = fileSystemModel->rootPath();
+    const QSet<QString> names = readHiddenFileNames(rootPath + "/.hidden");
+
+    // This also runs whenever a directory has been loaded, and usually nothing has changed
+    if (names == hiddenFileNames) {
+        return;
+    }
+
+    // Only the names that were added to or removed from .hidden need to be filtered again,
+    // rather than every row of a folder that may have hundreds of thousands of them
+    QSet<QString> changedNames = names;
+    changedNames.unite(hiddenFileNames);
+    changedNames.subtract(QSet<QString>(names).intersect(hiddenFileNames));
+    hiddenFileNames = names;
 
-    invalidateFilter();
+    if (!filteringEnabled) {
+        return;
+    }
+    const QModelIndex rootIndex = fileSystemModel->index(rootPath);
+    for (const QString &name : changedNames) {
+        if (name.isEmpty() || name.contains('/')) {
+            continue;
+        }
+        const QModelIndex index = fileSystemModel->index(rootPath + "/" + name);
+        if (!index.isValid() || index.parent() != rootIndex) {
+            continue;
+        }
+        // With dynamic filtering, the proxy filters the rows of the source model that change again,
+        // both those it shows and those it has filtered out
+        fileSystemModel->refreshRow(index);
+    }
 }
 
 void CustomProxyModel::setFilteringEnabled(bool enable)
 {
     if (filteringEnabled != enable) {
         filteringEnabled = enable;
-        updateFiltering();
+        invalidateFilter();
     }
 }
 
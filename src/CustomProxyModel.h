@@ -30,6 +30,9 @@
 #include <QSortFilterProxyModel>
 #include <QModelIndex>
 #include <QSet>
+#include <QHash>
+#include <QVector>
+#include <QCollator>
 #include <QFileSystemWatcher>
 
 /**
@@ -56,6 +59,9 @@ public:
      * @brief Returns whether the item referred to by the given index is less than the item
      *        referred to by the given other index. Used for sorting. Sorts mount points
      *        before non-mount points.
+     *
+     * Compares sort keys that are computed once per row and kept until the row changes,
+     * so that sorting does not touch the file system.
      * @param left The left index.
      * @param right The right index.
      * @return True if the item referred to by the left index is less than the item referred
@@ -103,13 +109,28 @@ private slots:
     void handleHiddenFileChanged(const QString &path);
 
 private:
-    void loadHiddenFileNames(const QString &hiddenFilePath);
+    /**
+     * @brief What an item is sorted by in the first column.
+     */
+    struct SortKey {
+        int rank;                   ///< On the desktop: 3 for /, 2 for mount points, 1 for application bundles, otherwise 0.
+        QCollatorSortKey name;      ///< The display name, case-folded.
+    };
+
+    static QSet<QString> readHiddenFileNames(const QString &hiddenFilePath);
     void updateFiltering();
+    SortKey sortKey(const QModelIndex &sourceIndex) const;
+    SortKey computeSortKey(const QModelIndex &sourceIndex) const;
+    void computeSortKeys(const QModelIndex &sourceParent, int first, int last);
+    void handleSourceDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QVector<int> &roles);
+    void removeSortKeys(const QModelIndex &sourceParent, int first, int last);
 
     bool filteringEnabled;
 
     /**
      * @brief Contains the hidden file names from the .hidden file.
+     *
+     * When the file changes, only the rows whose names were added or removed are filtered again.
      */
     QSet<QString> hiddenFileNames;
 
@@ -118,6 +139,13 @@ private:
      */
     QFileSystemWatcher fileWatcher;
 
+    /**
+     * @brief The sort keys by the item of the source model (its internal pointer).
+     */
+    mutable QHash<const void *, SortKey> sortKeys;
+
+    QCollator collator;
+
 };
 
 #endif // CUSTOMPROXYMODEL_H
@@ -33,6 +33,7 @@
 #include "CustomFileSystemModel.h"
 #include "FileManagerMainWindow.h"
 #include "ApplicationBundle.h"
+#include "FileClassifier.h"
 #include <QApplication>
 #include "CustomProxyModel.h"
 #include "DBusInterface.h"
@@ -260,7 +261,7 @@ void DragAndDropHandler::handleDropEvent(QDropEvent* event)
                     // Convert the url to a local path
                     QString path = urls.at(i).toLocalFile();
                     // Check MIME type of the file
-                    QString mimeType = QMimeDatabase().mimeTypeForFile(path).name();
+                    QString mimeType = FileClassifier::classify(path).mimeType;
                     qDebug() << "DragAndDropHandler::handleDropEvent mimeType" << mimeType;
                     // TODO: Check if the app supports the MIME type or whether a modifier key is pressed
                     app->launch({path});
@@ -0,0 +1,232 @@
+/*-
+ * Copyright (c) 2022-23 Simon Peter <probono@puredarwin.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "ElfInspector.h"
+
+#include <QFile>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QVector>
+#include <QtEndian>
+#include <QDebug>
+
+#include <elf.h>
+
+namespace {
+
+// Reads an integer of the byte order of the file; the caller checks the bounds
+template <typename T>
+T readValue(const uchar *data, qint64 offset, bool isLittleEndian)
+{
+    return isLittleEndian ? qFromLittleEndian<T>(data + offset) : qFromBigEndian<T>(data + offset);
+}
+
+// Returns the contents of a section up to the first NUL
+QByteArray sectionString(const uchar *data, qint64 offset, qint64 size)
+{
+    const char *start = reinterpret_cast<const char *>(data + offset);
+    return QByteArray(start, static_cast<int>(qstrnlen(start, static_cast<uint>(size))));
+}
+
+/**
+ * @brief Inspects one file of an ElfInspector::inspectAll() batch on a worker thread.
+ */
+class InspectionJob : public QRunnable
+{
+public:
+    InspectionJob(const QString &filePath, ElfInspector::Info *info) : m_filePath(filePath), m_info(info) { }
+
+    void run() override
+    {
+        *m_info = ElfInspector::inspect(m_filePath);
+    }
+
+private:
+    QString m_filePath;
+    ElfInspector::Info *m_info; // Each job writes to its own element, so no locking is needed
+};
+
+}
+
+ElfInspector::Info ElfInspector::inspect(const QString &filePath)
+{
+    Info info;
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "ElfInspector: Cannot open" << filePath << ":" << file.errorString();
+        return info;
+    }
+    qint64 size = file.size();
+    if (size < EI_NIDENT) {
+        return info;
+    }
+    // Mapping does not read anything yet; only the pages we touch are read from the disk
+    const uchar *data = file.map(0, size);
+    if (!data) {
+        qWarning() << "ElfInspector: Cannot map" << filePath << ":" << file.errorString();
+        return info;
+    }
+    inspectMapped(data, size, info);
+    file.unmap(const_cast<uchar *>(data));
+    return info;
+}
+
+QHash<QString, ElfInspector::Info> ElfInspector::inspectAll(const QStringList &filePaths)
+{
+    // The files are mostly in the page cache or on the same disk, so the
+    // number of threads that makes sense is the same as for computations
+    QVector<Info> infos(filePaths.size());
+    QThreadPool threadPool;
+    for (int i = 0; i < filePaths.size(); ++i) {
+        threadPool.start(new InspectionJob(filePaths.at(i), &infos[i]));
+    }
+    threadPool.waitForDone();
+
+    QHash<QString, Info> result;
+    result.reserve(filePaths.size());
+    for (int i = 0; i < filePaths.size(); ++i) {
+        result.insert(filePaths.at(i), infos.at(i));
+    }
+    return result;
+}
+
+void ElfInspector::inspectMapped(const uchar *data, qint64 size, Info &info)
+{
+    if (data[EI_MAG0] != ELFMAG0 || data[EI_MAG1] != ELFMAG1 || data[EI_MAG2] != ELFMAG2
+        || data[EI_MAG3] != ELFMAG3) {
+        return;
+    }
+    if (data[EI_CLASS] != ELFCLASS32 && data[EI_CLASS] != ELFCLASS64) {
+        return;
+    }
+    if (data[EI_DATA] != ELFDATA2LSB && data[EI_DATA] != ELFDATA2MSB) {
+        return;
+    }
+    const bool is64Bit = data[EI_CLASS] == ELFCLASS64;
+    const bool le = data[EI_DATA] == ELFDATA2LSB;
+
+    // The fields of the ELF header that we need, which are at different offsets for ELF32 and ELF64
+    const qint64 headerSize = is64Bit ? 64 : 52;
+    if (size < headerSize) {
+        return;
+    }
+    const quint16 machine = readValue<quint16>(data, 18, le);
+    const quint64 shoff = is64Bit ? readValue<quint64>(data, 40, le) : readValue<quint32>(data, 32, le);
+    const quint16 shentsize = readValue<quint16>(data, is64Bit ? 58 : 46, le);
+    const quint16 shnum = readValue<quint16>(data, is64Bit ? 60 : 48, le);
+    const quint16 shstrndx = readValue<quint16>(data, is64Bit ? 62 : 50, le);
+
+    info.isValid = true;
+    info.is64Bit = is64Bit;
+    info.isLittleEndian = le;
+    info.machine = machine;
+    info.architecture = architectureName(machine);
+
+    // AppImages are marked with "AI" and their type in the padding of the identification
+    if (data[8] == 'A' && data[9] == 'I') {
+        if (data[10] == 1) {
+            info.appImageType = AppImageType::Type1;
+        } else if (data[10] == 2) {
+            info.appImageType = AppImageType::Type2;
+        }
+    }
+
+    // Like the AppImage runtime, take the ELF part to end with the section header table
+    // or with the last section, whichever comes later
+    const qint64 minimumEntrySize = is64Bit ? 64 : 40;
+    const quint64 tableEnd = shoff + static_cast<quint64>(shentsize) * shnum;
+    if (shnum == 0 || shentsize < minimumEntrySize || shoff > static_cast<quint64>(size)
+        || tableEnd > static_cast<quint64>(size)) {
+        info.elfSize = qMax<qint64>(headerSize, static_cast<qint64>(qMin<quint64>(tableEnd, size)));
+        return;
+    }
+    qint64 elfSize = static_cast<qint64>(tableEnd);
+
+    // The section names are in the section header string table
+    qint64 namesOffset = -1;
+    qint64 namesSize = 0;
+    if (shstrndx < shnum) {
+        const qint64 entry = static_cast<qint64>(shoff) + static_cast<qint64>(shstrndx) * shentsize;
+        const quint64 offset = is64Bit ? readValue<quint64>(data, entry + 24, le) : readValue<quint32>(data, entry + 16, le);
+        const quint64 sectionSize = is64Bit ? readValue<quint64>(data, entry + 32, le) : readValue<quint32>(data, entry + 20, le);
+        if (offset <= static_cast<quint64>(size) && sectionSize <= static_cast<quint64>(size) - offset) {
+            namesOffset = static_cast<qint64>(offset);
+            namesSize = static_cast<qint64>(sectionSize);
+        }
+    }
+
+    for (quint16 i = 0; i < shnum; ++i) {
+        const qint64 entry = static_cast<qint64>(shoff) + static_cast<qint64>(i) * shentsize;
+        const quint32 name = readValue<quint32>(data, entry, le);
+        const quint32 type = readValue<quint32>(data, entry + 4, le);
+        const quint64 offset = is64Bit ? readValue<quint64>(data, entry + 24, le) : readValue<quint32>(data, entry + 16, le);
+        const quint64 sectionSize = is64Bit ? readValue<quint64>(data, entry + 32, le) : readValue<quint32>(data, entry + 20, le);
+
+        // Sections without contents in the file do not count
+        if (type == SHT_NOBITS || offset > static_cast<quint64>(size)
+            || sectionSize > static_cast<quint64>(size) - offset) {
+            continue;
+        }
+        elfSize = qMax(elfSize, static_cast<qint64>(offset + sectionSize));
+
+        if (namesOffset < 0 || name >= namesSize) {
+            continue;
+        }
+        const QByteArray sectionName = sectionString(data, namesOffset + name, namesSize - name);
+        if (sectionName == ".upd_info") {
+            info.updateInformation = sectionString(data, static_cast<qint64>(offset), static_cast<qint64>(sectionSize));
+        } else if (sectionName == ".sha256_sig") {
+            info.signature = sectionString(data, static_cast<qint64>(offset), static_cast<qint64>(sectionSize));
+        }
+    }
+
+    info.elfSize = elfSize;
+}
+
+QString ElfInspector::architectureName(quint16 machine)
+{
+    switch (machine) {
+    case EM_386:
+        return "i386";
+    case EM_X86_64:
+        return "x86_64";
+    case EM_ARM:
+        return "armhf";
+    case EM_AARCH64:
+        return "aarch64";
+    case EM_PPC:
+        return "powerpc";
+    case EM_PPC64:
+        return "powerpc64";
+#ifdef EM_RISCV
+    case EM_RISCV:
+        return "riscv64";
+#endif
+    default:
+        return QString();
+    }
+}
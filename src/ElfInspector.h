@@ -0,0 +1,100 @@
+/*-
+ * Copyright (c) 2022-23 Simon Peter <probono@puredarwin.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef ELFINSPECTOR_H
+#define ELFINSPECTOR_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QHash>
+
+/**
+ * @file ElfInspector.h
+ * @class ElfInspector
+ * @brief Reads what Filer needs to know about ELF files and AppImages in a single pass.
+ *
+ * The file is mapped into memory and only the pages holding the ELF header, the section
+ * headers and the few sections we are interested in are ever read. ELF32 and ELF64 files
+ * of either byte order are supported, independent of the machine we run on.
+ */
+class ElfInspector
+{
+public:
+    /**
+     * @brief The type of an AppImage as given by the magic bytes in the ELF identification.
+     */
+    enum class AppImageType {
+        None,  ///< Not an AppImage.
+        Type1, ///< An ISO 9660 based AppImage.
+        Type2  ///< A squashfs based AppImage.
+    };
+
+    /**
+     * @brief What inspect() found out about a file.
+     */
+    struct Info {
+        bool isValid = false;        ///< Whether the file is a well-formed ELF file.
+        bool is64Bit = false;        ///< ELFCLASS64 rather than ELFCLASS32.
+        bool isLittleEndian = false; ///< ELFDATA2LSB rather than ELFDATA2MSB.
+        quint16 machine = 0;         ///< The e_machine field.
+        QString architecture;        ///< The architecture name as used in AppImage file names, e.g., "x86_64".
+        qint64 elfSize = 0;          ///< The size of the ELF part; for an AppImage, the offset of the squashfs.
+        AppImageType appImageType = AppImageType::None;
+        QByteArray updateInformation; ///< The contents of the .upd_info section up to the first NUL.
+        QByteArray signature;         ///< The contents of the .sha256_sig section up to the first NUL.
+    };
+
+    /**
+     * @brief Inspects one file.
+     * @param filePath The path of the file.
+     * @return The information; Info::isValid is false if the file is not an ELF file.
+     */
+    static Info inspect(const QString &filePath);
+
+    /**
+     * @brief Inspects several files in parallel, e.g., all AppImages in a directory.
+     * @param filePaths The paths of the files.
+     * @return The information by file path.
+     */
+    static QHash<QString, Info> inspectAll(const QStringList &filePaths);
+
+private:
+    /**
+     * @brief Inspects a file that is mapped into memory.
+     * @param data The contents of the file.
+     * @param size The size of the file.
+     * @param info Receives the information.
+     */
+    static void inspectMapped(const uchar *data, qint64 size, Info &info);
+
+    /**
+     * @brief Returns the AppImage name of an ELF machine, e.g., "x86_64" for EM_X86_64.
+     */
+    static QString architectureName(quint16 machine);
+};
+
+#endif // ELFINSPECTOR_H
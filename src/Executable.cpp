@@ -1,73 +1,26 @@
 #include "Executable.h"
+#include "FileClassifier.h"
 #include <QFileInfo>
 #include <QFile>
 #include <QTextStream>
-#include <QMimeDatabase>
 #include <QDebug>
 #include <QMessageBox>
 #include <QProcess>
 
 bool Executable::isExecutable(const QString& path) {
-    QFileInfo fileInfo(path);
-    return fileInfo.isExecutable();
+    return FileClassifier::classify(path).flags & FileClassifier::IsExecutable;
 }
 
 bool Executable::hasShebang(const QString& path) {
-    QFile file(path);
-    QFileInfo fileInfo(path);
-
-    // If it is a directory, it cannot have a shebang, so return false
-    if (fileInfo.isDir()) {
-        qDebug() << "File is a directory, so it cannot have a shebang.";
-        return false;
-    }
-
-    // If it is a symlink, we need to check the target
-    if (fileInfo.isSymLink()) {
-        qDebug() << "File is a symlink, so we need to check the target.";
-        QString target = fileInfo.symLinkTarget();
-        qDebug() << "Target:" << target;
-        return hasShebang(target);
-    }
-
-    qDebug() << "Checking file:" << path;
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        qWarning() << "Failed to open file:" << path;
-        return false;
-    }
-
-    // Check if the file starts with the shebang sequence
-    QByteArray firstTwoBytes = file.read(2);
-    // qDebug() << "First two bytes:" << firstTwoBytes;
-    if (firstTwoBytes == "#!") {
-        // qDebug() << "File has a shebang.";
-        // Exception: If the MIME type is e.g., "application/x-raw-disk-image",
-        // then we ignore the shebang
-        if (QMimeDatabase().mimeTypeForFile(path).name().contains("disk-image")) {
-            qDebug() << "File is a disk image, so we ignore the shebang.";
-            return false;
-        }
-        return true;
-    } else {
-        // qDebug() << "File does not have a shebang.";
-        return false;
-    }
+    // FileClassifier follows symlinks, ignores directories and disk images,
+    // and reads the beginning of each file only once
+    return FileClassifier::classify(path).flags & FileClassifier::HasShebang;
 }
 
 bool Executable::isElf(const QString& path) {
-    QMimeDatabase mimeDatabase;
-    QString mimeType = mimeDatabase.mimeTypeForFile(path).name();
     // NOTE: Not all "application/..." mime types are ELF executables, e.g., disk images
-    // have "application/..." mime types, too.
-    if (mimeType == "application/x-executable" || \
-        mimeType == "application/x-pie-executable" || \
-        mimeType == "application/vnd-appimage") {
-        // qDebug() << "File is an ELF executable.";
-        return true;
-    } else {
-        // qDebug() << "File is not an ELF executable.";
-        return false;
-    }
+    // have "application/..." mime types, too; FileClassifier only counts executables and AppImages
+    return FileClassifier::classify(path).flags & FileClassifier::IsElf;
 }
 
 bool Executable::askUserToMakeExecutable(const QString& path) {
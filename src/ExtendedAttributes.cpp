@@ -36,11 +36,128 @@
 #include <sys/extattr.h>
 #elif defined(__linux__)
 #include <sys/types.h>
-#include <linux/xattr.h>
+#include <sys/xattr.h>
+#include <errno.h>
 #endif
 
+#include <dirent.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+
 ExtendedAttributes::ExtendedAttributes(const QString &filePath) : m_file(filePath) { }
 
+// Returns the names of the attributes of a file in the "user" namespace, without the prefix;
+// exists is set to false if the file (or the target of a symlink) does not exist
+static QList<QByteArray> listUserAttributes(const QByteArray &path, bool *exists = nullptr) {
+    QList<QByteArray> names;
+    if (exists) {
+        *exists = true;
+    }
+
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(__linux__)
+
+    // The list consists of names that are each preceded by a single byte holding their length
+    ssize_t dataSize = extattr_list_file(path.constData(), EXTATTR_NAMESPACE_USER, NULL, 0);
+    if (dataSize < 0 && errno == ENOENT && exists) {
+        *exists = false;
+    }
+    if (dataSize <= 0) {
+        return names;
+    }
+    QByteArray data(dataSize, Qt::Uninitialized);
+    dataSize = extattr_list_file(path.constData(), EXTATTR_NAMESPACE_USER, data.data(), data.size());
+    for (ssize_t i = 0; i < dataSize; ) {
+        int length = static_cast<unsigned char>(data.at(i));
+        names.append(QByteArray(data.constData() + i + 1, qMin<ssize_t>(length, dataSize - i - 1)));
+        i += 1 + length;
+    }
+
+#elif defined(__linux__)
+
+    // The list consists of NUL terminated names of all namespaces; we only want "user."
+    ssize_t dataSize = listxattr(path.constData(), nullptr, 0);
+    if (dataSize < 0 && errno == ENOENT && exists) {
+        *exists = false;
+    }
+    if (dataSize <= 0) {
+        return names;
+    }
+    QByteArray data(dataSize, Qt::Uninitialized);
+    dataSize = listxattr(path.constData(), data.data(), data.size());
+    if (dataSize <= 0) {
+        return names;
+    }
+    for (const QByteArray &name : data.left(dataSize).split('\0')) {
+        if (name.startsWith("user.")) {
+            names.append(name.mid(5));
+        }
+    }
+
+#endif
+
+    return names;
+}
+
+// Returns the value of an attribute of a file in the "user" namespace
+static QByteArray readUserAttribute(const QByteArray &path, const QByteArray &attributeName) {
+
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(__linux__)
+
+    // Determine the size of the extended attribute data
+    ssize_t dataSize = extattr_get_file(path.constData(), EXTATTR_NAMESPACE_USER,
+                                        attributeName.constData(), NULL, 0);
+    if (dataSize < 0) {
+        return QByteArray();
+    }
+
+    // Retrieve the extended attribute data
+    QByteArray attributeValue(dataSize, Qt::Uninitialized);
+    ssize_t actualDataSize = extattr_get_file(path.constData(), EXTATTR_NAMESPACE_USER,
+                                              attributeName.constData(),
+                                              attributeValue.data(), attributeValue.size());
+    if (actualDataSize < 0) {
+        return QByteArray();
+    }
+    attributeValue.resize(actualDataSize);
+    return attributeValue;
+
+#elif defined(__linux__)
+
+    QByteArray name = "user." + attributeName;
+    while (true) {
+        // Determine the size of the extended attribute data
+        ssize_t dataSize = getxattr(path.constData(), name.constData(), nullptr, 0);
+        if (dataSize < 0) {
+            // A missing attribute, or a file system without extended attributes, is not an error
+            if (errno != ENODATA && errno != ENOTSUP) {
+                qWarning() << "ExtendedAttributes: Error reading extended attribute"
+                           << attributeName << "from file" << path << ":" << strerror(errno);
+            }
+            return QByteArray();
+        }
+
+        QByteArray attributeValue(dataSize, Qt::Uninitialized);
+        ssize_t actualDataSize = getxattr(path.constData(), name.constData(),
+                                          attributeValue.data(), attributeValue.size());
+        if (actualDataSize >= 0) {
+            attributeValue.resize(actualDataSize);
+            return attributeValue;
+        }
+        // If the attribute grew in between the two calls, try again
+        if (errno != ERANGE) {
+            return QByteArray();
+        }
+    }
+
+#else
+
+    return QByteArray();
+
+#endif
+
+}
+
 bool ExtendedAttributes::write(const QString &attributeName, const QByteArray &attributeValue)
 {
     // qDebug() << "Trying to write extended attribute" << attributeName << "with value" << attributeValue;
@@ -74,22 +191,21 @@ bool ExtendedAttributes::write(const QString &attributeName, const QByteArray &a
 
 #elif defined(__linux__)
 
-    qDebug() << "Writing extended attribute" << attributeName << "with value" << attributeValue
-             << "to file" << m_file.fileName();
     // Write the extended attribute to the file in the "user" namespace
-    QProcess xattr;
-    xattr.start("setfattr",
-                QStringList() << "-n" << "user." + attributeName
-                            << "-v" << attributeValue
-                            << m_file.fileName());
-    if (!xattr.waitForFinished()) {
+    QByteArray path = QFile::encodeName(m_file.fileName());
+    QByteArray name = "user." + attributeName.toUtf8();
+    if (setxattr(path.constData(), name.constData(),
+                 attributeValue.constData(), attributeValue.size(), 0) == -1) {
+        if (errno == EACCES || errno == EPERM) {
+            // We are not allowed to write to the file; setfattr may be setuid root.
+            // Pass the value base64 encoded so that setfattr does not interpret it
+            return runSetfattr(QStringList() << "-n" << QString::fromUtf8(name)
+                                             << "-v" << QString::fromLatin1("0s" + attributeValue.toBase64()));
+        }
         // Error writing extended attribute to user namespace
-        qWarning() << "ExtendedAttributes::write(): Error writing extended attribute to user "
-                      "namespace";
+        qWarning() << "Error writing extended attribute" << attributeName << "to file"
+                   << m_file.fileName() << ":" << strerror(errno);
         return false;
-    } else {
-        // Extended attribute was written successfully
-        // qDebug() << "Extended attribute was written successfully";
     }
 
 #endif
@@ -107,70 +223,9 @@ QByteArray ExtendedAttributes::read(const QString &attributeName) {
         return QByteArray();
     }
 
-#if (defined(__unix__) || defined(__APPLE__)) && !defined(__linux__)
-
     // NOTE: This implementation is faster than using QProcess, but it means that we cannot get
     // extended attributes from files that we do not have read access to.
-
-    // Determine the size of the extended attribute data
-    ssize_t dataSize = extattr_get_file(
-            m_file.fileName().toUtf8().constData(),
-            EXTATTR_NAMESPACE_USER,
-            attributeName.toUtf8().constData(),
-            NULL, 0
-    );
-
-    if (dataSize < 0) {
-        return QByteArray();
-    }
-
-    // Allocate a buffer to store the extended attribute data
-    void* dataBuffer = malloc(dataSize);
-    if (dataBuffer == NULL) {
-        return QByteArray();
-    }
-
-    // Retrieve the extended attribute data
-    ssize_t actualDataSize = extattr_get_file(
-            m_file.fileName().toUtf8().constData(),
-            EXTATTR_NAMESPACE_USER,
-            attributeName.toUtf8().constData(),
-            dataBuffer, dataSize
-    );
-
-    if (actualDataSize < 0) {
-        free(dataBuffer);
-        return QByteArray();
-    }
-
-    QByteArray attributeValue = QByteArray::fromRawData((char*)dataBuffer, actualDataSize);
-    free(dataBuffer);
-    return attributeValue;
-
-#elif defined(__linux__)
-
-    // Read the extended attribute from the file in the "user" namespace
-    qDebug() << "Reading extended attribute" << attributeName << "from file" << m_file.fileName();
-    QProcess xattr;
-    xattr.start("getfattr",
-                QStringList() << "-n" << "user." + attributeName
-                            << "-d" << m_file.fileName());
-    if (!xattr.waitForFinished()) {
-        // Error reading extended attribute from user namespace
-        qWarning() << "ExtendedAttributes::read(): Error reading extended attribute from user "
-                      "namespace";
-        return QByteArray();
-    } else {
-        // Extended attribute was read successfully
-        qDebug() << "Extended attribute was read successfully";
-    }
-
-    QByteArray attributeValue = xattr.readAllStandardOutput().trimmed();
-    qDebug() << "ExtendedAttributes::read():" << attributeName << " " << attributeValue;
-    return attributeValue;
-
-#endif
-
+    return readUserAttribute(QFile::encodeName(m_file.fileName()), attributeName.toUtf8());
 }
 
 bool ExtendedAttributes::clear(const QString &attributeName) {
@@ -202,22 +257,104 @@ bool ExtendedAttributes::clear(const QString &attributeName) {
 #elif defined(__linux__)
 
     // Delete the extended attribute from the file in the "user" namespace
-    qDebug() << "Deleting extended attribute" << attributeName << "from file" << m_file.fileName();
-    QProcess xattr;
-    xattr.start("setfattr",
-                QStringList() << "-x" << "user." + attributeName
-                            << m_file.fileName());
-    if (!xattr.waitForFinished()) {
+    QByteArray path = QFile::encodeName(m_file.fileName());
+    QByteArray name = "user." + attributeName.toUtf8();
+    if (removexattr(path.constData(), name.constData()) == -1) {
+        if (errno == ENODATA) {
+            // Nothing to delete
+            return true;
+        }
+        if (errno == EACCES || errno == EPERM) {
+            // We are not allowed to write to the file; setfattr may be setuid root
+            return runSetfattr(QStringList() << "-x" << QString::fromUtf8(name));
+        }
         // Error deleting extended attribute from user namespace
-        qWarning() << "ExtendedAttributes::delete(): Error deleting extended attribute from user "
-                      "namespace";
+        qWarning() << "ExtendedAttributes::delete(): Error deleting extended attribute"
+                   << attributeName << "from file" << m_file.fileName() << ":" << strerror(errno);
         return false;
-    } else {
-        // Extended attribute was deleted successfully
-        qDebug() << "Extended attribute was deleted successfully";
     }
 
 #endif
 
     return true;
-}
\ No newline at end of file
+}
+
+QStringList ExtendedAttributes::list() {
+    QStringList names;
+
+    if (!m_file.exists()) {
+        // Error: File does not exist
+        qWarning() << "ExtendedAttributes::list(): File does not exist";
+        return names;
+    }
+
+    for (const QByteArray &name : listUserAttributes(QFile::encodeName(m_file.fileName()))) {
+        names.append(QString::fromUtf8(name));
+    }
+    return names;
+}
+
+ExtendedAttributes::AttributeTable ExtendedAttributes::readDirectory(const QString &directoryPath,
+                                                                     const QStringList &attributeNames,
+                                                                     const QStringList &fileNames) {
+    AttributeTable table;
+
+    QList<QByteArray> wantedNames;
+    for (const QString &attributeName : attributeNames) {
+        wantedNames.append(attributeName.toUtf8());
+    }
+
+    QStringList entries = fileNames;
+    if (entries.isEmpty()) {
+        DIR *dir = opendir(QFile::encodeName(directoryPath).constData());
+        if (!dir) {
+            qWarning() << "ExtendedAttributes::readDirectory(): Cannot open" << directoryPath;
+            return table;
+        }
+        while (struct dirent *entry = readdir(dir)) {
+            if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
+                entries.append(QFile::decodeName(entry->d_name));
+            }
+        }
+        closedir(dir);
+    }
+
+    QByteArray prefix = QFile::encodeName(directoryPath);
+    if (!prefix.endsWith('/')) {
+        prefix.append('/');
+    }
+    table.reserve(entries.size());
+    for (const QString &fileName : entries) {
+        QByteArray path = prefix + QFile::encodeName(fileName);
+        // One listing per file tells us which of the wanted attributes are worth reading;
+        // most files have none, so for them this is the only system call
+        bool exists;
+        const QList<QByteArray> presentNames = listUserAttributes(path, &exists);
+        struct stat st;
+        if (!exists && lstat(path.constData(), &st) != 0) {
+            // The file is gone; a dangling symlink is still an entry, just one without attributes
+            continue;
+        }
+        QHash<QString, QByteArray> &attributes = table[fileName];
+        for (const QByteArray &name : wantedNames) {
+            if (presentNames.contains(name)) {
+                attributes.insert(QString::fromUtf8(name), readUserAttribute(path, name));
+            }
+        }
+    }
+    return table;
+}
+
+#if defined(__linux__)
+bool ExtendedAttributes::runSetfattr(const QStringList &arguments) {
+    qDebug() << "Running setfattr" << arguments << "on file" << m_file.fileName();
+    QProcess xattr;
+    xattr.start("setfattr", QStringList() << arguments << m_file.fileName());
+    if (!xattr.waitForFinished() || xattr.exitStatus() != QProcess::NormalExit
+        || xattr.exitCode() != 0) {
+        qWarning() << "ExtendedAttributes: setfattr failed on file" << m_file.fileName();
+        return false;
+    }
+    return true;
+}
+#endif
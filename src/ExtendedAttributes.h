@@ -24,7 +24,9 @@
  * SUCH DAMAGE.
  */
 
-/* We are using command line tools to modify extended attributes because
+/* We are using the system calls to read and modify extended attributes because
+ * this is called for every item in every window. On Linux, we fall back to the
+ * command line tools when we lack the permission to modify an attribute, because
  * we can set those tools to setuid root. This allows us to set extended
  * attributes on files that we do not have write access to.
  */
@@ -34,6 +36,8 @@
 
 #include <QFile>
 #include <QByteArray>
+#include <QHash>
+#include <QStringList>
 
 /**
  * @brief The ExtendedAttributes class provides functionality to read and write extended attributes of a file.
@@ -41,6 +45,11 @@
 class ExtendedAttributes
 {
 public:
+    /**
+     * @brief Attribute values of several files, by file name and then by attribute name.
+     */
+    typedef QHash<QString, QHash<QString, QByteArray>> AttributeTable;
+
     /**
      * @brief Constructs an ExtendedAttributes object for the specified file.
      * @param filePath The path of the file to work with.
@@ -62,10 +71,45 @@ public:
      */
     QByteArray read(const QString &attributeName);
 
+    /**
+     * @brief Removes an extended attribute from the file.
+     * @param attributeName The name of the attribute to remove.
+     * @return True if the attribute was removed successfully, false otherwise.
+     */
     bool clear(const QString &attributeName);
 
+    /**
+     * @brief Lists the names of the extended attributes of the file in the "user" namespace.
+     * @return The names of the attributes without the namespace prefix.
+     */
+    QStringList list();
+
+    /**
+     * @brief Reads the given extended attributes of the entries of a directory in one sweep.
+     *
+     * The attribute names of each entry are listed once, and only those of the wanted
+     * attributes that are present are read. This is meant to be run on a worker thread.
+     * @param directoryPath The path of the directory.
+     * @param attributeNames The names of the attributes to read.
+     * @param fileNames The names of the entries to read, or an empty list for all entries.
+     * @return A table containing every entry that was read, with only the attributes present;
+     *         entries that no longer exist are left out.
+     */
+    static AttributeTable readDirectory(const QString &directoryPath,
+                                        const QStringList &attributeNames,
+                                        const QStringList &fileNames = QStringList());
+
 private:
     QFile m_file; /**< The file associated with extended attributes. */
+
+#if defined(__linux__)
+    /**
+     * @brief Runs setfattr, which may be setuid root, to modify an attribute we have no permission for.
+     * @param arguments The arguments for setfattr, without the file name.
+     * @return True if setfattr succeeded, false otherwise.
+     */
+    bool runSetfattr(const QStringList &arguments);
+#endif
 };
 
 #endif // EXTENDEDATTRIBUTES_H
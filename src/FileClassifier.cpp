@@ -0,0 +1,223 @@
+/*-
+ * Copyright (c) 2022-23 Simon Peter <probono@puredarwin.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "FileClassifier.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMimeDatabase>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QVector>
+
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+// How much of the beginning of a file we read; enough for the magic bytes QMimeDatabase checks
+const qint64 firstPageSize = 4096;
+
+// Remembered classifications are dropped all at once when there are more than this
+const int maximumCacheEntries = 20000;
+
+struct CacheEntry {
+    dev_t device;
+    ino_t inode;
+    struct timespec modified;
+    struct timespec changed;
+    FileClassifier::Classification classification;
+};
+
+QMutex cacheMutex;
+QHash<QString, CacheEntry> cache;
+
+bool isSameTime(const struct timespec &a, const struct timespec &b)
+{
+    return a.tv_sec == b.tv_sec && a.tv_nsec == b.tv_nsec;
+}
+
+// QMimeDatabase instances share their data, but constructing one still takes a lock
+const QMimeDatabase &mimeDatabase()
+{
+    static const QMimeDatabase database;
+    return database;
+}
+
+// Whether the current user may access a file as given by its mode, like access(2) would decide
+bool mayAccess(const struct stat &fileStat, mode_t ownerBit, mode_t groupBit, mode_t otherBit)
+{
+    static const uid_t userId = geteuid();
+    static const QVector<gid_t> groupIds = []() {
+        QVector<gid_t> ids(qMax(0, getgroups(0, nullptr)));
+        ids.resize(qMax(0, getgroups(ids.size(), ids.data())));
+        ids.append(getegid());
+        return ids;
+    }();
+
+    if (userId == 0) {
+        // root may read and write anything, and execute anything that anyone may execute
+        return ownerBit != S_IXUSR || S_ISDIR(fileStat.st_mode)
+                || (fileStat.st_mode & (S_IXUSR | S_IXGRP | S_IXOTH));
+    }
+    if (fileStat.st_uid == userId) {
+        return fileStat.st_mode & ownerBit;
+    }
+    if (groupIds.contains(fileStat.st_gid)) {
+        return fileStat.st_mode & groupBit;
+    }
+    return fileStat.st_mode & otherBit;
+}
+
+}
+
+FileClassifier::Classification FileClassifier::classify(const QString &path)
+{
+    QByteArray encodedPath = QFile::encodeName(path);
+    struct stat fileStat;
+    bool isSymLink = false;
+    if (lstat(encodedPath.constData(), &fileStat) != 0) {
+        return Classification();
+    }
+    if (S_ISLNK(fileStat.st_mode)) {
+        isSymLink = true;
+        if (stat(encodedPath.constData(), &fileStat) != 0) {
+            // A dangling symlink
+            Classification classification;
+            classification.flags = IsSymLink;
+            return classification;
+        }
+    }
+
+    {
+        QMutexLocker locker(&cacheMutex);
+        auto it = cache.constFind(path);
+        if (it != cache.constEnd() && it->device == fileStat.st_dev && it->inode == fileStat.st_ino
+            && isSameTime(it->modified, fileStat.st_mtim) && isSameTime(it->changed, fileStat.st_ctim)) {
+            return it->classification;
+        }
+    }
+
+    Classification classification = classifyUncached(path, fileStat, isSymLink);
+
+    QMutexLocker locker(&cacheMutex);
+    if (cache.size() >= maximumCacheEntries) {
+        cache.clear();
+    }
+    cache.insert(path, { fileStat.st_dev, fileStat.st_ino, fileStat.st_mtim, fileStat.st_ctim, classification });
+    return classification;
+}
+
+FileClassifier::Classification FileClassifier::classifyUncached(const QString &path, const struct stat &fileStat,
+                                                                bool isSymLink)
+{
+    Classification classification;
+    classification.flags |= Exists;
+    classification.size = fileStat.st_size;
+    if (isSymLink) {
+        classification.flags |= IsSymLink;
+    }
+    if (mayAccess(fileStat, S_IRUSR, S_IRGRP, S_IROTH)) {
+        classification.flags |= IsReadable;
+    }
+    if (mayAccess(fileStat, S_IWUSR, S_IWGRP, S_IWOTH)) {
+        classification.flags |= IsWritable;
+    }
+    if (mayAccess(fileStat, S_IXUSR, S_IXGRP, S_IXOTH)) {
+        classification.flags |= IsExecutable;
+    }
+
+    if (S_ISDIR(fileStat.st_mode)) {
+        classification.flags |= IsDirectory;
+        classification.mimeType = "inode/directory";
+        classification.bundleType = bundleTypeFor(path, true);
+        return classification;
+    }
+
+    // Read the first page once; everything below is decided from it
+    QByteArray firstPage;
+    if (S_ISREG(fileStat.st_mode) && (classification.flags & IsReadable)) {
+        int fd = open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) {
+            firstPage.resize(static_cast<int>(qMin<qint64>(firstPageSize, fileStat.st_size)));
+            ssize_t bytesRead = pread(fd, firstPage.data(), firstPage.size(), 0);
+            firstPage.resize(bytesRead > 0 ? static_cast<int>(bytesRead) : 0);
+            close(fd);
+        }
+    }
+
+    classification.mimeType = mimeDatabase().mimeTypeForFileNameAndData(path, firstPage).name();
+
+    // NOTE: Not all "application/..." MIME types are ELF executables, e.g., disk images
+    // have "application/..." MIME types, too
+    if (classification.mimeType == "application/x-executable"
+        || classification.mimeType == "application/x-pie-executable"
+        || classification.mimeType == "application/vnd-appimage") {
+        classification.flags |= IsElf;
+    }
+
+    // Disk images may start with a shebang, but we do not want to treat them as scripts
+    if (firstPage.startsWith("#!") && !classification.mimeType.contains("disk-image")) {
+        classification.flags |= HasShebang;
+    }
+
+    // AppImages are marked with "AI" and their type in the padding of the ELF identification
+    if (firstPage.size() >= 11 && firstPage.startsWith("\x7f" "ELF") && firstPage.at(8) == 'A'
+        && firstPage.at(9) == 'I' && (firstPage.at(10) == 1 || firstPage.at(10) == 2)) {
+        classification.flags |= IsAppImage;
+    }
+
+    classification.bundleType = bundleTypeFor(path, false);
+    return classification;
+}
+
+ApplicationBundle::Type FileClassifier::bundleTypeFor(const QString &path, bool isDirectory)
+{
+    ApplicationBundle::Type type = ApplicationBundle::Type::Unknown;
+    QFileInfo fileInfo(path);
+
+    if (isDirectory) {
+        QDir dir(path);
+        if (dir.exists("Resources") && QFileInfo(dir.filePath(fileInfo.completeBaseName())).isExecutable()) {
+            type = ApplicationBundle::Type::AppBundle;
+        } else if (QFileInfo(dir.filePath("AppRun")).isExecutable()) {
+            type = ApplicationBundle::Type::AppDir;
+        }
+    }
+
+    // TODO: Use MIME type instead of file extension; measure performance impact
+    QString fileName = fileInfo.fileName().toLower();
+    if (fileName.endsWith(".appimage")) {
+        type = ApplicationBundle::Type::AppImage;
+    }
+    if (fileName.endsWith(".desktop")) {
+        type = ApplicationBundle::Type::DesktopFile;
+    }
+    return type;
+}
@@ -0,0 +1,100 @@
+/*-
+ * Copyright (c) 2022-23 Simon Peter <probono@puredarwin.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef FILECLASSIFIER_H
+#define FILECLASSIFIER_H
+
+#include <QString>
+#include <QFlags>
+#include "ApplicationBundle.h"
+
+#include <sys/stat.h>
+
+/**
+ * @file FileClassifier.h
+ * @class FileClassifier
+ * @brief Classifies a file once and remembers the result for as long as the file does not change.
+ *
+ * Deciding how to show a file used to take a new QMimeDatabase lookup and another read of
+ * its first bytes for each question asked about it (is it executable, does it have a
+ * shebang, is it an ELF, is it a bundle, which application opens it). FileClassifier
+ * answers all of these questions from one stat and one read of the first page of the file.
+ *
+ * Results are remembered by path together with the device, inode, modification time and
+ * change time of the file, so a modified, replaced or chmod'ed file is classified again.
+ * All methods may be called from any thread.
+ */
+class FileClassifier
+{
+public:
+    /**
+     * @brief Properties of a file.
+     */
+    enum Flag {
+        Exists = 0x001,        ///< The file exists (after following symlinks).
+        IsDirectory = 0x002,   ///< The file is a directory.
+        IsSymLink = 0x004,     ///< The path itself is a symlink.
+        IsReadable = 0x008,    ///< We may read the file.
+        IsWritable = 0x010,    ///< We may write the file.
+        IsExecutable = 0x020,  ///< We may execute the file, or enter the directory.
+        HasShebang = 0x040,    ///< The file starts with "#!" and is not a disk image.
+        IsElf = 0x080,         ///< The file is an ELF executable or an AppImage, judging by its MIME type.
+        IsAppImage = 0x100     ///< The file carries the AppImage magic bytes in its ELF identification.
+    };
+    Q_DECLARE_FLAGS(Flags, Flag)
+
+    /**
+     * @brief What classify() found out about a file.
+     */
+    struct Classification {
+        Flags flags;           ///< The properties of the file.
+        QString mimeType;      ///< The name of the MIME type, e.g., "application/x-executable".
+        ApplicationBundle::Type bundleType = ApplicationBundle::Type::Unknown; ///< The kind of bundle, if any.
+        qint64 size = 0;       ///< The size of the file in bytes.
+    };
+
+    /**
+     * @brief Classifies a file, or returns the remembered classification if the file did not change.
+     * @param path The path of the file.
+     * @return The classification; Flag::Exists is not set if the file does not exist.
+     */
+    static Classification classify(const QString &path);
+
+private:
+    /**
+     * @brief Classifies a file without looking at the remembered classifications.
+     */
+    static Classification classifyUncached(const QString &path, const struct stat &fileStat, bool isSymLink);
+
+    /**
+     * @brief Determines the kind of bundle from the name and type of the file, like ApplicationBundle.
+     */
+    static ApplicationBundle::Type bundleTypeFor(const QString &path, bool isDirectory);
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(FileClassifier::Flags)
+
+#endif // FILECLASSIFIER_H
@@ -28,6 +28,7 @@
 #include "CustomItemDelegate.h"
 
 #include "FileOperationManager.h"
+#include "FileOperationQueueWindow.h"
 
 #include <QMenuBar>
 #include <QMenu>
@@ -66,6 +67,7 @@
 #include "ApplicationBundle.h"
 #include "TrashHandler.h"
 #include "InfoDialog.h"
+#include "ArchiveWindow.h"
 #include "AppGlobals.h"
 #include "CustomProxyModel.h"
 #include <QStorageInfo>
@@ -234,14 +236,22 @@ FileManagerMainWindow::FileManagerMainWindow(QWidget *parent, const QString &ini
     m_proxyModel->setDynamicSortFilter(true);
     m_proxyModel->setSortCaseSensitivity(Qt::CaseInsensitive);
 
-    // Sort by type, and within types, by name
-    m_proxyModel->setSortRole(Qt::DecorationRole);
+    // Sort by name; on the desktop, the root disk, mounted volumes and applications are ranked
+    // apart from other items (see CustomProxyModel::lessThan)
+    m_proxyModel->setSortRole(Qt::DisplayRole);
     m_proxyModel->sort(0, Qt::AscendingOrder);
 
     // Set the file system model as the model for the tree view and icon view
     m_treeView->setModel(m_proxyModel);
     m_iconView->setModel(m_proxyModel);
 
+    // Items are placed at their stored coordinates once their extended attributes have been prefetched
+    connect(m_fileSystemModel, &CustomFileSystemModel::attributesPrefetched, this, [this]() {
+        if (!m_treeViewAction->isChecked()) {
+            m_iconView->doItemsLayout();
+        }
+    });
+
     // Without this, every window just shows /
     m_treeView->setRootIndex(m_proxyModel->mapFromSource(m_fileSystemModel->index(m_currentDir)));
     m_iconView->setRootIndex(m_proxyModel->mapFromSource(m_fileSystemModel->index(m_currentDir)));
@@ -672,7 +682,7 @@ void FileManagerMainWindow::createMenus()
         QModelIndexList selectedIndexes = m_iconView->selectionModel()->selectedIndexes();
         for (QModelIndex index : selectedIndexes) {
             QString filePath = m_fileSystemModel->filePath(m_proxyModel->mapToSource(index));
-            openFolderInNewWindow(filePath);
+            showContents(filePath);
         }
     });
 
@@ -936,6 +946,9 @@ void FileManagerMainWindow::createMenus()
     connect(showHideStatusBarAction, &QAction::triggered, this,
             &FileManagerMainWindow::showHideStatusBar);
     m_showStatusBarAction->setCheckable(true);
+
+    viewMenu->addSeparator();
+    viewMenu->addAction(tr("Show File Operations"), this, []() { FileOperationQueueWindow::showQueue(); });
     m_menuBar->addMenu(viewMenu);
 
     connect(viewMenu, &QMenu::aboutToShow, this, [this, viewMenu]() {
@@ -1313,6 +1326,18 @@ void FileManagerMainWindow::setDirectory(const QString &directory)
     m_currentDir = directory;
 }
 
+// Shows the contents of a bundle; AppImages are files, so they get a window of their own
+void FileManagerMainWindow::showContents(const QString &filePath)
+{
+    ApplicationBundle bundle(filePath);
+    if (bundle.isValid() && bundle.type() == ApplicationBundle::Type::AppImage) {
+        ArchiveWindow *window = new ArchiveWindow(filePath);
+        window->show();
+    } else {
+        openFolderInNewWindow(filePath);
+    }
+}
+
 void FileManagerMainWindow::openFolderInNewWindow(const QString &rootPath)
 {
     qDebug() << Q_FUNC_INFO << rootPath;
@@ -87,6 +87,7 @@ public slots:
     void open(const QString &filePath);
     void openWith(const QString &filePath);
     void openFolderInNewWindow(const QString &rootPath);
+    void showContents(const QString &filePath);
     void renameSelectedItem();
     void resizeEvent(QResizeEvent *event);
 
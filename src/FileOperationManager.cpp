@@ -1,9 +1,12 @@
 #include "FileOperationManager.h"
+#include "AccessChecker.h"
+#include "FileOperationQueue.h"
+#include "FileOperationQueueWindow.h"
 #include <QCoreApplication>
 #include <QFile>
 #include <QFileInfo>
-#include <QProcess>
 #include <QMessageBox>
+#include <QThread>
 #include <QDebug>
 #include <QDir>
 
@@ -14,39 +17,30 @@ void FileOperationManager::executeFileOperation(const QStringList& fromPaths, co
         return;
     }
 
-    // Check if the source and destination trees are accessible by the current user;
-    // if not, the operation needs root privileges.
-    // TODO: We might also want to check whether the trees are on read-only media, in which case
-    // not even root can write to them.
-    bool operationNeedsRoot = false;
-    if (!areTreesAccessible(QStringList(toPath), Writable)) {
-        operationNeedsRoot = true;
-    }
+    // Check if the sources and the destination are accessible by the current user;
+    // if not, the operation needs root privileges. Files are only created in the destination
+    // directory itself, so what is below it does not matter.
+    AccessChecker::Report targetReport = AccessChecker::checkEntry(toPath, AccessChecker::Writable);
+    AccessChecker::Report sourceReport;
     if(operation == "--copy") {
-        if (!areTreesAccessible(fromPaths, Readable)) {
-            operationNeedsRoot = true;
-        }
+        sourceReport = AccessChecker::check(fromPaths, AccessChecker::Readable, checkerThreadCount());
     } else if(operation == "--move") {
-        if (!areTreesAccessible(fromPaths, Writable)) {
-            operationNeedsRoot = true;
-        }
+        sourceReport = AccessChecker::check(fromPaths, AccessChecker::Writable, checkerThreadCount());
     } else {
         qDebug() << "Invalid operation.";
         return;
     }
 
-    QString fileOperationBinary = findFileOperationBinary();
-    QProcess* process = new QProcess();
-
-    QStringList arguments;
-    arguments << operation;
-    for (const QString& fromPath : fromPaths) {
-        arguments << fromPath;
+    // Not even root can write to read-only media
+    if (targetReport.isReadOnly() || sourceReport.isReadOnly()) {
+        QMessageBox::critical(0, "Filer", QCoreApplication::translate("FileOperationManager",
+                                                                      "The disk is read-only."));
+        return;
     }
-    arguments << toPath;
+    bool operationNeedsRoot = !targetReport.isAccessible() || !sourceReport.isAccessible();
 
+    /*
     if (operationNeedsRoot) {
-        /*
         // Ask user whether to run the operation as root
         QMessageBox::StandardButton reply;
         // FIXME: Why does tr() not work here?
@@ -55,18 +49,16 @@ void FileOperationManager::executeFileOperation(const QStringList& fromPaths, co
         if (reply == QMessageBox::No) {
             return;
         }
-        */
-        process->setProgram("sudo");
-        QStringList sudoArguments;
-        sudoArguments << "-A" << "-E" << fileOperationBinary << arguments;
-        process->setArguments(sudoArguments);
-        qDebug() << "Executing file operation:" << sudoArguments;
-        process->start();
-    } else {
-        process->setProgram(fileOperationBinary);
-        process->setArguments(arguments);
-        qDebug() << "Executing file operation:" << fileOperationBinary << arguments;
-        process->start(fileOperationBinary, arguments);
+    }
+    */
+
+    // Jobs to the same device run one after the other; if this one has to wait, show the queue
+    FileOperationQueue *queue = FileOperationQueue::instance();
+    int jobId = queue->enqueue(operation, fromPaths, toPath, operationNeedsRoot);
+    for (const FileOperationQueue::Job &job : queue->jobs()) {
+        if (job.id == jobId && job.state == FileOperationQueue::Queued) {
+            FileOperationQueueWindow::showQueue();
+        }
     }
 }
 
@@ -104,61 +96,12 @@ QString FileOperationManager::findFileOperationBinary() {
 }
 
 bool FileOperationManager::areTreesAccessible(const QStringList &paths, AccessType accessType) {
-    for (const QString &path : paths) {
-        QDir rootDir(path);
-        if (accessType == Writable) {
-            if (!isTreeWritable(rootDir)) {
-                return false;
-            }
-        } else if (accessType == Readable) {
-            if (!isTreeReadable(rootDir)) {
-                return false;
-            }
-        }
-    }
-    return true;
+    AccessChecker::Access access = accessType == Writable ? AccessChecker::Writable : AccessChecker::Readable;
+    return AccessChecker::check(paths, access, checkerThreadCount()).isAccessible();
 }
 
-bool FileOperationManager::isTreeWritable(const QDir &dir) {
-    qDebug() << "Checking if tree is writable:" << dir.absolutePath();
-    QFileInfoList entries = dir.entryInfoList(QDir::NoDotAndDotDot | QDir::Files | QDir::Dirs | QDir::Hidden);
-
-    for (const QFileInfo &entry : entries) {
-        if (!entry.isWritable()) {
-            qDebug() << "Entry is not writable:" << entry.filePath();
-            return false;
-        }
-
-        if (entry.isDir()) {
-            QDir subDir(entry.filePath());
-            if (!isTreeWritable(subDir)) {
-                qDebug() << "Subtree is not writable:" << subDir.absolutePath();
-                return false;
-            }
-        }
-    }
-    qDebug() << "Tree is writable:" << dir.absolutePath();
-    return true;
+// Checking subtrees in parallel keeps several metadata reads in flight, but beyond a few
+// threads the disk rather than the CPU is the limit
+int FileOperationManager::checkerThreadCount() {
+    return qBound(1, QThread::idealThreadCount(), 4);
 }
-
-bool FileOperationManager::isTreeReadable(const QDir &dir) {
-    qDebug() << "Checking if tree is readable:" << dir.absolutePath();
-    QFileInfoList entries = dir.entryInfoList(QDir::NoDotAndDotDot | QDir::Files | QDir::Dirs | QDir::Hidden);
-
-    for (const QFileInfo &entry : entries) {
-        if (!entry.isReadable()) {
-            qDebug() << "Entry is not readable:" << entry.filePath();
-            return false;
-        }
-
-        if (entry.isDir()) {
-            QDir subDir(entry.filePath());
-            if (!isTreeReadable(subDir)) {
-                qDebug() << "Subtree is not readable:" << subDir.absolutePath();
-                return false;
-            }
-        }
-    }
-    qDebug() << "Tree is readable:" << dir.absolutePath();
-    return true;
-}
\ No newline at end of file
@@ -21,7 +21,9 @@ public:
     };
 
     /**
-     * @brief Check whether a list of paths is accessible (readable or writable).
+     * @brief Check whether a list of paths and everything below them is accessible (readable or writable).
+     *
+     * Stops at the first entry that is not; see AccessChecker for the details.
      * @param paths The list of paths to check.
      * @param accessType The type of access to check for.
      * @return True if the paths are accessible, false otherwise.
@@ -44,22 +46,22 @@ public:
 
     /**
      * @brief Finds the path to the file operation binary, 'fileoperation'.
-     * @note The binary should be shipped with this application. All file operation functionality is implemented in the binary.
+     * @note The binary should be shipped with this application. It is only used for operations that need root;
+     * the others run in-process (see FileOperationQueue).
      * @return The path to the binary.
      */
     static QString findFileOperationBinary();
 
 private:
     /**
-     * @brief Executes a file operation with progress.
+     * @brief Queues a file operation with progress; it runs once no other operation is writing to the same device.
      * @param fromPaths The list of source file paths.
      * @param toPath The destination folder path.
      * @param operation The operation to perform.
      */
     static void executeFileOperation(const QStringList& fromPaths, const QString& toPath, const QString& operation);
 
-    static bool isTreeWritable(const QDir &dir);
-    static bool isTreeReadable(const QDir &dir);
+    static int checkerThreadCount();
 
 };
 
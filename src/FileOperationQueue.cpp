@@ -0,0 +1,276 @@
+/*-
+ * Copyright (c) 2022-23 Simon Peter <probono@puredarwin.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "FileOperationQueue.h"
+#include "FileOperationManager.h"
+#include "FileOperation.h"
+#include <QFile>
+#include <QHash>
+#include <QTimer>
+#include <QDebug>
+#include <signal.h>
+#include <sys/stat.h>
+
+FileOperationQueue *FileOperationQueue::instance()
+{
+    // Never deleted, because deleting the processes would kill them
+    static FileOperationQueue *queue = new FileOperationQueue();
+    return queue;
+}
+
+FileOperationQueue::FileOperationQueue(QObject *parent) : QObject(parent), m_nextId(1)
+{
+}
+
+int FileOperationQueue::enqueue(const QString &operation, const QStringList &fromPaths, const QString &toPath,
+                                bool needsRoot)
+{
+    Job job;
+    job.id = m_nextId++;
+    job.operation = operation;
+    job.fromPaths = fromPaths;
+    job.toPath = toPath;
+    job.needsRoot = needsRoot;
+    job.state = Queued;
+    job.wasStarted = false;
+    job.fileOperation = nullptr;
+    job.process = nullptr;
+
+    // Jobs whose target we cannot stat get a device of their own, so they run right away
+    struct stat st;
+    if (stat(QFile::encodeName(toPath).constData(), &st) == 0) {
+        job.device = static_cast<quint64>(st.st_dev);
+    } else {
+        job.device = ~static_cast<quint64>(job.id);
+    }
+
+    m_jobs.append(job);
+    schedule();
+    if (m_jobs.at(indexOf(job.id)).state == Queued) {
+        qDebug() << "File operation" << job.id << "waits for the target device to become free";
+    }
+    emit jobsChanged();
+    return job.id;
+}
+
+QList<FileOperationQueue::Job> FileOperationQueue::jobs() const
+{
+    return m_jobs;
+}
+
+bool FileOperationQueue::pause(int jobId)
+{
+    int index = indexOf(jobId);
+    if (index < 0) {
+        return false;
+    }
+    Job &job = m_jobs[index];
+    if (job.state == Queued) {
+        job.state = Paused;
+    } else if (job.state == Running) {
+        if (job.fileOperation) {
+            job.fileOperation->setPaused(true);
+        } else if (job.needsRoot || !job.process
+                   || kill(static_cast<pid_t>(job.process->processId()), SIGSTOP) != 0) {
+            return false;
+        }
+        job.state = Paused;
+    } else {
+        return false;
+    }
+    emit jobsChanged();
+    return true;
+}
+
+void FileOperationQueue::resume(int jobId)
+{
+    int index = indexOf(jobId);
+    if (index < 0 || m_jobs.at(index).state != Paused) {
+        return;
+    }
+    Job &job = m_jobs[index];
+    if (job.wasStarted) {
+        if (job.fileOperation) {
+            job.fileOperation->setPaused(false);
+        } else {
+            kill(static_cast<pid_t>(job.process->processId()), SIGCONT);
+        }
+        job.state = Running;
+    } else {
+        job.state = Queued;
+        schedule();
+    }
+    emit jobsChanged();
+}
+
+void FileOperationQueue::cancel(int jobId)
+{
+    int index = indexOf(jobId);
+    if (index < 0) {
+        return;
+    }
+    Job &job = m_jobs[index];
+    if (job.wasStarted && job.fileOperation) {
+        // Also wakes a paused job; handleFinished() removes it
+        job.fileOperation->cancel();
+        return;
+    }
+    if (job.wasStarted) {
+        // fileoperation keeps its journal, so the job can be resumed later
+        if (job.state == Paused) {
+            kill(static_cast<pid_t>(job.process->processId()), SIGCONT);
+        }
+        job.process->terminate();
+        // handleFinished() removes the job
+        return;
+    }
+    m_jobs.removeAt(index);
+    emit jobsChanged();
+}
+
+void FileOperationQueue::move(int jobId, int offset)
+{
+    int index = indexOf(jobId);
+    int newIndex = index + offset;
+    if (index < 0 || newIndex < 0 || newIndex >= m_jobs.size() || m_jobs.at(index).wasStarted
+        || m_jobs.at(newIndex).wasStarted) {
+        return;
+    }
+    m_jobs.move(index, newIndex);
+    emit jobsChanged();
+}
+
+int FileOperationQueue::indexOf(int jobId) const
+{
+    for (int i = 0; i < m_jobs.size(); i++) {
+        if (m_jobs.at(i).id == jobId) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Starts queued jobs, in queue order, as long as their target devices are free
+void FileOperationQueue::schedule()
+{
+    // Stopped jobs keep their device busy, since they are in the middle of writing to it
+    QHash<quint64, int> jobsPerDevice;
+    for (const Job &job : m_jobs) {
+        if (job.wasStarted) {
+            jobsPerDevice[job.device]++;
+        }
+    }
+
+    for (Job &job : m_jobs) {
+        if (job.state == Queued && jobsPerDevice.value(job.device) < maxJobsPerDevice) {
+            jobsPerDevice[job.device]++;
+            start(job);
+        }
+    }
+}
+
+void FileOperationQueue::start(Job &job)
+{
+    const int jobId = job.id;
+    if (!job.needsRoot) {
+        // No need for another process with an application of its own
+        FileOperation *fileOperation = new FileOperation(this);
+        connect(fileOperation, &FileOperation::finished, this,
+                [this, jobId](int result) { handleFinished(jobId, result); });
+        job.fileOperation = fileOperation;
+        job.state = Running;
+        job.wasStarted = true;
+        qDebug() << "Executing file operation in-process:" << job.operation << job.fromPaths << job.toPath;
+
+        // Not right away, since we are called while the jobs are being iterated, and a move that fails
+        // shows a message box, whose event loop may change the jobs
+        const bool copy = job.operation == "--copy";
+        const QStringList fromPaths = job.fromPaths;
+        const QString toPath = job.toPath;
+        QTimer::singleShot(0, fileOperation, [this, jobId, fileOperation, copy, fromPaths, toPath]() {
+            bool started = copy ? fileOperation->copy(fromPaths, toPath) : fileOperation->move(fromPaths, toPath);
+            if (!started) {
+                handleFinished(jobId, 1);
+            }
+        });
+        return;
+    }
+
+    QString fileOperationBinary = FileOperationManager::findFileOperationBinary();
+    if (fileOperationBinary.isEmpty()) {
+        // The user has been told; the job ends like one that failed to start, which frees its device.
+        // Not right away, since we are called while the jobs are being iterated
+        job.state = Running;
+        QTimer::singleShot(0, this, [this, jobId]() { handleFinished(jobId, -1); });
+        return;
+    }
+
+    QStringList arguments;
+    arguments << job.operation;
+    for (const QString &fromPath : job.fromPaths) {
+        arguments << fromPath;
+    }
+    arguments << job.toPath;
+
+    QProcess *process = new QProcess(this);
+    connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this,
+            [this, jobId](int exitCode, QProcess::ExitStatus) { handleFinished(jobId, exitCode); });
+    connect(process, &QProcess::errorOccurred, this, [this, jobId](QProcess::ProcessError error) {
+        if (error == QProcess::FailedToStart) {
+            handleFinished(jobId, -1);
+        }
+    });
+
+    process->setProgram("sudo");
+    QStringList sudoArguments;
+    sudoArguments << "-A" << "-E" << fileOperationBinary << arguments;
+    process->setArguments(sudoArguments);
+    qDebug() << "Executing file operation:" << sudoArguments;
+
+    job.process = process;
+    job.state = Running;
+    job.wasStarted = true;
+    process->start();
+}
+
+void FileOperationQueue::handleFinished(int jobId, int exitCode)
+{
+    int index = indexOf(jobId);
+    if (index < 0) {
+        return;
+    }
+    qDebug() << "File operation" << jobId << "finished with exit code" << exitCode;
+    const Job &job = m_jobs.at(index);
+    if (job.fileOperation) {
+        job.fileOperation->deleteLater();
+    }
+    if (job.process) {
+        job.process->deleteLater();
+    }
+    m_jobs.removeAt(index);
+    schedule();
+    emit jobsChanged();
+}
@@ -0,0 +1,153 @@
+/*-
+ * Copyright (c) 2022-23 Simon Peter <probono@puredarwin.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef FILEOPERATIONQUEUE_H
+#define FILEOPERATIONQUEUE_H
+
+#include <QObject>
+#include <QList>
+#include <QProcess>
+#include <QString>
+#include <QStringList>
+
+class FileOperation;
+
+/**
+ * @file FileOperationQueue.h
+ * @class FileOperationQueue
+ * @brief Runs copy and move jobs, one at a time per target device.
+ *
+ * Several copies to the same disk that run in parallel are slower than the same copies one after
+ * the other, because the disk keeps seeking (or its flash controller keeps switching between files).
+ * Jobs are therefore queued by the device (st_dev) of their target directory: at most
+ * maxJobsPerDevice jobs run per device, while jobs for different devices run in parallel.
+ *
+ * Jobs we have permission for run in this process on a worker thread (see FileOperation); only jobs
+ * that need root run the 'fileoperation' binary through sudo. Those processes are not children of
+ * the application, so that closing the last window does not end them.
+ *
+ * Queued jobs can be paused, reordered and canceled; running jobs can be paused (in-process jobs
+ * are held between two chunks) and canceled. FileOperationQueueWindow shows the queue.
+ */
+class FileOperationQueue : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief The state of a job.
+     */
+    enum State {
+        Queued,  ///< Waiting for the target device to become free.
+        Running,
+        Paused   ///< Not started, or stopped, until resumed.
+    };
+
+    /**
+     * @brief A copy or move job.
+     */
+    struct Job {
+        int id;
+        QString operation;      ///< "--copy" or "--move".
+        QStringList fromPaths;
+        QString toPath;
+        bool needsRoot;         ///< The job is run through sudo.
+        quint64 device;         ///< st_dev of the target directory.
+        State state;
+        bool wasStarted;        ///< A paused job that is held rather than not started yet.
+        FileOperation *fileOperation; ///< The job when it runs in this process.
+        QProcess *process;            ///< The job when it runs through sudo.
+    };
+
+    /**
+     * @brief Returns the queue of the application.
+     */
+    static FileOperationQueue *instance();
+
+    /**
+     * @brief Adds a job to the queue; it starts right away if its target device is free.
+     * @param operation "--copy" or "--move".
+     * @param fromPaths The paths to copy or move.
+     * @param toPath The target directory.
+     * @param needsRoot Whether the job needs to be run through sudo.
+     * @return The ID of the job.
+     */
+    int enqueue(const QString &operation, const QStringList &fromPaths, const QString &toPath, bool needsRoot);
+
+    /**
+     * @brief Returns the jobs that are queued, running or paused, in the order in which they will run.
+     */
+    QList<Job> jobs() const;
+
+    /**
+     * @brief Holds a queued job back, or stops a running job.
+     *
+     * Running jobs that were started through sudo cannot be paused, since they do not belong to us.
+     * @return True if the job was paused.
+     */
+    bool pause(int jobId);
+
+    /**
+     * @brief Lets a paused job continue or be started again.
+     */
+    void resume(int jobId);
+
+    /**
+     * @brief Cancels a job; a running copy is asked to stop and keeps the files it has copied completely.
+     *
+     * A job that runs through sudo is terminated and can be resumed later with fileoperation --resume.
+     */
+    void cancel(int jobId);
+
+    /**
+     * @brief Moves a job that has not started yet one place earlier (-1) or later (1) in the queue.
+     */
+    void move(int jobId, int offset);
+
+    /**
+     * @brief The number of jobs that may run at the same time on one device.
+     */
+    static const int maxJobsPerDevice = 1;
+
+signals:
+    /**
+     * @brief Emitted whenever a job was added, started, paused, reordered or has ended.
+     */
+    void jobsChanged();
+
+private:
+    explicit FileOperationQueue(QObject *parent = nullptr);
+
+    int indexOf(int jobId) const;
+    void schedule();
+    void start(Job &job);
+    void handleFinished(int jobId, int exitCode);
+
+    QList<Job> m_jobs;
+    int m_nextId;
+};
+
+#endif // FILEOPERATIONQUEUE_H
@@ -0,0 +1,161 @@
+/*-
+ * Copyright (c) 2022-23 Simon Peter <probono@puredarwin.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "FileOperationQueueWindow.h"
+#include "FileOperationQueue.h"
+
+#include <QFileInfo>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QPointer>
+#include <QVBoxLayout>
+
+void FileOperationQueueWindow::showQueue()
+{
+    static QPointer<FileOperationQueueWindow> window;
+    if (!window) {
+        window = new FileOperationQueueWindow();
+    }
+    window->show();
+    window->raise();
+    window->activateWindow();
+}
+
+FileOperationQueueWindow::FileOperationQueueWindow(QWidget *parent)
+    : QWidget(parent)
+{
+    setAttribute(Qt::WA_DeleteOnClose);
+    setWindowTitle(tr("File Operations"));
+
+    m_jobList = new QTreeWidget(this);
+    m_jobList->setColumnCount(3);
+    m_jobList->setHeaderLabels({ tr("Operation"), tr("Destination"), tr("Status") });
+    m_jobList->setRootIsDecorated(false);
+    m_jobList->setUniformRowHeights(true);
+    m_jobList->header()->setStretchLastSection(false);
+    m_jobList->header()->setSectionResizeMode(0, QHeaderView::Stretch);
+    m_jobList->header()->setSectionResizeMode(1, QHeaderView::ResizeToContents);
+    m_jobList->header()->setSectionResizeMode(2, QHeaderView::ResizeToContents);
+
+    m_pauseButton = new QPushButton(tr("Pause"), this);
+    m_upButton = new QPushButton(tr("Move Up"), this);
+    m_downButton = new QPushButton(tr("Move Down"), this);
+    m_cancelButton = new QPushButton(tr("Cancel"), this);
+
+    QHBoxLayout *buttonLayout = new QHBoxLayout;
+    buttonLayout->addWidget(m_pauseButton);
+    buttonLayout->addWidget(m_upButton);
+    buttonLayout->addWidget(m_downButton);
+    buttonLayout->addStretch();
+    buttonLayout->addWidget(m_cancelButton);
+
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+    mainLayout->addWidget(m_jobList);
+    mainLayout->addLayout(buttonLayout);
+
+    FileOperationQueue *queue = FileOperationQueue::instance();
+    connect(queue, &FileOperationQueue::jobsChanged, this, &FileOperationQueueWindow::updateJobs);
+    connect(m_jobList, &QTreeWidget::itemSelectionChanged, this, &FileOperationQueueWindow::updateButtons);
+    connect(m_pauseButton, &QPushButton::clicked, this, [this, queue]() {
+        int jobId = selectedJobId();
+        for (const FileOperationQueue::Job &job : queue->jobs()) {
+            if (job.id == jobId && job.state == FileOperationQueue::Paused) {
+                queue->resume(jobId);
+                return;
+            }
+        }
+        queue->pause(jobId);
+    });
+    connect(m_upButton, &QPushButton::clicked, this, [this, queue]() { queue->move(selectedJobId(), -1); });
+    connect(m_downButton, &QPushButton::clicked, this, [this, queue]() { queue->move(selectedJobId(), 1); });
+    connect(m_cancelButton, &QPushButton::clicked, this, [this, queue]() { queue->cancel(selectedJobId()); });
+
+    updateJobs();
+    resize(500, 250);
+}
+
+void FileOperationQueueWindow::updateJobs()
+{
+    const int selectedId = selectedJobId();
+    m_jobList->clear();
+
+    for (const FileOperationQueue::Job &job : FileOperationQueue::instance()->jobs()) {
+        QString name = job.fromPaths.size() == 1 ? QFileInfo(job.fromPaths.first()).fileName()
+                                                 : tr("%n items", nullptr, job.fromPaths.size());
+        QString operation = job.operation == "--move" ? tr("Move %1").arg(name) : tr("Copy %1").arg(name);
+
+        QString status;
+        switch (job.state) {
+        case FileOperationQueue::Queued:
+            status = tr("Waiting");
+            break;
+        case FileOperationQueue::Running:
+            status = tr("Running");
+            break;
+        case FileOperationQueue::Paused:
+            status = tr("Paused");
+            break;
+        }
+
+        QTreeWidgetItem *item = new QTreeWidgetItem(m_jobList, { operation, job.toPath, status });
+        item->setData(0, Qt::UserRole, job.id);
+        item->setToolTip(0, job.fromPaths.join("\n"));
+        if (job.id == selectedId) {
+            item->setSelected(true);
+        }
+    }
+
+    updateButtons();
+}
+
+void FileOperationQueueWindow::updateButtons()
+{
+    const int jobId = selectedJobId();
+    bool found = false;
+    bool canPause = false;
+    bool isPaused = false;
+    bool canMove = false;
+    for (const FileOperationQueue::Job &job : FileOperationQueue::instance()->jobs()) {
+        if (job.id == jobId) {
+            found = true;
+            isPaused = job.state == FileOperationQueue::Paused;
+            canPause = isPaused || job.state == FileOperationQueue::Queued || !job.needsRoot;
+            canMove = !job.wasStarted;
+        }
+    }
+
+    m_pauseButton->setText(isPaused ? tr("Resume") : tr("Pause"));
+    m_pauseButton->setEnabled(found && canPause);
+    m_upButton->setEnabled(found && canMove);
+    m_downButton->setEnabled(found && canMove);
+    m_cancelButton->setEnabled(found);
+}
+
+int FileOperationQueueWindow::selectedJobId() const
+{
+    const QList<QTreeWidgetItem *> items = m_jobList->selectedItems();
+    return items.isEmpty() ? -1 : items.first()->data(0, Qt::UserRole).toInt();
+}
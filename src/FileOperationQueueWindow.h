@@ -24,39 +24,43 @@
  * SUCH DAMAGE.
  */
 
-#ifndef MOUNTWATCHERTHREAD_H
-#define MOUNTWATCHERTHREAD_H
+#ifndef FILEOPERATIONQUEUEWINDOW_H
+#define FILEOPERATIONQUEUEWINDOW_H
 
-#include <QThread>
+#include <QWidget>
+#include <QTreeWidget>
+#include <QPushButton>
 
 /**
- * @brief The MountWatcherThread class provides a threaded mechanism for
- *        watching and creating symlinks for mounted volumes. This class exists to make
- *        waiting for the mounting to happen asynchronous, not blocking everything else.
- *        QStorageInfo doesn't provide a built-in mechanism to notify when mounted volumes change;
- *        if it did, we would not need this.
+ * @file FileOperationQueueWindow.h
+ * @class FileOperationQueueWindow
+ * @brief A window that lists the jobs of the FileOperationQueue and lets the user pause, reorder and cancel them.
+ *
+ * There is at most one such window; showQueue() creates it or brings it to the front.
+ * It is shown automatically when a job has to wait for another one.
  */
-class MountWatcherThread : public QThread {
+class FileOperationQueueWindow : public QWidget
+{
 Q_OBJECT
 
 public:
     /**
-     * @brief Constructs a MountWatcherThread object.
-     * @param fullPath The full path of the mount point.
-     * @param symlinkPath The path where the symlink should be created.
-     */
-    MountWatcherThread(const QString &fullPath, const QString &symlinkPath);
-
-protected:
-    /**
-     * @brief The overridden run method that performs the async logic for
-     *        watching and creating symlinks.
+     * @brief Shows the window, creating it if needed.
      */
-    void run() override;
+    static void showQueue();
 
 private:
-    QString fullPath; ///< The full path of the mount point.
-    QString symlinkPath; ///< The path where the symlink should be created.
+    explicit FileOperationQueueWindow(QWidget *parent = nullptr);
+
+    void updateJobs();
+    void updateButtons();
+    int selectedJobId() const;
+
+    QTreeWidget *m_jobList;
+    QPushButton *m_pauseButton;
+    QPushButton *m_upButton;
+    QPushButton *m_downButton;
+    QPushButton *m_cancelButton;
 };
 
-#endif // MOUNTWATCHERTHREAD_H
+#endif // FILEOPERATIONQUEUEWINDOW_H
@@ -0,0 +1,205 @@
+/*-
+ * Copyright (c) 2022-23 Simon Peter <probono@puredarwin.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "IconCache.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QDebug>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <string.h>
+#include <time.h>
+
+namespace {
+
+// The largest icon size we need; the Get Info dialog shows icons at 128x128
+const int maximumIconSize = 128;
+
+// The cache is trimmed to three quarters of this size when it grows beyond it
+const qint64 maximumCacheSize = 64 * 1024 * 1024;
+
+// Entries are only marked as recently used if they have not been for this long,
+// so that a hit does not always cost a write
+const time_t recentlyUsedInterval = 24 * 60 * 60;
+
+// The layout of a cache entry; the pixels in QImage::Format_ARGB32_Premultiplied follow the header
+struct EntryHeader {
+    char magic[4];
+    quint32 width;
+    quint32 height;
+    quint32 bytesPerLine;
+};
+
+const char entryMagic[4] = { 'F', 'I', 'C', '1' };
+
+QMutex cacheMutex; // Guards cacheSize and the eviction
+qint64 cacheSize = -1; // The total size of the entries, or -1 if not determined yet
+
+QString cacheDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + "/Filer/icons";
+}
+
+}
+
+QString IconCache::entryPath(const QString &filePath)
+{
+    struct stat fileStat;
+    if (stat(QFile::encodeName(filePath).constData(), &fileStat) != 0) {
+        return QString();
+    }
+
+    QByteArray key = QFile::encodeName(filePath);
+    key += '\0' + QByteArray::number(static_cast<qulonglong>(fileStat.st_dev));
+    key += '\0' + QByteArray::number(static_cast<qulonglong>(fileStat.st_ino));
+    key += '\0' + QByteArray::number(static_cast<qlonglong>(fileStat.st_mtim.tv_sec));
+    key += '.' + QByteArray::number(static_cast<qlonglong>(fileStat.st_mtim.tv_nsec));
+    key += '\0' + QByteArray::number(static_cast<qlonglong>(fileStat.st_size));
+    return cacheDirectory() + "/"
+            + QString::fromLatin1(QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex());
+}
+
+QImage IconCache::load(const QString &filePath)
+{
+    QString path = entryPath(filePath);
+    if (path.isEmpty()) {
+        return QImage();
+    }
+
+    QFile entry(path);
+    if (!entry.open(QIODevice::ReadOnly) || entry.size() < static_cast<qint64>(sizeof(EntryHeader))) {
+        return QImage();
+    }
+    uchar *data = entry.map(0, entry.size());
+    if (!data) {
+        return QImage();
+    }
+
+    EntryHeader header;
+    memcpy(&header, data, sizeof(header));
+    QImage image;
+    if (memcmp(header.magic, entryMagic, sizeof(entryMagic)) == 0
+        && header.width > 0 && header.width <= static_cast<quint32>(maximumIconSize)
+        && header.height > 0 && header.height <= static_cast<quint32>(maximumIconSize)
+        && header.bytesPerLine >= header.width * 4
+        && sizeof(header) + static_cast<qint64>(header.bytesPerLine) * header.height <= entry.size()) {
+        // Copy the pixels; the mapping goes away with the file
+        image = QImage(data + sizeof(header), header.width, header.height, header.bytesPerLine,
+                       QImage::Format_ARGB32_Premultiplied).copy();
+    } else {
+        qWarning() << "IconCache: Ignoring corrupt entry" << path;
+    }
+    entry.unmap(data);
+
+    // The modification time of an entry tells when it was last used
+    struct stat entryStat;
+    if (!image.isNull() && fstat(entry.handle(), &entryStat) == 0
+        && entryStat.st_mtime < time(nullptr) - recentlyUsedInterval) {
+        futimens(entry.handle(), nullptr);
+    }
+
+    return image;
+}
+
+void IconCache::store(const QString &filePath, const QImage &image)
+{
+    if (image.isNull()) {
+        return;
+    }
+    QString path = entryPath(filePath);
+    if (path.isEmpty()) {
+        return;
+    }
+
+    QImage scaledImage = image;
+    if (image.width() > maximumIconSize || image.height() > maximumIconSize) {
+        scaledImage = image.scaled(maximumIconSize, maximumIconSize, Qt::KeepAspectRatio,
+                                   Qt::SmoothTransformation);
+    }
+    scaledImage = scaledImage.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+    EntryHeader header;
+    memcpy(header.magic, entryMagic, sizeof(entryMagic));
+    header.width = scaledImage.width();
+    header.height = scaledImage.height();
+    header.bytesPerLine = scaledImage.bytesPerLine();
+
+    QDir().mkpath(cacheDirectory());
+    // Write to a temporary file first so that other threads never see a partial entry
+    QSaveFile entry(path);
+    if (!entry.open(QIODevice::WriteOnly)) {
+        qWarning() << "IconCache: Cannot write" << path;
+        return;
+    }
+    entry.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    entry.write(reinterpret_cast<const char *>(scaledImage.constBits()),
+                static_cast<qint64>(header.bytesPerLine) * header.height);
+    if (!entry.commit()) {
+        qWarning() << "IconCache: Cannot write" << path;
+        return;
+    }
+
+    evictIfNeeded(sizeof(header) + static_cast<qint64>(header.bytesPerLine) * header.height);
+}
+
+void IconCache::evictIfNeeded(qint64 addedSize)
+{
+    QMutexLocker locker(&cacheMutex);
+
+    QDir directory(cacheDirectory());
+    if (cacheSize < 0) {
+        // Determine the size once; after that, we keep track of it ourselves
+        cacheSize = 0;
+        for (const QFileInfo &entry : directory.entryInfoList(QDir::Files | QDir::NoDotAndDotDot)) {
+            cacheSize += entry.size();
+        }
+    } else {
+        cacheSize += addedSize;
+    }
+
+    if (cacheSize <= maximumCacheSize) {
+        return;
+    }
+
+    // Remove the least recently used entries first
+    const QFileInfoList entries = directory.entryInfoList(QDir::Files | QDir::NoDotAndDotDot,
+                                                          QDir::Time | QDir::Reversed);
+    for (const QFileInfo &entry : entries) {
+        if (cacheSize <= maximumCacheSize * 3 / 4) {
+            break;
+        }
+        if (QFile::remove(entry.absoluteFilePath())) {
+            cacheSize -= entry.size();
+        }
+    }
+}
@@ -0,0 +1,83 @@
+/*-
+ * Copyright (c) 2022-23 Simon Peter <probono@puredarwin.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef ICONCACHE_H
+#define ICONCACHE_H
+
+#include <QString>
+#include <QImage>
+
+/**
+ * @file IconCache.h
+ * @class IconCache
+ * @brief A persistent cache for icons that are expensive to extract from files.
+ *
+ * Extracting the icon of an AppImage means reading its squashfs, and extracting the icon
+ * of an .exe means running icoextract; without a cache, this is repeated for every file
+ * after every login. IconCache keeps the extracted icons, scaled down to the sizes the
+ * views use, under ~/.cache/Filer/icons.
+ *
+ * An entry is keyed by the path, device, inode, modification time and size of the file
+ * it belongs to, so a changed file simply misses the cache; its outdated entry is never
+ * read again and eventually gets evicted. Entries hold raw pixels, so a hit costs one
+ * stat of the file plus one mapped read of the entry. When the cache grows beyond its
+ * size limit, the least recently used entries are removed.
+ *
+ * All methods may be called from any thread.
+ */
+class IconCache
+{
+public:
+    /**
+     * @brief Returns the cached icon image for a file.
+     * @param filePath The path of the file the icon belongs to.
+     * @return The image, or a null QImage if there is no entry for the file in its current state.
+     */
+    static QImage load(const QString &filePath);
+
+    /**
+     * @brief Stores the icon image for a file, scaled down if it is larger than the largest size we need.
+     * @param filePath The path of the file the icon belongs to.
+     * @param image The icon image.
+     */
+    static void store(const QString &filePath, const QImage &image);
+
+private:
+    /**
+     * @brief Returns the path of the cache entry for the file in its current state.
+     * @param filePath The path of the file.
+     * @return The path of the entry, or an empty string if the file cannot be accessed.
+     */
+    static QString entryPath(const QString &filePath);
+
+    /**
+     * @brief Removes the least recently used entries if the cache exceeds its size limit.
+     * @param addedSize The size of an entry that was just written.
+     */
+    static void evictIfNeeded(qint64 addedSize);
+};
+
+#endif // ICONCACHE_H
@@ -0,0 +1,142 @@
+/*-
+ * Copyright (c) 2022-23 Simon Peter <probono@puredarwin.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "IconResolver.h"
+#include "CustomFileIconProvider.h"
+
+#include <QRunnable>
+#include <QFileInfo>
+#include <QPixmap>
+#include <QDebug>
+
+/**
+ * @brief Reads the images for the icon of one file on a worker thread of an IconResolver.
+ *
+ * Nothing here may use the icon theme; IconResolver::handleResolved() makes the icon
+ * on the GUI thread.
+ */
+class IconJob : public QRunnable
+{
+public:
+    IconJob(IconResolver *resolver, const QString &filePath, qint64 lastModified,
+            const QString &openWith, const QByteArray &userIconData)
+        : m_resolver(resolver),
+          m_filePath(filePath),
+          m_lastModified(lastModified),
+          m_openWith(openWith),
+          m_userIconData(userIconData)
+    {
+    }
+
+    void run() override
+    {
+        const CustomFileIconProvider *iconProvider = m_resolver->m_iconProvider;
+        QImage userImage = iconProvider->userIconImage(m_userIconData);
+        QImage fileImage;
+        if (userImage.isNull()) {
+            // Construct our own QFileInfo; QFileInfo objects must not be shared between threads.
+            // Documents show the icon of the application that opens them
+            fileImage = iconProvider->fileIconImage(QFileInfo(m_openWith.isEmpty() ? m_filePath : m_openWith));
+        }
+
+        // Hand the result over to the thread the resolver lives in
+        IconResolver *resolver = m_resolver;
+        QString filePath = m_filePath;
+        qint64 lastModified = m_lastModified;
+        QString openWith = m_openWith;
+        QMetaObject::invokeMethod(
+                resolver,
+                [resolver, filePath, lastModified, openWith, userImage, fileImage]() {
+                    resolver->handleResolved(filePath, lastModified, openWith, userImage, fileImage);
+                },
+                Qt::QueuedConnection);
+    }
+
+private:
+    IconResolver *m_resolver;
+    QString m_filePath;
+    qint64 m_lastModified;
+    QString m_openWith;
+    QByteArray m_userIconData;
+};
+
+IconResolver::IconResolver(const CustomFileIconProvider *iconProvider, QObject *parent)
+    : QObject(parent), m_iconProvider(iconProvider)
+{
+    // Enough for the items of a few windows; icons that are dropped are resolved again when needed
+    m_icons.setMaxCost(4096);
+}
+
+IconResolver::~IconResolver()
+{
+    // Jobs post their results to this object, so none of them may outlive it
+    m_threadPool.clear();
+    m_threadPool.waitForDone();
+}
+
+QIcon IconResolver::icon(const QString &filePath, qint64 lastModified, const QString &openWith,
+                         const QByteArray &userIconData)
+{
+    const Entry *entry = m_icons.object(filePath);
+    if (entry && entry->lastModified == lastModified && entry->openWith == openWith) {
+        return entry->icon;
+    }
+
+    if (!m_pending.contains(filePath)) {
+        m_pending.insert(filePath);
+        m_threadPool.start(new IconJob(this, filePath, lastModified, openWith, userIconData), m_nextPriority++);
+    }
+
+    // Keep showing the outdated icon, if any, until the new one is ready
+    if (entry) {
+        return entry->icon;
+    }
+    return QIcon();
+}
+
+void IconResolver::invalidate(const QString &filePath)
+{
+    m_icons.remove(filePath);
+}
+
+void IconResolver::handleResolved(const QString &filePath, qint64 lastModified,
+                                  const QString &openWith, const QImage &userImage, const QImage &fileImage)
+{
+    m_pending.remove(filePath);
+
+    QFileInfo fileInfo(filePath);
+    QIcon icon;
+    if (!userImage.isNull()) {
+        icon = QIcon(QPixmap::fromImage(userImage));
+    } else if (!openWith.isEmpty()) {
+        icon = m_iconProvider->documentIcon(fileInfo, openWith, fileImage);
+    } else {
+        icon = m_iconProvider->icon(fileInfo, fileImage);
+    }
+    m_icons.insert(filePath, new Entry { lastModified, openWith, icon });
+
+    emit iconReady(filePath);
+}
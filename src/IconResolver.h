@@ -0,0 +1,124 @@
+/*-
+ * Copyright (c) 2022-23 Simon Peter <probono@puredarwin.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef ICONRESOLVER_H
+#define ICONRESOLVER_H
+
+#include <QObject>
+#include <QIcon>
+#include <QImage>
+#include <QCache>
+#include <QSet>
+#include <QThreadPool>
+
+class CustomFileIconProvider;
+
+/**
+ * @file IconResolver.h
+ * @class IconResolver
+ * @brief Resolves file icons on a pool of worker threads.
+ *
+ * Generating an icon can be expensive (e.g., reading the squashfs of an AppImage or
+ * running icoextract on an .exe), so CustomFileSystemModel must not do it on the GUI thread.
+ * IconResolver returns the icon immediately if it has already been resolved; otherwise it
+ * queues a job on its thread pool and emits iconReady() once the icon is available.
+ *
+ * The jobs only read the images that come with the files. The icons are made from them
+ * on the GUI thread, because the icon theme (QIcon::fromTheme() and friends) is not
+ * thread-safe.
+ *
+ * Jobs are started last in, first out: the items that were requested most recently are
+ * the ones the view is currently painting, so visible items get their icons before
+ * items that were only touched while sorting or scrolling past.
+ */
+class IconResolver : public QObject
+{
+Q_OBJECT
+
+public:
+    /**
+     * @brief Constructs an IconResolver that uses the given icon provider in its worker threads.
+     * @param iconProvider The icon provider; must outlive the IconResolver.
+     * @param parent The parent QObject.
+     */
+    explicit IconResolver(const CustomFileIconProvider *iconProvider, QObject *parent = nullptr);
+
+    /**
+     * @brief Waits for running jobs to finish and discards queued ones.
+     */
+    ~IconResolver() override;
+
+    /**
+     * @brief Returns the icon for the file if it has already been resolved.
+     *
+     * If the icon has not been resolved yet (or the file or its open-with application
+     * changed since), a job is queued and a null QIcon is returned; iconReady() is
+     * emitted once the icon is available.
+     * @param filePath The absolute path of the file.
+     * @param lastModified The modification time of the file in ms since the epoch; used to detect changes.
+     * @param openWith The application that opens the file, or an empty string.
+     * @param userIconData The value of the "user-icon" extended attribute of the file, if any.
+     * @return The icon, or a null QIcon if it is not available yet.
+     */
+    QIcon icon(const QString &filePath, qint64 lastModified, const QString &openWith,
+               const QByteArray &userIconData = QByteArray());
+
+    /**
+     * @brief Forgets the icon for the given file so that it gets resolved again when requested.
+     * @param filePath The absolute path of the file.
+     */
+    void invalidate(const QString &filePath);
+
+signals:
+    /**
+     * @brief Emitted on the GUI thread when the icon for a file has been resolved.
+     * @param filePath The absolute path of the file.
+     */
+    void iconReady(const QString &filePath);
+
+private:
+    /**
+     * @brief A resolved icon together with the state of the file it was resolved for.
+     */
+    struct Entry {
+        qint64 lastModified;
+        QString openWith;
+        QIcon icon;
+    };
+
+    void handleResolved(const QString &filePath, qint64 lastModified, const QString &openWith,
+                        const QImage &userImage, const QImage &fileImage);
+
+    friend class IconJob;
+
+    const CustomFileIconProvider *m_iconProvider; ///< Reads the images on the worker threads and makes the icons.
+    QThreadPool m_threadPool; ///< The worker threads.
+    QCache<QString, Entry> m_icons; ///< Resolved icons by file path; the least recently used are dropped.
+    QSet<QString> m_pending; ///< File paths for which a job is queued or running.
+    int m_nextPriority = 0; ///< Increases with every job so that the newest job runs first.
+};
+
+#endif // ICONRESOLVER_H
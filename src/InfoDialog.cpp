@@ -37,6 +37,7 @@
 #include <QGraphicsPixmapItem>
 #include <QDebug>
 #include <QMimeDatabase>
+#include "FileClassifier.h"
 #include "ApplicationBundle.h"
 #include "CustomFileSystemModel.h"
 #include "CustomItemDelegate.h"
@@ -203,7 +204,7 @@ void InfoDialog::setupInformation()
     model->setSourceModel(sourceModel);
 
     QModelIndex index = model->mapFromSource(sourceModel->index(filePath));
-    QIcon i = model->data(index, Qt::DecorationRole).value<QIcon>();
+    QIcon i = sourceModel->resolvedIcon(model->mapToSource(index));
     ui->iconInfo->setPixmap(i.pixmap(32, 32));
 
     openWith = sourceModel->openWith(filePath); // Used below
@@ -226,8 +227,8 @@ void InfoDialog::setupInformation()
 
     ui->typeInfo->setText(tr("Unknown"));
 
-    QMimeDatabase *db = new QMimeDatabase();
-    QMimeType mime = db->mimeTypeForFile(filePath);
+    QMimeDatabase db;
+    QMimeType mime = db.mimeTypeForName(FileClassifier::classify(filePath).mimeType);
     // Get the description of the MIME type
     QString description = mime.comment();
     if (!description.isEmpty()) {
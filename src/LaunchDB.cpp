@@ -25,38 +25,70 @@
  */
 
 #include "LaunchDB.h"
+#include "FileClassifier.h"
 #include <QDir>
 #include <QDebug>
+#include <QCoreApplication>
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QReadWriteLock>
+#include <QSet>
 
-LaunchDB::LaunchDB() {
-    db = new QMimeDatabase;
-}
-
-LaunchDB::~LaunchDB() {
-    delete db;
-}
+namespace {
 
-QString LaunchDB::applicationForFile(const QFileInfo &fileInfo) const {
-    // Check if the file exists
-    if (!fileInfo.exists()) {
-        return QString(); // Return an empty QString if the file doesn't exist
+/**
+ * @brief The default application for each MIME type, as found in the launch database.
+ *
+ * The launch database is read once and then kept up to date from file system notifications
+ * (inotify on Linux, kqueue on FreeBSD): a change to ~/.local/share/launch/MIME only rereads
+ * the MIME type directories that were added or removed, and a change to one of those
+ * directories only rereads that directory. Lookups are a hash probe plus a check that the
+ * application still exists, and may be made from any thread.
+ */
+class LaunchDBIndex
+{
+public:
+    static LaunchDBIndex *instance()
+    {
+        // Thread-safe since C++11; the index lives for as long as the application
+        static LaunchDBIndex *index = new LaunchDBIndex();
+        return index;
     }
 
-    // Resolve symlinks and get absolute path
-    QString absoluteFilePath = fileInfo.absoluteFilePath();
-    // If it is a symlink, then resolve it
-    if (fileInfo.isSymLink()) {
-        absoluteFilePath = fileInfo.symLinkTarget();
+    QString application(const QString &mimeType)
+    {
+        const QString mimeDirName = QString(mimeType).replace("/", "_");
+        QString application;
+        bool known;
+        {
+            QReadLocker locker(&m_lock);
+            application = m_applications.value(mimeDirName);
+            known = m_mimeDirNames.contains(mimeDirName);
+        }
+        // The watcher only sees changes to the launch database, not to the applications its symlinks point to;
+        // if one was deleted or moved, or one that was missing is back, the directory is read again
+        if (known && (application.isEmpty() || !QFileInfo::exists(application))) {
+            application = refreshDirectory(mimeDirName);
+        }
+        return application;
     }
 
-    // Get the MIME type of the file
-    QMimeType mimeType = db->mimeTypeForFile(absoluteFilePath);
-    // qDebug("");
-    // qDebug("'%s' has MIME type '%s'", qPrintable(absoluteFilePath), qPrintable(mimeType.name()));
+private:
+    LaunchDBIndex() : m_root(QDir::homePath() + "/.local/share/launch/MIME")
+    {
+        reload();
 
-    // If we have "text/x-pdf, see whether ~/.local/share/launch/MIME/text_x-pdf/ exists (just as an example)
-    QString mimeDir = QDir::homePath() + "/.local/share/launch/MIME/" + mimeType.name().replace("/", "_");
-    if (QDir(mimeDir).exists()) {
+        // The watcher needs the event loop of the main thread, but we may be
+        // created on any thread, e.g., by an icon job
+        if (QCoreApplication::instance()) {
+            QMetaObject::invokeMethod(QCoreApplication::instance(), [this]() { startWatching(); },
+                                      Qt::QueuedConnection);
+        }
+    }
+
+    // Determines the application for one MIME type directory, like the launch tool does
+    static QString resolve(const QString &mimeDir)
+    {
         // If there is a default application for the MIME type, then return it
         QString defaultApplication = mimeDir + "/Default";
         if (QFile(defaultApplication).exists()) {
@@ -87,8 +119,152 @@ QString LaunchDB::applicationForFile(const QFileInfo &fileInfo) const {
                 return application;
             }
         }
+        return QString();
+    }
+
+    void reload()
+    {
+        QHash<QString, QString> applications;
+        QSet<QString> names;
+        const QStringList mimeDirNames = QDir(m_root).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+        for (const QString &mimeDirName : mimeDirNames) {
+            names.insert(mimeDirName);
+            QString application = resolve(m_root + "/" + mimeDirName);
+            if (!application.isEmpty()) {
+                applications.insert(mimeDirName, application);
+            }
+        }
+
+        QWriteLocker locker(&m_lock);
+        m_applications = applications;
+        m_mimeDirNames = names;
+    }
+
+    QString refreshDirectory(const QString &mimeDirName)
+    {
+        QString application = resolve(m_root + "/" + mimeDirName);
+        QWriteLocker locker(&m_lock);
+        if (application.isEmpty()) {
+            m_applications.remove(mimeDirName);
+        } else {
+            m_applications.insert(mimeDirName, application);
+        }
+        return application;
+    }
+
+    // Called on the main thread
+    void startWatching()
+    {
+        if (!m_watcher) {
+            m_watcher = new QFileSystemWatcher(QCoreApplication::instance());
+            QObject::connect(m_watcher, &QFileSystemWatcher::directoryChanged, m_watcher,
+                             [this](const QString &path) { handleDirectoryChanged(path); });
+        }
+        if (!m_watcher->directories().isEmpty()) {
+            m_watcher->removePaths(m_watcher->directories());
+        }
+
+        if (!QDir(m_root).exists()) {
+            // Wait for the launch database to be created
+            QString launchDir = QFileInfo(m_root).path();
+            m_watcher->addPath(QDir(launchDir).exists() ? launchDir : QDir::homePath());
+            return;
+        }
+
+        // Changes that happened before we were watching are picked up by reading everything again
+        reload();
+        m_watcher->addPath(m_root);
+        QStringList mimeDirs;
+        {
+            QReadLocker locker(&m_lock);
+            for (const QString &mimeDirName : m_mimeDirNames) {
+                mimeDirs.append(m_root + "/" + mimeDirName);
+            }
+        }
+        if (!mimeDirs.isEmpty()) {
+            m_watcher->addPaths(mimeDirs);
+        }
+    }
+
+    // Called on the main thread
+    void handleDirectoryChanged(const QString &path)
+    {
+        if (path != m_root && !path.startsWith(m_root + "/")) {
+            // A parent of the launch database changed; see whether it exists now
+            if (QDir(m_root).exists()) {
+                startWatching();
+            }
+            return;
+        }
+
+        if (path != m_root) {
+            refreshDirectory(QFileInfo(path).fileName());
+            return;
+        }
+
+        if (!QDir(m_root).exists()) {
+            // The launch database was removed
+            {
+                QWriteLocker locker(&m_lock);
+                m_applications.clear();
+                m_mimeDirNames.clear();
+            }
+            startWatching();
+            return;
+        }
+
+        // MIME type directories were added or removed; only read those
+        const QStringList mimeDirNames = QDir(m_root).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+        QSet<QString> currentNames;
+        for (const QString &mimeDirName : mimeDirNames) {
+            currentNames.insert(mimeDirName);
+        }
+        QSet<QString> previousNames;
+        {
+            QReadLocker locker(&m_lock);
+            previousNames = m_mimeDirNames;
+        }
+        for (const QString &mimeDirName : previousNames - currentNames) {
+            m_watcher->removePath(m_root + "/" + mimeDirName);
+            QWriteLocker locker(&m_lock);
+            m_applications.remove(mimeDirName);
+        }
+        for (const QString &mimeDirName : currentNames - previousNames) {
+            m_watcher->addPath(m_root + "/" + mimeDirName);
+            refreshDirectory(mimeDirName);
+        }
+        QWriteLocker locker(&m_lock);
+        m_mimeDirNames = currentNames;
     }
 
-    // Return the default application for the file
-    return QString(); // Return an empty QString if we don't know the default application
+    QString m_root; ///< ~/.local/share/launch/MIME
+    QReadWriteLock m_lock; ///< Guards m_applications and m_mimeDirNames.
+    QHash<QString, QString> m_applications; ///< Applications by MIME type directory name, e.g., "text_x-pdf".
+    QSet<QString> m_mimeDirNames; ///< The MIME type directories that exist.
+    QFileSystemWatcher *m_watcher = nullptr; ///< Lives on the main thread.
+};
+
+}
+
+QString LaunchDB::applicationForFile(const QFileInfo &fileInfo) const {
+    // Check if the file exists
+    if (!fileInfo.exists()) {
+        return QString(); // Return an empty QString if the file doesn't exist
+    }
+
+    // Resolve symlinks and get absolute path
+    QString absoluteFilePath = fileInfo.absoluteFilePath();
+    // If it is a symlink, then resolve it
+    if (fileInfo.isSymLink()) {
+        absoluteFilePath = fileInfo.symLinkTarget();
+    }
+
+    // Get the MIME type of the file; FileClassifier shares it with the other questions asked about the file
+    QString mimeType = FileClassifier::classify(absoluteFilePath).mimeType;
+    // qDebug("");
+    // qDebug("'%s' has MIME type '%s'", qPrintable(absoluteFilePath), qPrintable(mimeType));
+
+    // If we have "text/x-pdf, look up ~/.local/share/launch/MIME/text_x-pdf/ (just as an example);
+    // the launch database is indexed once and kept up to date by LaunchDBIndex
+    return LaunchDBIndex::instance()->application(mimeType);
 }
@@ -28,8 +28,6 @@
 
 #include <QString>
 #include <QFileInfo>
-#include <QMimeDatabase>
-#include <QMimeType>
 
 /**
  * @brief The LaunchDB class provides functionality to retrieve the default application associated with a file.
@@ -42,19 +40,12 @@
  */
 class LaunchDB {
 public:
-    LaunchDB();
-
-    ~LaunchDB();
-
     /**
      * @brief Retrieves the default application associated with the specified file.
      * @param fileInfo The QFileInfo object representing the file.
      * @return The path to the default application for the file, or an empty QString if not found.
      */
     QString applicationForFile(const QFileInfo &fileInfo) const;
-
-private:
-    QMimeDatabase *db; // Member variable to store the QMimeDatabase object
 };
 
 #endif // FILER_LAUNCHDB_H
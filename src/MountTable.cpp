@@ -0,0 +1,283 @@
+/*-
+ * Copyright (c) 2022-23 Simon Peter <probono@puredarwin.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "MountTable.h"
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSocketNotifier>
+#include <QDebug>
+#include <fcntl.h>
+#include <unistd.h>
+
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(__linux__)
+#include <sys/param.h>
+#include <sys/ucred.h>
+#include <sys/mount.h>
+#include <sys/event.h>
+#include <QVector>
+#endif
+
+namespace {
+
+// Kernel interfaces rather than volumes; like QStorageInfo::mountedVolumes(), the table leaves them out
+// so that, e.g., /proc does not count as a mount point
+bool isPseudoFileSystem(const QString &mountPoint, const QString &fsType)
+{
+    static const QStringList pseudoDirectories = {
+        "/dev", "/proc", "/sys", "/var/run", "/var/lock"
+    };
+    for (const QString &directory : pseudoDirectories) {
+        if (mountPoint == directory || mountPoint.startsWith(directory + "/")) {
+            return true;
+        }
+    }
+    static const QStringList pseudoTypes = {
+        // Linux
+        "rootfs", "proc", "sysfs", "devtmpfs", "devpts", "cgroup", "cgroup2", "securityfs", "pstore",
+        "debugfs", "tracefs", "configfs", "fusectl", "mqueue", "hugetlbfs", "binfmt_misc", "autofs",
+        "bpf", "efivarfs", "nsfs", "rpc_pipefs", "selinuxfs",
+        // FreeBSD
+        "devfs", "fdescfs", "procfs", "linprocfs", "linsysfs"
+    };
+    return pseudoTypes.contains(fsType);
+}
+
+#if defined(__linux__)
+// Spaces, tabs, newlines and backslashes in mountinfo are written as octal escapes like \040
+QByteArray unescape(const QByteArray &field)
+{
+    if (!field.contains('\\')) {
+        return field;
+    }
+    QByteArray result;
+    result.reserve(field.size());
+    for (int i = 0; i < field.size(); i++) {
+        if (field.at(i) == '\\' && i + 3 < field.size()
+            && field.at(i + 1) >= '0' && field.at(i + 1) <= '7'
+            && field.at(i + 2) >= '0' && field.at(i + 2) <= '7'
+            && field.at(i + 3) >= '0' && field.at(i + 3) <= '7') {
+            result.append(static_cast<char>(((field.at(i + 1) - '0') << 6) | ((field.at(i + 2) - '0') << 3)
+                                            | (field.at(i + 3) - '0')));
+            i += 3;
+        } else {
+            result.append(field.at(i));
+        }
+    }
+    return result;
+}
+#endif
+
+}
+
+MountTable *MountTable::instance()
+{
+    // Never deleted; may be created on any thread, e.g., by an icon job
+    static MountTable *table = new MountTable();
+    return table;
+}
+
+MountTable::MountTable() : QObject(nullptr), m_fd(-1), m_notifier(nullptr)
+{
+#if defined(__linux__)
+    m_fd = ::open("/proc/self/mountinfo", O_RDONLY | O_CLOEXEC);
+#elif (defined(__unix__) || defined(__APPLE__)) && !defined(__linux__)
+    m_fd = kqueue();
+    if (m_fd >= 0) {
+        struct kevent change;
+        EV_SET(&change, 0, EVFILT_FS, EV_ADD | EV_CLEAR, 0, 0, nullptr);
+        if (kevent(m_fd, &change, 1, nullptr, 0, nullptr) != 0) {
+            ::close(m_fd);
+            m_fd = -1;
+        }
+    }
+#endif
+    if (m_fd < 0) {
+        qWarning() << "Cannot watch the mount table; mounts and unmounts will not be noticed";
+    }
+
+    reload();
+
+    // The notifier needs the event loop of the main thread
+    if (QCoreApplication::instance()) {
+        moveToThread(QCoreApplication::instance()->thread());
+        QMetaObject::invokeMethod(this, [this]() { startWatching(); }, Qt::QueuedConnection);
+    }
+}
+
+void MountTable::startWatching()
+{
+    if (m_fd < 0) {
+        return;
+    }
+#if defined(__linux__)
+    // The kernel reports changes as POLLPRI, which QSocketNotifier calls an exception
+    m_notifier = new QSocketNotifier(m_fd, QSocketNotifier::Exception, this);
+#else
+    m_notifier = new QSocketNotifier(m_fd, QSocketNotifier::Read, this);
+#endif
+    connect(m_notifier, &QSocketNotifier::activated, this, [this]() {
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(__linux__)
+        // The table is read completely anyway, so all pending events can be dropped
+        struct kevent event;
+        struct timespec timeout = { 0, 0 };
+        while (kevent(m_fd, nullptr, 0, &event, 1, &timeout) > 0) {
+        }
+#endif
+        reload();
+        emit changed();
+    });
+}
+
+void MountTable::reload()
+{
+    QHash<QString, Mount> mounts = readMounts(m_fd);
+    QWriteLocker locker(&m_lock);
+    m_mounts = mounts;
+}
+
+QHash<QString, MountTable::Mount> MountTable::readMounts(int fd)
+{
+    QHash<QString, Mount> mounts;
+
+#if defined(__linux__)
+    QByteArray data;
+    if (fd >= 0 && lseek(fd, 0, SEEK_SET) == 0) {
+        char buffer[16384];
+        ssize_t n;
+        while ((n = ::read(fd, buffer, sizeof(buffer))) > 0) {
+            data.append(buffer, static_cast<int>(n));
+        }
+    }
+
+    // ID parentID major:minor root mountPoint options [optional fields...] - fsType source superOptions
+    for (const QByteArray &line : data.split('\n')) {
+        const QList<QByteArray> fields = line.split(' ');
+        const int separator = fields.indexOf("-");
+        if (separator < 5 || separator + 2 >= fields.size()) {
+            continue;
+        }
+        Mount mount;
+        mount.fsType = QString::fromUtf8(unescape(fields.at(separator + 1)));
+        mount.device = QFile::decodeName(unescape(fields.at(separator + 2)));
+        const QString mountPoint = QFile::decodeName(unescape(fields.at(4)));
+        if (isPseudoFileSystem(mountPoint, mount.fsType)) {
+            continue;
+        }
+        // Later lines are mounted on top of earlier ones at the same mount point
+        mounts.insert(mountPoint, mount);
+    }
+#elif (defined(__unix__) || defined(__APPLE__)) && !defined(__linux__)
+    Q_UNUSED(fd)
+    // getfsstat() rather than getmntinfo(), whose buffer would be shared between threads
+    int count = getfsstat(nullptr, 0, MNT_NOWAIT);
+    if (count > 0) {
+        // Leave room for file systems mounted in the meantime
+        QVector<struct statfs> stats(count + 8);
+        count = getfsstat(stats.data(), static_cast<long>(stats.size() * sizeof(struct statfs)), MNT_NOWAIT);
+        for (int i = 0; i < count; i++) {
+            Mount mount;
+            mount.fsType = QString::fromUtf8(stats.at(i).f_fstypename);
+            mount.device = QFile::decodeName(stats.at(i).f_mntfromname);
+            const QString mountPoint = QFile::decodeName(stats.at(i).f_mntonname);
+            if (isPseudoFileSystem(mountPoint, mount.fsType)) {
+                continue;
+            }
+            mounts.insert(mountPoint, mount);
+        }
+    }
+#else
+    Q_UNUSED(fd)
+#endif
+
+    return mounts;
+}
+
+bool MountTable::isMountpoint(const QString &path) const
+{
+    QFileInfo fileInfo(path);
+    {
+        QReadLocker locker(&m_lock);
+        if (m_mounts.contains(fileInfo.absoluteFilePath())) {
+            return true;
+        }
+    }
+    // A symlink to a mount point counts as well, e.g., the ones to /media on the desktop
+    if (!fileInfo.isSymLink()) {
+        return false;
+    }
+    QReadLocker locker(&m_lock);
+    return m_mounts.contains(fileInfo.symLinkTarget());
+}
+
+QString MountTable::mountPointFor(const QString &path) const
+{
+    QFileInfo fileInfo(path);
+    QString resolvedPath = fileInfo.canonicalFilePath();
+    if (resolvedPath.isEmpty()) {
+        resolvedPath = QDir::cleanPath(fileInfo.absoluteFilePath());
+    }
+    QReadLocker locker(&m_lock);
+    return findMountPoint(resolvedPath);
+}
+
+QString MountTable::deviceFor(const QString &path) const
+{
+    const QString mountPoint = mountPointFor(path);
+    QReadLocker locker(&m_lock);
+    return m_mounts.value(mountPoint).device;
+}
+
+QString MountTable::fsTypeFor(const QString &path) const
+{
+    const QString mountPoint = mountPointFor(path);
+    QReadLocker locker(&m_lock);
+    return m_mounts.value(mountPoint).fsType;
+}
+
+QStringList MountTable::mountPoints() const
+{
+    QReadLocker locker(&m_lock);
+    return m_mounts.keys();
+}
+
+// Walks up from an absolute path without symlinks to the nearest mount point; m_lock must be held
+QString MountTable::findMountPoint(const QString &path) const
+{
+    QString candidate = path;
+    while (!candidate.isEmpty()) {
+        if (m_mounts.contains(candidate)) {
+            return candidate;
+        }
+        if (candidate == "/") {
+            break;
+        }
+        const int slash = candidate.lastIndexOf('/');
+        candidate = slash <= 0 ? QStringLiteral("/") : candidate.left(slash);
+    }
+    return QString();
+}
@@ -0,0 +1,110 @@
+/*-
+ * Copyright (c) 2022-23 Simon Peter <probono@puredarwin.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef MOUNTTABLE_H
+#define MOUNTTABLE_H
+
+#include <QObject>
+#include <QHash>
+#include <QReadWriteLock>
+#include <QString>
+#include <QStringList>
+
+class QSocketNotifier;
+
+/**
+ * @file MountTable.h
+ * @class MountTable
+ * @brief The mounted file systems, read once and kept up to date by the kernel's change notifications.
+ *
+ * On Linux, the table is parsed from /proc/self/mountinfo, and parsed again only when poll()
+ * reports POLLPRI on it, which the kernel does whenever something is mounted or unmounted.
+ * On FreeBSD, it is read with getmntinfo(), and read again when kqueue reports an EVFILT_FS event.
+ * Pseudo file systems such as proc, sysfs or devfs are left out, as QStorageInfo::mountedVolumes() does.
+ * Queries only look up hashes, so they are cheap enough to be made for every item while sorting.
+ * All queries are thread-safe.
+ */
+class MountTable : public QObject
+{
+Q_OBJECT
+
+public:
+    /**
+     * @brief Returns the mount table of the application.
+     */
+    static MountTable *instance();
+
+    /**
+     * @brief Returns true if path (symlinks resolved) is a mount point, false otherwise.
+     */
+    bool isMountpoint(const QString &path) const;
+
+    /**
+     * @brief Returns the mount point of the file system that path is on.
+     */
+    QString mountPointFor(const QString &path) const;
+
+    /**
+     * @brief Returns the device (or other source, e.g., a server share) mounted at the file system that path is on.
+     */
+    QString deviceFor(const QString &path) const;
+
+    /**
+     * @brief Returns the type of the file system that path is on, e.g., "ext4" or "zfs".
+     */
+    QString fsTypeFor(const QString &path) const;
+
+    /**
+     * @brief Returns all mount points.
+     */
+    QStringList mountPoints() const;
+
+signals:
+    /**
+     * @brief Emitted on the main thread after something was mounted or unmounted.
+     */
+    void changed();
+
+private:
+    struct Mount {
+        QString device;
+        QString fsType;
+    };
+
+    MountTable();
+
+    void startWatching();
+    void reload();
+    static QHash<QString, Mount> readMounts(int fd);
+    QString findMountPoint(const QString &path) const;
+
+    mutable QReadWriteLock m_lock;
+    QHash<QString, Mount> m_mounts; ///< By mount point; guarded by m_lock.
+    int m_fd; ///< /proc/self/mountinfo on Linux, a kqueue on FreeBSD.
+    QSocketNotifier *m_notifier;
+};
+
+#endif // MOUNTTABLE_H
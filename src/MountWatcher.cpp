@@ -0,0 +1,115 @@
+/*-
+ * Copyright (c) 2022-23 Simon Peter <probono@puredarwin.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "MountWatcher.h"
+#include "MountTable.h"
+
+#include <QDir>
+#include <QFile>
+#include <QDebug>
+
+namespace {
+
+// Give up on a directory that has not been mounted on after this many milliseconds
+const qint64 mountTimeout = 60 * 1000;
+
+}
+
+MountWatcher *MountWatcher::instance()
+{
+    static MountWatcher *watcher = new MountWatcher();
+    return watcher;
+}
+
+MountWatcher::MountWatcher(QObject *parent) : QObject(parent)
+{
+    m_clock.start();
+    m_timeoutTimer.setSingleShot(true);
+    connect(&m_timeoutTimer, &QTimer::timeout, this, &MountWatcher::resolvePending);
+    connect(MountTable::instance(), &MountTable::changed, this, &MountWatcher::resolvePending);
+}
+
+void MountWatcher::watch(const QString &fullPath, const QString &symlinkPath)
+{
+    if (!QFile::exists(fullPath)) {
+        return;
+    }
+    if (QFile::exists(symlinkPath)) {
+        qDebug() << "Symlink already exists for" << fullPath;
+        return;
+    }
+    if (!m_pending.contains(fullPath)) {
+        qDebug() << "Waiting for mount point to appear at" << fullPath;
+        m_pending.insert(fullPath, { symlinkPath, m_clock.elapsed() + mountTimeout });
+    }
+    // It may have been mounted before we were told about the directory
+    resolvePending();
+}
+
+// Creates the symlinks for all pending directories that have been mounted on, and gives up on those that timed out
+void MountWatcher::resolvePending()
+{
+    const qint64 now = m_clock.elapsed();
+    MountTable *mountTable = MountTable::instance();
+    for (auto it = m_pending.begin(); it != m_pending.end();) {
+        const QString &fullPath = it.key();
+        const QString &symlinkPath = it.value().symlinkPath;
+        if (!QFile::exists(fullPath)) {
+            // Removed again, e.g., by the automounter
+            it = m_pending.erase(it);
+        } else if (mountTable->isMountpoint(fullPath)) {
+            QFile::link(fullPath, symlinkPath);
+            qDebug() << "Symlink created for" << fullPath;
+            it = m_pending.erase(it);
+        } else if (now >= it.value().deadline) {
+            qDebug() << "Giving up on" << fullPath;
+            // Delete the symlink if it exists
+            if (QFile::exists(symlinkPath)) {
+                QFile::remove(symlinkPath);
+            }
+            // The directory must be empty for rmdir() to succeed.
+            QDir::root().rmdir(fullPath);
+            it = m_pending.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    scheduleTimeout();
+}
+
+// Wakes us up when the first of the pending directories times out
+void MountWatcher::scheduleTimeout()
+{
+    if (m_pending.isEmpty()) {
+        m_timeoutTimer.stop();
+        return;
+    }
+    qint64 deadline = m_pending.begin().value().deadline;
+    for (const Pending &pending : m_pending) {
+        deadline = qMin(deadline, pending.deadline);
+    }
+    m_timeoutTimer.start(static_cast<int>(qMax<qint64>(deadline - m_clock.elapsed(), 0)));
+}
@@ -0,0 +1,81 @@
+/*-
+ * Copyright (c) 2022-23 Simon Peter <probono@puredarwin.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef MOUNTWATCHER_H
+#define MOUNTWATCHER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QString>
+#include <QTimer>
+
+/**
+ * @file MountWatcher.h
+ * @class MountWatcher
+ * @brief Creates the symlinks for volumes as soon as they are mounted.
+ *
+ * When a directory appears in /media, the volume is usually not mounted on it yet. The directory
+ * is registered with watch(), and all registered directories are checked together whenever
+ * MountTable reports that something was mounted, so nothing runs while we wait. Directories that
+ * are not mounted on within a minute are given up on and removed.
+ */
+class MountWatcher : public QObject
+{
+Q_OBJECT
+
+public:
+    /**
+     * @brief Returns the watcher of the application.
+     */
+    static MountWatcher *instance();
+
+    /**
+     * @brief Creates a symlink to fullPath at symlinkPath once a volume is mounted on fullPath.
+     *
+     * Does nothing if the symlink exists already. Watching the same path again does not extend the time it is watched.
+     * @param fullPath The full path of the mount point.
+     * @param symlinkPath The path where the symlink should be created.
+     */
+    void watch(const QString &fullPath, const QString &symlinkPath);
+
+private:
+    explicit MountWatcher(QObject *parent = nullptr);
+
+    void resolvePending();
+    void scheduleTimeout();
+
+    struct Pending {
+        QString symlinkPath;
+        qint64 deadline;    ///< When to give up, on m_clock.
+    };
+
+    QHash<QString, Pending> m_pending; ///< By mount point.
+    QElapsedTimer m_clock;
+    QTimer m_timeoutTimer;
+};
+
+#endif // MOUNTWATCHER_H
@@ -25,26 +25,10 @@
  */
 
 #include "Mountpoints.h"
+#include "MountTable.h"
 
 bool Mountpoints::isMountpoint(const QString &path)
 {
-    bool isMountpoint = true;
-
-    QFileInfo fileInfo(path);
-
-    QStringList mountpoints;
-    for (const QStorageInfo &storage : QStorageInfo::mountedVolumes()) {
-        mountpoints << storage.rootPath();
-    }
-
-    QString absoluteFilePathWithSymlinksResolved = fileInfo.absoluteFilePath();
-    if (fileInfo.isSymLink()) {
-        absoluteFilePathWithSymlinksResolved = fileInfo.symLinkTarget();
-    }
-
-    if (!mountpoints.contains(absoluteFilePathWithSymlinksResolved)) {
-        isMountpoint = false;
-    }
-
-    return isMountpoint;
+    // The mount table is kept in memory rather than read for every call
+    return MountTable::instance()->isMountpoint(path);
 }
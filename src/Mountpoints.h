@@ -35,6 +35,7 @@
  * @file Mountpoints.h
  * @brief The Mountpoints class
  * This class provides a static method to check if a path is a mountpoint.
+ * See MountTable for the mount points themselves.
  */
 class Mountpoints : public QObject
 {
@@ -0,0 +1,339 @@
+/*-
+ * Copyright (c) 2022-23 Simon Peter <probono@puredarwin.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "SqshArchiveModel.h"
+#include "SqshArchivePool.h"
+
+#include <QRunnable>
+#include <QIcon>
+#include <QLocale>
+#include <QFileInfo>
+#include <QDebug>
+
+#include <algorithm>
+#include <sqsh.h>
+
+/**
+ * @brief Reads one directory of a SquashFS archive on a worker thread of a SqshArchiveModel.
+ */
+class ArchiveListingJob : public QRunnable
+{
+public:
+    ArchiveListingJob(SqshArchiveModel *model, const QString &archivePath, qint64 archiveOffset,
+                      const QString &directoryPath)
+        : m_model(model),
+          m_archivePath(archivePath),
+          m_archiveOffset(archiveOffset),
+          m_directoryPath(directoryPath)
+    {
+    }
+
+    void run() override
+    {
+        QVector<SqshArchiveModel::Entry> entries;
+        QString error = list(entries);
+
+        // Hand the result over to the thread the model lives in
+        SqshArchiveModel *model = m_model;
+        QString directoryPath = m_directoryPath;
+        QMetaObject::invokeMethod(
+                model,
+                [model, directoryPath, entries, error]() {
+                    model->handleListed(directoryPath, entries, error);
+                },
+                Qt::QueuedConnection);
+    }
+
+private:
+    // Returns an error message, or an empty string on success
+    QString list(QVector<SqshArchiveModel::Entry> &entries)
+    {
+        qint64 offset = m_archiveOffset;
+        if (offset < 0) {
+            offset = SqshArchivePool::instance()->appImageOffset(m_archivePath);
+        }
+        SqshArchivePool::Lease lease = SqshArchivePool::instance()->acquire(m_archivePath, offset);
+        if (!lease.isValid()) {
+            return QObject::tr("Cannot open %1").arg(m_archivePath);
+        }
+
+        int error_code = 0;
+        QByteArray directoryPath = m_directoryPath.toUtf8();
+        struct SqshFile *directory = sqsh_open(lease.archive(), directoryPath.constData(), &error_code);
+        if (error_code != 0) {
+            sqsh_perror(error_code, "sqsh_open");
+            return QObject::tr("Cannot read %1").arg(m_directoryPath);
+        }
+        struct SqshDirectoryIterator *iterator = sqsh_directory_iterator_new(directory, &error_code);
+        if (error_code != 0) {
+            sqsh_perror(error_code, "sqsh_directory_iterator_new");
+            sqsh_close(directory);
+            return QObject::tr("Cannot read %1").arg(m_directoryPath);
+        }
+
+        while (sqsh_directory_iterator_next(iterator, &error_code)) {
+            SqshArchiveModel::Entry entry;
+            entry.name = QString::fromUtf8(sqsh_directory_iterator_name(iterator),
+                                           sqsh_directory_iterator_name_size(iterator));
+            entry.isDirectory = sqsh_directory_iterator_file_type(iterator) == SQSH_FILE_TYPE_DIRECTORY;
+            entry.size = 0;
+            if (!entry.isDirectory) {
+                // The size is in the inode, which the directory entry only points to
+                int inode_error = 0;
+                struct SqshFile *file = sqsh_directory_iterator_open_file(iterator, &inode_error);
+                if (inode_error == 0) {
+                    entry.size = static_cast<qint64>(sqsh_file_size(file));
+                    sqsh_close(file);
+                }
+            }
+            entries.append(entry);
+        }
+
+        sqsh_directory_iterator_free(iterator);
+        sqsh_close(directory);
+
+        if (error_code < 0) {
+            sqsh_perror(error_code, "sqsh_directory_iterator_next");
+            return QObject::tr("Cannot read %1").arg(m_directoryPath);
+        }
+        return QString();
+    }
+
+    SqshArchiveModel *m_model;
+    QString m_archivePath;
+    qint64 m_archiveOffset;
+    QString m_directoryPath;
+};
+
+SqshArchiveModel::SqshArchiveModel(const QString &archivePath, qint64 archiveOffset, QObject *parent)
+    : QAbstractItemModel(parent),
+      m_archivePath(archivePath),
+      m_archiveOffset(archiveOffset),
+      m_root(new Node)
+{
+    // Directories are read one at a time, in the order they were expanded
+    m_threadPool.setMaxThreadCount(1);
+
+    m_directories.insert("/", m_root);
+    fetchMore(QModelIndex());
+}
+
+SqshArchiveModel::~SqshArchiveModel()
+{
+    // Jobs post their results to this object, so none of them may outlive it
+    m_threadPool.clear();
+    m_threadPool.waitForDone();
+
+    QVector<Node *> nodes = { m_root };
+    while (!nodes.isEmpty()) {
+        Node *node = nodes.takeLast();
+        nodes += node->children;
+        delete node;
+    }
+}
+
+SqshArchiveModel::Node *SqshArchiveModel::nodeForIndex(const QModelIndex &index) const
+{
+    if (!index.isValid()) {
+        return m_root;
+    }
+    return static_cast<Node *>(index.internalPointer());
+}
+
+QModelIndex SqshArchiveModel::indexForNode(Node *node, int column) const
+{
+    if (node == m_root) {
+        return QModelIndex();
+    }
+    return createIndex(node->row, column, node);
+}
+
+QString SqshArchiveModel::pathForNode(const Node *node) const
+{
+    if (node == m_root) {
+        return "/";
+    }
+    QString parentPath = pathForNode(node->parent);
+    return (parentPath == "/" ? parentPath : parentPath + "/") + node->name;
+}
+
+QString SqshArchiveModel::archiveFilePath(const QModelIndex &index) const
+{
+    return pathForNode(nodeForIndex(index));
+}
+
+bool SqshArchiveModel::isDirectory(const QModelIndex &index) const
+{
+    return nodeForIndex(index)->isDirectory;
+}
+
+QModelIndex SqshArchiveModel::index(int row, int column, const QModelIndex &parent) const
+{
+    Node *parentNode = nodeForIndex(parent);
+    if (row < 0 || row >= parentNode->children.size() || column < 0 || column >= ColumnCount) {
+        return QModelIndex();
+    }
+    return createIndex(row, column, parentNode->children.at(row));
+}
+
+QModelIndex SqshArchiveModel::parent(const QModelIndex &child) const
+{
+    if (!child.isValid()) {
+        return QModelIndex();
+    }
+    return indexForNode(nodeForIndex(child)->parent);
+}
+
+int SqshArchiveModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.column() > 0) {
+        return 0;
+    }
+    return nodeForIndex(parent)->children.size();
+}
+
+int SqshArchiveModel::columnCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent);
+    return ColumnCount;
+}
+
+bool SqshArchiveModel::hasChildren(const QModelIndex &parent) const
+{
+    if (parent.column() > 0) {
+        return false;
+    }
+    // Show directories as expandable before they have been read
+    Node *node = nodeForIndex(parent);
+    return node->isDirectory && (!node->listed || !node->children.isEmpty());
+}
+
+QVariant SqshArchiveModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid()) {
+        return QVariant();
+    }
+    Node *node = nodeForIndex(index);
+
+    if (role == Qt::DisplayRole) {
+        if (index.column() == NameColumn) {
+            return node->name;
+        } else if (index.column() == SizeColumn && !node->isDirectory) {
+            return QLocale().formattedDataSize(node->size);
+        }
+    } else if (role == Qt::DecorationRole && index.column() == NameColumn) {
+        if (node->isDirectory) {
+            return QIcon::fromTheme("folder");
+        }
+        // Only the name is available without reading the file
+        QMimeType mimeType = m_mimeDatabase.mimeTypeForFile(node->name, QMimeDatabase::MatchExtension);
+        return QIcon::fromTheme(mimeType.iconName(), QIcon::fromTheme(mimeType.genericIconName()));
+    } else if (role == Qt::TextAlignmentRole && index.column() == SizeColumn) {
+        return QVariant(Qt::AlignRight | Qt::AlignVCenter);
+    }
+    return QVariant();
+}
+
+QVariant SqshArchiveModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QVariant();
+    }
+    switch (section) {
+    case NameColumn:
+        return tr("Name");
+    case SizeColumn:
+        return tr("Size");
+    default:
+        return QVariant();
+    }
+}
+
+bool SqshArchiveModel::canFetchMore(const QModelIndex &parent) const
+{
+    Node *node = nodeForIndex(parent);
+    return node->isDirectory && !node->listed && !node->listing;
+}
+
+void SqshArchiveModel::fetchMore(const QModelIndex &parent)
+{
+    Node *node = nodeForIndex(parent);
+    if (!node->isDirectory || node->listed || node->listing) {
+        return;
+    }
+    node->listing = true;
+    m_threadPool.start(new ArchiveListingJob(this, m_archivePath, m_archiveOffset, pathForNode(node)));
+}
+
+void SqshArchiveModel::handleListed(const QString &directoryPath, const QVector<Entry> &entries,
+                                    const QString &error)
+{
+    Node *node = m_directories.value(directoryPath);
+    if (!node) {
+        return;
+    }
+    node->listing = false;
+    node->listed = true;
+
+    if (!error.isEmpty()) {
+        qWarning() << "SqshArchiveModel:" << error;
+        emit errorOccurred(error);
+    }
+
+    if (entries.isEmpty()) {
+        // The directory can no longer be expanded
+        QModelIndex index = indexForNode(node);
+        if (index.isValid()) {
+            emit dataChanged(index, index);
+        }
+        return;
+    }
+
+    // Directories first, then by name, like in the file system windows
+    QVector<Entry> sortedEntries = entries;
+    std::sort(sortedEntries.begin(), sortedEntries.end(), [](const Entry &a, const Entry &b) {
+        if (a.isDirectory != b.isDirectory) {
+            return a.isDirectory;
+        }
+        return a.name.compare(b.name, Qt::CaseInsensitive) < 0;
+    });
+
+    QString prefix = directoryPath == "/" ? directoryPath : directoryPath + "/";
+    beginInsertRows(indexForNode(node), 0, sortedEntries.size() - 1);
+    for (const Entry &entry : sortedEntries) {
+        Node *child = new Node;
+        child->name = entry.name;
+        child->isDirectory = entry.isDirectory;
+        child->size = entry.size;
+        child->parent = node;
+        child->row = node->children.size();
+        node->children.append(child);
+        if (entry.isDirectory) {
+            m_directories.insert(prefix + entry.name, child);
+        }
+    }
+    endInsertRows();
+}
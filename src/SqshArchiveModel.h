@@ -0,0 +1,142 @@
+/*-
+ * Copyright (c) 2022-23 Simon Peter <probono@puredarwin.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef SQSHARCHIVEMODEL_H
+#define SQSHARCHIVEMODEL_H
+
+#include <QAbstractItemModel>
+#include <QHash>
+#include <QVector>
+#include <QThreadPool>
+#include <QMimeDatabase>
+
+/**
+ * @file SqshArchiveModel.h
+ * @class SqshArchiveModel
+ * @brief A read-only model of the files inside a SquashFS archive, e.g., inside an AppImage.
+ *
+ * Directories are listed lazily: a directory is only read when a view calls fetchMore()
+ * for it, i.e., when it is expanded. Reading happens on a worker thread, using an archive
+ * leased from SqshArchivePool, so even a large AppImage never blocks the GUI.
+ */
+class SqshArchiveModel : public QAbstractItemModel
+{
+Q_OBJECT
+
+public:
+    /**
+     * @brief The columns of the model.
+     */
+    enum Column {
+        NameColumn,
+        SizeColumn,
+        ColumnCount
+    };
+
+    /**
+     * @brief Constructs a model for an archive and starts listing its root directory.
+     * @param archivePath The path of the file that contains the archive.
+     * @param archiveOffset The offset of the archive in the file, or -1 for the squashfs of an AppImage.
+     * @param parent The parent QObject.
+     */
+    explicit SqshArchiveModel(const QString &archivePath, qint64 archiveOffset = -1, QObject *parent = nullptr);
+
+    /**
+     * @brief Waits for the running listing, if any, and discards queued ones.
+     */
+    ~SqshArchiveModel() override;
+
+    /**
+     * @brief Returns the path of an item inside the archive, e.g., "/usr/bin/foo".
+     */
+    QString archiveFilePath(const QModelIndex &index) const;
+
+    /**
+     * @brief Returns whether an item is a directory.
+     */
+    bool isDirectory(const QModelIndex &index) const;
+
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex &child) const override;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    bool hasChildren(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+
+signals:
+    /**
+     * @brief Emitted when a directory of the archive cannot be read.
+     * @param message A description of the error.
+     */
+    void errorOccurred(const QString &message);
+
+private:
+    /**
+     * @brief An entry of a directory as read by a listing job.
+     */
+    struct Entry {
+        QString name;
+        bool isDirectory;
+        qint64 size;
+    };
+
+    /**
+     * @brief An item of the model.
+     */
+    struct Node {
+        QString name;
+        bool isDirectory = true;
+        qint64 size = 0;
+        Node *parent = nullptr;
+        int row = 0;          ///< The index of the node in the children of its parent.
+        QVector<Node *> children;
+        bool listed = false;  ///< Whether the children have been read.
+        bool listing = false; ///< Whether a listing job is queued or running.
+    };
+
+    Node *nodeForIndex(const QModelIndex &index) const;
+    QModelIndex indexForNode(Node *node, int column = 0) const;
+    QString pathForNode(const Node *node) const;
+
+    /**
+     * @brief Called on the GUI thread with the result of a listing job.
+     */
+    void handleListed(const QString &directoryPath, const QVector<Entry> &entries, const QString &error);
+
+    friend class ArchiveListingJob;
+
+    QString m_archivePath;
+    qint64 m_archiveOffset;
+    Node *m_root;
+    QHash<QString, Node *> m_directories; ///< Directory nodes by path inside the archive.
+    QThreadPool m_threadPool; ///< Runs the listing jobs.
+    QMimeDatabase m_mimeDatabase; ///< Used for the icons of the files.
+};
+
+#endif // SQSHARCHIVEMODEL_H
@@ -0,0 +1,260 @@
+/*-
+ * Copyright (c) 2022-23 Simon Peter <probono@puredarwin.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "SqshArchivePool.h"
+#include "ElfSizeCalculator.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QDebug>
+
+#include <sqsh.h>
+
+namespace {
+
+// Archives that have not been used for this long are closed
+const int idleTimeout = 30000;
+
+// Each open archive holds a file descriptor and its caches
+const int maximumOpenArchives = 16;
+
+// How long to wait for a leased archive to be returned before opening one beyond the maximum
+const unsigned long acquireTimeout = 2000;
+
+}
+
+SqshArchivePool::Lease::Lease(Lease &&other) noexcept : m_handle(other.m_handle)
+{
+    other.m_handle = nullptr;
+}
+
+SqshArchivePool::Lease &SqshArchivePool::Lease::operator=(Lease &&other) noexcept
+{
+    if (this != &other) {
+        if (m_handle) {
+            SqshArchivePool::instance()->release(m_handle);
+        }
+        m_handle = other.m_handle;
+        other.m_handle = nullptr;
+    }
+    return *this;
+}
+
+SqshArchivePool::Lease::~Lease()
+{
+    if (m_handle) {
+        SqshArchivePool::instance()->release(m_handle);
+    }
+}
+
+SqshArchive *SqshArchivePool::Lease::archive() const
+{
+    return m_handle ? m_handle->archive : nullptr;
+}
+
+SqshArchivePool *SqshArchivePool::instance()
+{
+    // Thread-safe since C++11; the pool lives for as long as the application
+    static SqshArchivePool *pool = new SqshArchivePool();
+    return pool;
+}
+
+SqshArchivePool::SqshArchivePool(QObject *parent) : QObject(parent), m_idleTimer(this)
+{
+    m_clock.start();
+
+    // The pool may be created on a worker thread, but the idle timer needs an event loop
+    if (QCoreApplication::instance()) {
+        moveToThread(QCoreApplication::instance()->thread());
+    }
+    m_idleTimer.setInterval(idleTimeout / 2);
+    connect(&m_idleTimer, &QTimer::timeout, this, &SqshArchivePool::closeIdleArchives);
+}
+
+SqshArchivePool::~SqshArchivePool()
+{
+    for (Handle *handle : m_handles) {
+        sqsh_archive_close(handle->archive);
+        delete handle;
+    }
+}
+
+SqshArchivePool::Lease SqshArchivePool::acquire(const QString &path, uint64_t offset)
+{
+    QFileInfo fileInfo(path);
+    if (!fileInfo.exists()) {
+        return Lease();
+    }
+    qint64 lastModified = fileInfo.lastModified().toMSecsSinceEpoch();
+
+    QList<SqshArchive *> archivesToClose;
+    QMutexLocker locker(&m_mutex);
+    while (true) {
+        // Reuse an idle archive for the file; close the ones for older versions of it
+        for (int i = m_handles.size() - 1; i >= 0; --i) {
+            Handle *handle = m_handles.at(i);
+            if (handle->inUse || handle->path != path) {
+                continue;
+            }
+            if (handle->lastModified == lastModified && handle->offset == offset) {
+                handle->inUse = true;
+                locker.unlock();
+                for (SqshArchive *archive : archivesToClose) {
+                    sqsh_archive_close(archive);
+                }
+                return Lease(handle);
+            }
+            if (handle->lastModified != lastModified) {
+                archivesToClose.append(takeIdleArchive(i));
+            }
+        }
+
+        if (m_handles.size() + m_opening < maximumOpenArchives) {
+            break;
+        }
+
+        // Make room by closing the archive that has been idle the longest
+        int oldestIdle = -1;
+        for (int i = 0; i < m_handles.size(); ++i) {
+            if (!m_handles.at(i)->inUse
+                && (oldestIdle < 0 || m_handles.at(i)->lastUsed < m_handles.at(oldestIdle)->lastUsed)) {
+                oldestIdle = i;
+            }
+        }
+        if (oldestIdle >= 0) {
+            archivesToClose.append(takeIdleArchive(oldestIdle));
+            break;
+        }
+
+        // All archives are leased; wait for one to be returned, but do not block the caller
+        // (possibly the GUI thread) indefinitely if the leases are held for long
+        if (!m_archiveReleased.wait(&m_mutex, acquireTimeout)) {
+            qWarning() << "SqshArchivePool: all" << m_handles.size() + m_opening
+                       << "archives are leased, opening" << path << "beyond the maximum";
+            break;
+        }
+    }
+    m_opening++;
+    locker.unlock();
+
+    for (SqshArchive *archive : archivesToClose) {
+        sqsh_archive_close(archive);
+    }
+
+    // Opening reads the superblock, so do it without holding the lock
+    QByteArray source = QFile::encodeName(path);
+    int error_code = 0;
+    struct SqshConfig config = {
+            .archive_offset = offset,
+    };
+    SqshArchive *archive = sqsh_archive_open(source.constData(), &config, &error_code);
+
+    locker.relock();
+    m_opening--;
+    if (error_code != 0) {
+        sqsh_perror(error_code, "sqsh_archive_open");
+        if (archive) {
+            sqsh_archive_close(archive);
+        }
+        m_archiveReleased.wakeOne();
+        return Lease();
+    }
+    Handle *handle = new Handle { path, lastModified, offset, archive, true, 0 };
+    m_handles.append(handle);
+    return Lease(handle);
+}
+
+void SqshArchivePool::release(Handle *handle)
+{
+    QMutexLocker locker(&m_mutex);
+    handle->inUse = false;
+    handle->lastUsed = m_clock.elapsed();
+    m_archiveReleased.wakeOne();
+
+    // Start the timer on the thread the pool lives in
+    QMetaObject::invokeMethod(this, [this]() {
+        if (!m_idleTimer.isActive()) {
+            m_idleTimer.start();
+        }
+    }, Qt::QueuedConnection);
+}
+
+void SqshArchivePool::closeIdleArchives()
+{
+    QList<SqshArchive *> archivesToClose;
+    bool anyOpen;
+    {
+        QMutexLocker locker(&m_mutex);
+        qint64 now = m_clock.elapsed();
+        for (int i = m_handles.size() - 1; i >= 0; --i) {
+            Handle *handle = m_handles.at(i);
+            if (!handle->inUse && now - handle->lastUsed >= idleTimeout) {
+                archivesToClose.append(takeIdleArchive(i));
+            }
+        }
+        anyOpen = !m_handles.isEmpty();
+    }
+
+    for (SqshArchive *archive : archivesToClose) {
+        sqsh_archive_close(archive);
+    }
+
+    // Archives that are still leased restart the timer when they are returned
+    if (!anyOpen) {
+        m_idleTimer.stop();
+    }
+}
+
+SqshArchive *SqshArchivePool::takeIdleArchive(int index)
+{
+    Handle *handle = m_handles.takeAt(index);
+    SqshArchive *archive = handle->archive;
+    delete handle;
+    m_archiveReleased.wakeOne();
+    return archive;
+}
+
+qint64 SqshArchivePool::appImageOffset(const QString &path)
+{
+    QFileInfo fileInfo(path);
+    qint64 lastModified = fileInfo.lastModified().toMSecsSinceEpoch();
+    qint64 size = fileInfo.size();
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = m_offsets.constFind(path);
+        if (it != m_offsets.constEnd() && it->lastModified == lastModified && it->size == size) {
+            return it->offset;
+        }
+    }
+
+    qint64 offset = ElfSizeCalculator::calculateElfSize(path);
+
+    QMutexLocker locker(&m_mutex);
+    m_offsets.insert(path, { lastModified, size, offset });
+    return offset;
+}
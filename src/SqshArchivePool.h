@@ -0,0 +1,166 @@
+/*-
+ * Copyright (c) 2022-23 Simon Peter <probono@puredarwin.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef SQSHARCHIVEPOOL_H
+#define SQSHARCHIVEPOOL_H
+
+#include <QObject>
+#include <QString>
+#include <QList>
+#include <QHash>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QTimer>
+#include <QElapsedTimer>
+
+struct SqshArchive;
+
+/**
+ * @file SqshArchivePool.h
+ * @class SqshArchivePool
+ * @brief A thread-safe pool of open SquashFS archives.
+ *
+ * Opening an archive reads and parses its superblock and tables, and for an AppImage,
+ * finding the archive means reading the ELF headers first. The icon, the listing and
+ * the desktop file of the same AppImage are typically looked up several times in a row
+ * (when painting, for the tooltip, in the Get Info dialog), so SqshArchivePool keeps
+ * archives open and hands them out as leases.
+ *
+ * Archives are keyed by path, modification time and offset, so a changed file gets a
+ * fresh archive. A lease gives exclusive use of an archive; several threads that ask
+ * for the same file get archives of their own. Archives that have not been used for
+ * a while are closed, and at most a fixed number of archives is open at any time.
+ */
+class SqshArchivePool : public QObject
+{
+Q_OBJECT
+
+    struct Handle;
+
+public:
+    /**
+     * @brief Exclusive use of an open archive; the archive returns to the pool when the lease is destroyed.
+     */
+    class Lease
+    {
+    public:
+        Lease() = default;
+        Lease(Lease &&other) noexcept;
+        Lease &operator=(Lease &&other) noexcept;
+        Lease(const Lease &) = delete;
+        Lease &operator=(const Lease &) = delete;
+        ~Lease();
+
+        /**
+         * @brief Returns whether the archive could be opened.
+         */
+        bool isValid() const { return m_handle != nullptr; }
+
+        /**
+         * @brief Returns the archive, or nullptr if the lease is not valid.
+         */
+        SqshArchive *archive() const;
+
+    private:
+        friend class SqshArchivePool;
+        explicit Lease(Handle *handle) : m_handle(handle) { }
+
+        Handle *m_handle = nullptr;
+    };
+
+    /**
+     * @brief Returns the pool shared by all threads.
+     */
+    static SqshArchivePool *instance();
+
+    /**
+     * @brief Leases an open archive, opening one if no idle archive for the file is available.
+     *
+     * Blocks while the maximum number of archives is open and all of them are leased;
+     * if none is returned within a short timeout, an archive is opened beyond the maximum.
+     * @param path The path of the file that contains the archive.
+     * @param offset The offset of the archive in the file.
+     * @return The lease; not valid if the archive cannot be opened.
+     */
+    Lease acquire(const QString &path, uint64_t offset);
+
+    /**
+     * @brief Returns the offset of the squashfs in an AppImage, i.e., the size of its ELF part.
+     *
+     * The result is remembered for as long as the file does not change.
+     * @param path The path of the AppImage.
+     * @return The offset in bytes.
+     */
+    qint64 appImageOffset(const QString &path);
+
+private:
+    /**
+     * @brief An archive together with what it was opened for.
+     */
+    struct Handle {
+        QString path;
+        qint64 lastModified;
+        uint64_t offset;
+        SqshArchive *archive;
+        bool inUse;
+        qint64 lastUsed; ///< When the archive was last returned, as time since m_clock was started.
+    };
+
+    /**
+     * @brief A remembered AppImage offset together with the state of the file it was determined for.
+     */
+    struct Offset {
+        qint64 lastModified;
+        qint64 size;
+        qint64 offset;
+    };
+
+    explicit SqshArchivePool(QObject *parent = nullptr);
+    ~SqshArchivePool() override;
+
+    void release(Handle *handle);
+
+    /**
+     * @brief Closes the archives that have not been used for the idle timeout.
+     */
+    void closeIdleArchives();
+
+    /**
+     * @brief Removes an idle archive from the pool; must be called with m_mutex locked.
+     * @return The archive to be closed by the caller after unlocking m_mutex.
+     */
+    SqshArchive *takeIdleArchive(int index);
+
+    QMutex m_mutex; ///< Guards all of the members below.
+    QWaitCondition m_archiveReleased; ///< Signalled when an archive is returned or closed.
+    QList<Handle *> m_handles; ///< Open archives, in use or idle.
+    int m_opening = 0; ///< Archives that are being opened and count against the maximum.
+    QHash<QString, Offset> m_offsets; ///< Remembered AppImage offsets by path.
+    QElapsedTimer m_clock; ///< Time base for Handle::lastUsed.
+    QTimer m_idleTimer; ///< Periodically calls closeIdleArchives() while archives are open; a child so that it moves along.
+};
+
+#endif // SQSHARCHIVEPOOL_H
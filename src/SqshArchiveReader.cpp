@@ -25,6 +25,8 @@
  */
 
 #include "SqshArchiveReader.h"
+#include "SqshArchivePool.h"
+#include "SqshFileDevice.h"
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -34,73 +36,60 @@ SqshArchiveReader::SqshArchiveReader(uint64_t archive_offset, QObject* parent)
         : QObject(parent), archive_offset_(archive_offset) {}
 
 QStringList SqshArchiveReader::readSqshArchive(const QString& sqsh_file) {
-    QByteArray sqsh_file_bytes = sqsh_file.toUtf8();
-    const void* sqsh_file_source = sqsh_file_bytes.constData();
-
-    char **cnames = NULL;
     QStringList names;
-    int error_code = 0;
-    struct SqshConfig config = {
-            .archive_offset = archive_offset_,
-    };
-    struct SqshArchive* archive = sqsh_archive_open(sqsh_file_source, &config, &error_code);
-    if (error_code != 0) {
-        sqsh_perror(error_code, "sqsh_archive_open");
-        sqsh_archive_close(archive);
-        goto out;
+
+    // The archive stays open in the pool for the next lookup
+    SqshArchivePool::Lease lease = SqshArchivePool::instance()->acquire(sqsh_file, archive_offset_);
+    if (!lease.isValid()) {
+        return names;
     }
 
-    cnames = sqsh_easy_directory_list(archive, "/", &error_code);
+    int error_code = 0;
+    char **cnames = sqsh_easy_directory_list(lease.archive(), "/", &error_code);
     if (error_code != 0) {
         sqsh_perror(error_code, "sqsh_easy_directory_list");
-        goto out;
+        free(cnames);
+        return names;
     }
     for(int i = 0; cnames[i] != NULL; i++) {
         QString nameString = QString::fromUtf8(cnames[i]);
         names.append(nameString);
     }
-
-out:
     free(cnames);
-    sqsh_archive_close(archive);
+
     return names;
 }
 
 QByteArray SqshArchiveReader::readFileFromArchive(const QString& sqsh_file, const QString& file_path) {
-    QByteArray sqsh_file_bytes = sqsh_file.toUtf8();
-    const void* sqsh_file_source = sqsh_file_bytes.constData();
-
-    QByteArray file_path_bytes = file_path.toUtf8();
-    const char* file_path_cstr = file_path_bytes.constData();
-
-    uint8_t *file_data = NULL;
-    size_t file_size = 0;
-    QByteArray data; // Declare the 'data' variable here
-    int error_code = 0;
-    struct SqshConfig config = {
-            .archive_offset = archive_offset_,
-    };
-    struct SqshArchive* archive = sqsh_archive_open(sqsh_file_source, &config, &error_code);
-    if (error_code != 0) {
-        sqsh_perror(error_code, "sqsh_archive_open");
-        goto out;
+    // Decompress the blocks straight into the result instead of into a temporary buffer
+    SqshFileDevice device(sqsh_file, archive_offset_, file_path);
+    if (!device.open(QIODevice::ReadOnly)) {
+        return QByteArray();
     }
-
-    file_size = sqsh_easy_file_size(archive, file_path_cstr, &error_code);
-    if (error_code != 0) {
-        sqsh_perror(error_code, "sqsh_easy_file_size");
-        goto out;
+    QByteArray data(device.size(), Qt::Uninitialized);
+    qint64 bytesRead = device.read(data.data(), data.size());
+    if (bytesRead < 0) {
+        return QByteArray();
     }
-    file_data = sqsh_easy_file_content(archive, file_path_cstr, &error_code);
-    if (error_code != 0) {
-        sqsh_perror(error_code, "sqsh_easy_file_content");
-        goto out;
-    }
-    data.append(reinterpret_cast<char*>(file_data), file_size);
+    data.resize(bytesRead);
+    return data;
+}
 
-out:
-    free(file_data);
-    sqsh_archive_close(archive);
+QByteArray SqshArchiveReader::readRangeFromArchive(const QString& sqsh_file, const QString& file_path,
+                                                   qint64 offset, qint64 length) {
+    SqshFileDevice device(sqsh_file, archive_offset_, file_path);
+    if (!device.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    return device.readRange(offset, length);
+}
 
-    return data;
+SqshFileDevice* SqshArchiveReader::openFileFromArchive(const QString& sqsh_file, const QString& file_path,
+                                                       QObject* parent) {
+    SqshFileDevice *device = new SqshFileDevice(sqsh_file, archive_offset_, file_path, parent);
+    if (!device->open(QIODevice::ReadOnly)) {
+        delete device;
+        return nullptr;
+    }
+    return device;
 }
@@ -64,6 +64,8 @@
 #include <QString>
 #include <QByteArray>
 
+class SqshFileDevice;
+
 /**
  * @brief The SqshArchiveReader class provides functionality to read files from a SquashFS archive.
  *
@@ -96,6 +98,25 @@ public:
      */
     QByteArray readFileFromArchive(const QString& sqsh_file, const QString& file_path);
 
+    /**
+     * @brief Reads a range of a file from the SquashFS archive without decompressing the rest of it.
+     * @param sqsh_file The path to the SquashFS archive file.
+     * @param file_path The path of the file to read from the archive.
+     * @param offset The position of the range in the file.
+     * @param length The maximum number of bytes to read.
+     * @return QByteArray containing the data of the range.
+     */
+    QByteArray readRangeFromArchive(const QString& sqsh_file, const QString& file_path, qint64 offset, qint64 length);
+
+    /**
+     * @brief Opens a file in the SquashFS archive for streaming, e.g., to copy it out of the archive.
+     * @param sqsh_file The path to the SquashFS archive file.
+     * @param file_path The path of the file to open in the archive.
+     * @param parent The parent of the returned device.
+     * @return The opened device, or nullptr if the file cannot be opened.
+     */
+    SqshFileDevice* openFileFromArchive(const QString& sqsh_file, const QString& file_path, QObject* parent = nullptr);
+
 private:
     uint64_t archive_offset_; ///< The offset at which the SquashFS archive starts in the source file.
 };
@@ -0,0 +1,234 @@
+/*-
+ * Copyright (c) 2022-23 Simon Peter <probono@puredarwin.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "SqshFileDevice.h"
+
+#include <QFile>
+#include <QDebug>
+
+#include <string.h>
+#include <sqsh.h>
+
+// How much data we ask the iterator for at a time; it returns at least one block
+static const size_t desiredChunkSize = 128 * 1024;
+
+SqshFileDevice::SqshFileDevice(const QString &archivePath, uint64_t archiveOffset,
+                               const QString &filePath, QObject *parent)
+    : QIODevice(parent),
+      m_archivePath(archivePath),
+      m_archiveOffset(archiveOffset),
+      m_filePath(filePath)
+{
+}
+
+SqshFileDevice::~SqshFileDevice()
+{
+    close();
+}
+
+bool SqshFileDevice::open(OpenMode mode)
+{
+    if (isOpen()) {
+        return false;
+    }
+    if ((mode & ReadWrite) != ReadOnly) {
+        setErrorString(tr("Files in SquashFS archives are read-only"));
+        return false;
+    }
+
+    m_lease = SqshArchivePool::instance()->acquire(m_archivePath, m_archiveOffset);
+    if (!m_lease.isValid()) {
+        setErrorString(tr("Cannot open archive %1").arg(m_archivePath));
+        return false;
+    }
+
+    int error_code = 0;
+    QByteArray filePath = m_filePath.toUtf8();
+    m_file = sqsh_open(m_lease.archive(), filePath.constData(), &error_code);
+    if (error_code != 0) {
+        sqsh_perror(error_code, "sqsh_open");
+        setErrorString(tr("Cannot open %1 in archive %2").arg(m_filePath, m_archivePath));
+        m_file = nullptr;
+        m_lease = SqshArchivePool::Lease();
+        return false;
+    }
+    m_size = static_cast<qint64>(sqsh_file_size(m_file));
+
+    if (!resetIterator()) {
+        sqsh_close(m_file);
+        m_file = nullptr;
+        m_lease = SqshArchivePool::Lease();
+        return false;
+    }
+
+    // QIODevice's own buffer would only add another copy
+    return QIODevice::open(mode | Unbuffered);
+}
+
+void SqshFileDevice::close()
+{
+    if (!isOpen()) {
+        return;
+    }
+    QIODevice::close();
+
+    if (m_iterator) {
+        sqsh_file_iterator_free(m_iterator);
+        m_iterator = nullptr;
+    }
+    if (m_file) {
+        sqsh_close(m_file);
+        m_file = nullptr;
+    }
+    // Return the archive to the pool
+    m_lease = SqshArchivePool::Lease();
+    m_size = 0;
+}
+
+bool SqshFileDevice::isSequential() const
+{
+    return false;
+}
+
+qint64 SqshFileDevice::size() const
+{
+    return m_size;
+}
+
+bool SqshFileDevice::seek(qint64 pos)
+{
+    if (!isOpen() || pos < 0 || pos > m_size) {
+        return false;
+    }
+
+    // The iterator only moves forward
+    if (pos < m_chunkStart && !resetIterator()) {
+        return false;
+    }
+
+    if (pos >= m_chunkStart + m_chunkSize && pos < m_size) {
+        // Skip the blocks in between without decompressing them; the offset is relative
+        // to the current block and is updated to be relative to the block that contains it
+        sqsh_index_t offset = static_cast<sqsh_index_t>(pos - m_chunkStart);
+        int error_code = sqsh_file_iterator_skip(m_iterator, &offset, 1);
+        if (error_code < 0) {
+            sqsh_perror(error_code, "sqsh_file_iterator_skip");
+            setErrorString(tr("Cannot seek in %1").arg(m_filePath));
+            return false;
+        }
+        m_chunkData = reinterpret_cast<const char *>(sqsh_file_iterator_data(m_iterator));
+        m_chunkSize = static_cast<qint64>(sqsh_file_iterator_size(m_iterator));
+        m_chunkStart = pos - static_cast<qint64>(offset);
+        m_chunkPos = static_cast<qint64>(offset);
+    } else {
+        m_chunkPos = pos - m_chunkStart;
+    }
+
+    return QIODevice::seek(pos);
+}
+
+QByteArray SqshFileDevice::readRange(qint64 offset, qint64 length)
+{
+    if (!seek(offset)) {
+        return QByteArray();
+    }
+    QByteArray data(qMax<qint64>(0, qMin(length, m_size - offset)), Qt::Uninitialized);
+    qint64 bytesRead = read(data.data(), data.size());
+    data.resize(qMax<qint64>(0, bytesRead));
+    return data;
+}
+
+qint64 SqshFileDevice::readData(char *data, qint64 maxSize)
+{
+    // After seeking to the end, the position is beyond the current block
+    if (m_chunkStart + m_chunkPos >= m_size) {
+        return 0;
+    }
+
+    qint64 bytesRead = 0;
+    while (bytesRead < maxSize) {
+        if (m_chunkPos >= m_chunkSize && !nextChunk()) {
+            break;
+        }
+        qint64 length = qMin(maxSize - bytesRead, m_chunkSize - m_chunkPos);
+        memcpy(data + bytesRead, m_chunkData + m_chunkPos, length);
+        bytesRead += length;
+        m_chunkPos += length;
+    }
+
+    if (bytesRead == 0 && m_failed) {
+        return -1;
+    }
+    return bytesRead;
+}
+
+qint64 SqshFileDevice::writeData(const char *data, qint64 maxSize)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+    return -1;
+}
+
+bool SqshFileDevice::nextChunk()
+{
+    int error_code = 0;
+    bool hasNext = sqsh_file_iterator_next(m_iterator, desiredChunkSize, &error_code);
+    if (error_code < 0) {
+        sqsh_perror(error_code, "sqsh_file_iterator_next");
+        setErrorString(tr("Cannot read %1").arg(m_filePath));
+        m_failed = true;
+        return false;
+    }
+    if (!hasNext) {
+        return false;
+    }
+    m_chunkStart += m_chunkSize;
+    m_chunkData = reinterpret_cast<const char *>(sqsh_file_iterator_data(m_iterator));
+    m_chunkSize = static_cast<qint64>(sqsh_file_iterator_size(m_iterator));
+    m_chunkPos = 0;
+    return true;
+}
+
+bool SqshFileDevice::resetIterator()
+{
+    if (m_iterator) {
+        sqsh_file_iterator_free(m_iterator);
+    }
+    int error_code = 0;
+    m_iterator = sqsh_file_iterator_new(m_file, &error_code);
+    if (error_code != 0) {
+        sqsh_perror(error_code, "sqsh_file_iterator_new");
+        setErrorString(tr("Cannot read %1").arg(m_filePath));
+        m_iterator = nullptr;
+        return false;
+    }
+    m_failed = false;
+    m_chunkData = nullptr;
+    m_chunkStart = 0;
+    m_chunkSize = 0;
+    m_chunkPos = 0;
+    return true;
+}
@@ -0,0 +1,122 @@
+/*-
+ * Copyright (c) 2022-23 Simon Peter <probono@puredarwin.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef SQSHFILEDEVICE_H
+#define SQSHFILEDEVICE_H
+
+#include <QIODevice>
+#include <QString>
+#include "SqshArchivePool.h"
+
+struct SqshFile;
+struct SqshFileIterator;
+
+/**
+ * @file SqshFileDevice.h
+ * @class SqshFileDevice
+ * @brief A read-only QIODevice for a file inside a SquashFS archive, e.g., inside an AppImage.
+ *
+ * Unlike SqshArchiveReader::readFileFromArchive(), which decompresses the whole file into
+ * memory, SqshFileDevice decompresses one block at a time as it is read, and seeking forward
+ * skips blocks without decompressing them. This allows previewing or copying large files out
+ * of an archive without holding them in memory, and reading a byte range of a file without
+ * decompressing what comes before it.
+ *
+ * The archive is leased from SqshArchivePool for as long as the device is open.
+ */
+class SqshFileDevice : public QIODevice
+{
+Q_OBJECT
+
+public:
+    /**
+     * @brief Constructs a device for a file inside an archive; call open() before reading.
+     * @param archivePath The path of the file that contains the archive.
+     * @param archiveOffset The offset of the archive in that file.
+     * @param filePath The path of the file inside the archive.
+     * @param parent The parent QObject.
+     */
+    SqshFileDevice(const QString &archivePath, uint64_t archiveOffset, const QString &filePath,
+                   QObject *parent = nullptr);
+
+    ~SqshFileDevice() override;
+
+    /**
+     * @brief Opens the file; only QIODevice::ReadOnly is supported.
+     * @param mode The open mode.
+     * @return True if the file was opened, false otherwise; see errorString().
+     */
+    bool open(OpenMode mode) override;
+
+    void close() override;
+
+    bool isSequential() const override;
+
+    qint64 size() const override;
+
+    bool seek(qint64 pos) override;
+
+    /**
+     * @brief Reads a range of the file, decompressing only the blocks that contain it.
+     * @param offset The position of the range in the file.
+     * @param length The maximum number of bytes to read.
+     * @return The data, which is shorter than length if the file ends before.
+     */
+    QByteArray readRange(qint64 offset, qint64 length);
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+    /**
+     * @brief Advances the iterator to the next block.
+     * @return False at the end of the file or on error.
+     */
+    bool nextChunk();
+
+    /**
+     * @brief Creates a new iterator at the beginning of the file.
+     */
+    bool resetIterator();
+
+    QString m_archivePath;
+    uint64_t m_archiveOffset;
+    QString m_filePath;
+
+    SqshArchivePool::Lease m_lease; ///< The archive, while the device is open.
+    SqshFile *m_file = nullptr;
+    SqshFileIterator *m_iterator = nullptr;
+    qint64 m_size = 0;
+
+    const char *m_chunkData = nullptr; ///< The current block; owned by m_iterator.
+    qint64 m_chunkStart = 0; ///< The position of the current block in the file.
+    qint64 m_chunkSize = 0;  ///< The size of the current block, or 0 before the first one.
+    qint64 m_chunkPos = 0;   ///< The read position within the current block.
+    bool m_failed = false;   ///< Whether decompressing a block failed.
+};
+
+#endif // SQSHFILEDEVICE_H
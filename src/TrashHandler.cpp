@@ -28,7 +28,6 @@
 #include <QApplication>
 #include <QLocale>
 #include <QTranslator>
-#include <QStorageInfo>
 #include <QDebug>
 #include <QProcess>
 #include <QMessageBox>
@@ -39,6 +38,7 @@
 #include "AppGlobals.h"
 #include <QFileSystemWatcher>
 #include "Mountpoints.h"
+#include "MountTable.h"
 #include "FileOperationManager.h"
 
 QString TrashHandler::m_trashPath = QDir::homePath() + "/.local/share/Trash/files";
@@ -242,11 +242,11 @@ void TrashHandler::moveToTrash(const QStringList& paths) {
         // Check if the file/directory is on the same mount point as the Trash directory
         QFileInfo trashDirInfo(m_trashPath);
         if (trashDirInfo.isDir()) {
-            QStorageInfo trashDirStorageInfo(m_trashPath);
-            QStorageInfo fileStorageInfo(path);
-            qDebug() << "Trash dir mount point: " << trashDirStorageInfo.rootPath();
-            qDebug() << "File root mount point: " << fileStorageInfo.rootPath();
-            if (trashDirStorageInfo.rootPath() == fileStorageInfo.rootPath()) {
+            QString trashDirMountPoint = MountTable::instance()->mountPointFor(m_trashPath);
+            QString fileMountPoint = MountTable::instance()->mountPointFor(path);
+            qDebug() << "Trash dir mount point: " << trashDirMountPoint;
+            qDebug() << "File root mount point: " << fileMountPoint;
+            if (trashDirMountPoint == fileMountPoint) {
                 // The file/directory is on the same mount point as the Trash directory
                 // Move the file/directory to the Trash directory
                 qDebug() << "The file/directory is on the same mount point as the Trash directory";
@@ -37,15 +37,20 @@
 #include "AppGlobals.h"
 #include "TrashHandler.h"
 #include <QDateTime>
-#include "MountWatcherThread.h"
+#include "MountWatcher.h"
+#include <QSocketNotifier>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/inotify.h>
+#endif
 
-VolumeWatcher::VolumeWatcher(QObject *parent) : QObject(parent)
+VolumeWatcher::VolumeWatcher(QObject *parent) : QObject(parent), m_inotifyFd(-1), m_inotifyNotifier(nullptr)
 {
 
     m_mediaPath = getMediaPath();
 
-    m_watcher.addPath(m_mediaPath);
-
     QString diskLabel = getRootDiskName();
 
     if (! QFile::exists(QDir::homePath() + "/Desktop/" + diskLabel)) {
@@ -58,72 +63,175 @@ VolumeWatcher::VolumeWatcher(QObject *parent) : QObject(parent)
         QFile::link(trashPath, QDir::homePath() + "/Desktop/" + tr("Trash"));
     }
 
-    // Run initially
+    // Watch before listing, so that no change gets lost in between
+    if (!startInotify()) {
+        m_watcher.addPath(m_mediaPath);
+        connect(&m_watcher, &QFileSystemWatcher::directoryChanged, this, &VolumeWatcher::handleDirectoryChange);
+        // We also need to get notified when directories are deleted, so we monitor the parent directory like this:
+        connect(&m_watcher, &QFileSystemWatcher::fileChanged, this, &VolumeWatcher::handleDirectoryChange);
+    }
+
+    // Run initially; this also removes symlinks left over from an earlier session
+    loadExistingLinks();
     handleDirectoryChange(m_mediaPath);
+}
 
-    connect(&m_watcher, &QFileSystemWatcher::directoryChanged, this, &VolumeWatcher::handleDirectoryChange);
-    // We also need to get notified when directories are deleted, so we monitor the parent directory like this:
-    connect(&m_watcher, &QFileSystemWatcher::fileChanged, this, &VolumeWatcher::handleDirectoryChange);
+VolumeWatcher::~VolumeWatcher()
+{
+#if defined(__linux__)
+    if (m_inotifyFd >= 0) {
+        ::close(m_inotifyFd);
+    }
+#endif
 }
 
+// Compares the contents of the media directory with what we know, and applies the differences
 void VolumeWatcher::handleDirectoryChange(const QString &path)
 {
     qDebug() << "Directory changed:" << path;
-    QDir mediaDir(path);
-    QStringList mediaDirectories = mediaDir.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
-
-    // Construct a list of symlinks that we have already created
-    QString directoryPath = QDir::homePath() + "/Desktop"; // Change this to the directory you want to search
-
-    QDir directory(directoryPath);
-    QFileInfoList entries = directory.entryInfoList(QDir::NoDotAndDotDot | QDir::Files | QDir::Dirs | QDir::System | QDir::Hidden | QDir::NoSymLinks, QDir::DirsFirst);
+    const QStringList names = listMediaEntries();
+    QSet<QString> currentNames;
+    for (const QString &name : names) {
+        currentNames.insert(name);
+        if (!m_mediaEntries.contains(name)) {
+            addMediaEntry(name);
+        }
+    }
 
-    QStringList symlinkPaths;
+    QStringList removedNames;
+    for (const QString &name : m_mediaEntries) {
+        if (!currentNames.contains(name)) {
+            removedNames.append(name);
+        }
+    }
+    for (auto it = m_links.constBegin(); it != m_links.constEnd(); ++it) {
+        if (!currentNames.contains(it.key()) && !removedNames.contains(it.key())) {
+            removedNames.append(it.key());
+        }
+    }
+    for (const QString &name : removedNames) {
+        removeMediaEntry(name);
+    }
+}
 
-            foreach (const QFileInfo &entryInfo, entries) {
-            if (entryInfo.isSymLink()) {
-                // If links to /media
-                if (entryInfo.symLinkTarget().startsWith(m_mediaPath + "/")) {
-                    symlinkPaths.append(entryInfo.fileName());
-                }
+void VolumeWatcher::handleInotifyEvents()
+{
+#if defined(__linux__)
+    // Large enough for many events at once, e.g., when a hub with many partitions is plugged in
+    alignas(struct inotify_event) char buffer[16 * 1024];
+    for (;;) {
+        ssize_t length = ::read(m_inotifyFd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            break;
+        }
+        for (char *position = buffer; position < buffer + length;) {
+            const struct inotify_event *event = reinterpret_cast<const struct inotify_event *>(position);
+            position += sizeof(struct inotify_event) + event->len;
+            if (event->mask & IN_Q_OVERFLOW) {
+                // Events were lost, so we have to compare everything once
+                handleDirectoryChange(m_mediaPath);
+                continue;
+            }
+            if (!(event->mask & IN_ISDIR) || event->len == 0) {
+                continue;
+            }
+            const QString name = QFile::decodeName(event->name);
+            if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                addMediaEntry(name);
+            } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                removeMediaEntry(name);
             }
         }
+    }
+#endif
+}
 
-    qDebug() << "Symlink paths:" << symlinkPaths;
-
-    for (const QString &dirName : mediaDirectories) {
-        QString fullPath = mediaDir.absoluteFilePath(dirName);
-        QString symlinkPath = QDir::homePath() + "/Desktop/" + dirName;
+bool VolumeWatcher::startInotify()
+{
+#if defined(__linux__)
+    m_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotifyFd < 0) {
+        return false;
+    }
+    if (inotify_add_watch(m_inotifyFd, QFile::encodeName(m_mediaPath).constData(),
+                          IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR) < 0) {
+        qDebug() << "Cannot watch" << m_mediaPath << "with inotify:" << strerror(errno);
+        ::close(m_inotifyFd);
+        m_inotifyFd = -1;
+        return false;
+    }
+    m_inotifyNotifier = new QSocketNotifier(m_inotifyFd, QSocketNotifier::Read, this);
+    connect(m_inotifyNotifier, &QSocketNotifier::activated, this, &VolumeWatcher::handleInotifyEvents);
+    return true;
+#else
+    return false;
+#endif
+}
 
-        // Skip /media/LIVE if it is the same as /
-        if (fullPath == "/media/LIVE") {
-            // Using the file COPYRIGHT, compare the creation date
-            QFileInfo fileInfo1("/COPYRIGHT");
-            QFileInfo fileInfo2("/media/LIVE/COPYRIGHT");
-            if (fileInfo1.created() == fileInfo2.created()) {
-                qDebug() << "Skipping" << fullPath << "because it is the same as /";
-                continue;
-            }
+// Finds the symlinks to the media directory that are on the desktop already
+void VolumeWatcher::loadExistingLinks()
+{
+    QDir directory(QDir::homePath() + "/Desktop");
+    const QFileInfoList entries = directory.entryInfoList(QDir::NoDotAndDotDot | QDir::Files | QDir::Dirs | QDir::System | QDir::Hidden);
+    const QString prefix = m_mediaPath + "/";
+    for (const QFileInfo &entryInfo : entries) {
+        if (entryInfo.isSymLink() && entryInfo.symLinkTarget().startsWith(prefix)) {
+            QString name = entryInfo.symLinkTarget().mid(prefix.size()).section('/', 0, 0);
+            m_links.insert(name, entryInfo.absoluteFilePath());
         }
+    }
+    qDebug() << "Symlink paths:" << m_links.values();
+}
 
-        startWaitingForMounted(fullPath, symlinkPath);
+void VolumeWatcher::addMediaEntry(const QString &name)
+{
+    if (m_mediaEntries.contains(name)) {
+        return;
     }
+    m_mediaEntries.insert(name);
+    QString fullPath = m_mediaPath + "/" + name;
 
-    // Clean up symlinks for targets that no longer exist in /media/
-    for (const QString &symlinkPath : symlinkPaths) {
-        QString fullPath = m_mediaPath + "/" + symlinkPath;
-        if (!QFile::exists(fullPath)) {
-            QFile::remove(QDir::homePath() + "/Desktop/" + symlinkPath);
-            qDebug() << "Symlink removed for" << fullPath;
+    // Skip /media/LIVE if it is the same as /
+    if (fullPath == "/media/LIVE") {
+        // Using the file COPYRIGHT, compare the creation date
+        QFileInfo fileInfo1("/COPYRIGHT");
+        QFileInfo fileInfo2("/media/LIVE/COPYRIGHT");
+        if (fileInfo1.created() == fileInfo2.created()) {
+            qDebug() << "Skipping" << fullPath << "because it is the same as /";
+            return;
         }
     }
+
+    QString symlinkPath = m_links.value(name, QDir::homePath() + "/Desktop/" + name);
+    m_links.insert(name, symlinkPath);
+    startWaitingForMounted(fullPath, symlinkPath);
+}
+
+void VolumeWatcher::removeMediaEntry(const QString &name)
+{
+    m_mediaEntries.remove(name);
+    QString symlinkPath = m_links.take(name);
+    if (symlinkPath.isEmpty()) {
+        return;
+    }
+    // Only remove what we created, not something of the user's that happens to have the same name
+    QString fullPath = m_mediaPath + "/" + name;
+    QFileInfo linkInfo(symlinkPath);
+    QString target = linkInfo.symLinkTarget();
+    if (linkInfo.isSymLink() && (target == fullPath || target.startsWith(fullPath + "/"))) {
+        QFile::remove(symlinkPath);
+        qDebug() << "Symlink removed for" << fullPath;
+    }
+}
+
+QStringList VolumeWatcher::listMediaEntries() const
+{
+    return QDir(m_mediaPath).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
 }
 
 void VolumeWatcher::startWaitingForMounted(const QString &fullPath, const QString &symlinkPath) const {
-    // Wait until mounted, then create symlink; non-blocking (in its own thread)
-    MountWatcherThread *thread = new MountWatcherThread(fullPath, symlinkPath);
-    connect(thread, &QThread::finished, thread, &QThread::deleteLater);
-    thread->start();
+    // Wait until mounted, then create symlink; non-blocking (MountWatcher is told when something gets mounted)
+    MountWatcher::instance()->watch(fullPath, symlinkPath);
 }
 
 QString VolumeWatcher::getMediaPath() {
@@ -29,15 +29,22 @@
 
 #include <QObject>
 #include <QFileSystemWatcher>
+#include <QHash>
+#include <QSet>
+
+class QSocketNotifier;
 
 /**
  * @file VolumeWatcher.h
  * @class VolumeWatcher
  * @brief The VolumeWatcher class monitors changes in a directory and manages symlinks to new directories.
  *
- * This class uses QFileSystemWatcher to keep track of changes in the /media directory.
- * When a new subdirectory appears, it creates a symlink to that subdirectory on the user's desktop.
- * If a subdirectory disappears, the corresponding symlink is removed.
+ * This class keeps track of changes in the /media directory, using inotify on Linux and
+ * QFileSystemWatcher elsewhere. When a new subdirectory appears, it creates a symlink to that
+ * subdirectory on the user's desktop once a volume is mounted on it. If a subdirectory disappears,
+ * the corresponding symlink is removed. Which subdirectories exist and which symlinks belong to them
+ * is kept in memory, so that each change only touches the entries that changed; the desktop is
+ * only scanned once, at startup.
  * @Note This class should be replaced by a more appropriate solution, e.g., using a QProxyModel
  * to display the contents of the /media directory alongside the contents of the user's home directory
  * without the need to create symlinks.
@@ -52,6 +59,7 @@ public:
      * @param parent The parent QObject.
      */
     explicit VolumeWatcher(QObject *parent = nullptr);
+    ~VolumeWatcher();
 
     static QString getMediaPath();
 
@@ -64,9 +72,24 @@ private slots:
      */
     void handleDirectoryChange(const QString &path);
 
+    /**
+     * @brief Reads the pending inotify events and applies them.
+     */
+    void handleInotifyEvents();
+
 private:
-    QFileSystemWatcher m_watcher; /**< The QFileSystemWatcher used to monitor changes. */
+    QFileSystemWatcher m_watcher; /**< The QFileSystemWatcher used if inotify is not available. */
     QString m_mediaPath; /**< The path of the directory to monitor. */
+    int m_inotifyFd; /**< -1 if inotify is not available. */
+    QSocketNotifier *m_inotifyNotifier;
+    QSet<QString> m_mediaEntries; /**< The names of the subdirectories of m_mediaPath. */
+    QHash<QString, QString> m_links; /**< The symlink on the desktop for each subdirectory, by name. */
+
+    bool startInotify();
+    void loadExistingLinks();
+    void addMediaEntry(const QString &name);
+    void removeMediaEntry(const QString &name);
+    QStringList listMediaEntries() const;
     void startWaitingForMounted(const QString &fullPath, const QString &symlinkPath) const;
 };
 
@@ -0,0 +1,637 @@
+#include "CopyEngine.h"
+#include "CopyJournal.h"
+#include "FileMetadata.h"
+#include "Xxh64.h"
+#include <QCoreApplication>
+#include <QFile>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThread>
+#include <QDebug>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#include <linux/fs.h>
+#elif defined(__FreeBSD__)
+#include <sys/param.h>
+#endif
+
+#if defined(__linux__) || (defined(__FreeBSD__) && __FreeBSD_version >= 1300000)
+#define HAVE_COPY_FILE_RANGE
+#endif
+
+namespace {
+
+// Files up to this size are copied on the worker pool
+const qint64 smallFileSize = 1024 * 1024;
+// Number of bytes the kernel is asked to copy at once, so that we can report progress and cancel in between
+const qint64 kernelChunkSize = 16 * 1024 * 1024;
+// Size and alignment of the buffer used when the kernel cannot copy for us
+const size_t bufferSize = 1024 * 1024;
+const size_t bufferAlignment = 4096;
+// With a journal, large files are synced to disk and their progress recorded whenever this many bytes have been copied
+const qint64 checkpointInterval = 64 * 1024 * 1024;
+
+QString tr(const char* text)
+{
+    return QCoreApplication::translate("CopyEngine", text);
+}
+
+// A file is written under this name next to its target and only renamed to the target once it is complete,
+// so that a copy that was interrupted never looks like a complete file
+QString partialPath(const QString& toPath)
+{
+    const int slash = toPath.lastIndexOf('/');
+    return toPath.left(slash + 1) + "." + toPath.mid(slash + 1) + ".filer-part";
+}
+
+// Moves the complete copy to its target; when resuming, a target that is there is one the interrupted
+// run renamed but had not recorded yet
+bool moveIntoPlace(const QByteArray& partName, const QByteArray& toName, bool replace)
+{
+#if defined(__linux__) && defined(RENAME_NOREPLACE)
+    if (!replace) {
+        if (renameat2(AT_FDCWD, partName.constData(), AT_FDCWD, toName.constData(), RENAME_NOREPLACE) == 0) {
+            return true;
+        }
+        if (errno != ENOSYS && errno != EINVAL) {
+            return false;
+        }
+    }
+#endif
+    struct stat st;
+    if (!replace && ::lstat(toName.constData(), &st) == 0) {
+        errno = EEXIST;
+        return false;
+    }
+    return ::rename(partName.constData(), toName.constData()) == 0;
+}
+
+}
+
+class CopyFileJob : public QRunnable {
+public:
+    CopyFileJob(CopyEngine* engine, const QString& fromPath, const QString& toPath)
+            : engine(engine), fromPath(fromPath), toPath(toPath) {
+    }
+
+    void run() override {
+        engine->copyFileNow(fromPath, toPath);
+        engine->queueSlots.release();
+    }
+
+private:
+    CopyEngine* engine;
+    QString fromPath;
+    QString toPath;
+};
+
+CopyEngine::CopyEngine()
+        : journal(nullptr), verify(false), canceled(false), paused(false), failed(false), copied(0),
+          copiedFileCount(0) {
+    // Beyond a handful of threads, a single disk gets slower rather than faster
+    int threadCount = qBound(2, QThread::idealThreadCount(), 8);
+    workerPool.setMaxThreadCount(threadCount);
+    queueSlots.release(threadCount * 16);
+}
+
+CopyEngine::~CopyEngine() {
+    cancel();
+    workerPool.clear();
+    workerPool.waitForDone();
+}
+
+bool CopyEngine::copyFile(const QString& fromPath, const QString& toPath) {
+    if (canceled || failed) {
+        return false;
+    }
+
+    struct stat st;
+    if (::stat(QFile::encodeName(fromPath).constData(), &st) == 0 && st.st_size <= smallFileSize) {
+        queueSlots.acquire();
+        workerPool.start(new CopyFileJob(this, fromPath, toPath));
+        return !failed;
+    }
+
+    return copyFileNow(fromPath, toPath);
+}
+
+bool CopyEngine::waitForDone() {
+    workerPool.waitForDone();
+    return !canceled && !failed;
+}
+
+void CopyEngine::cancel() {
+    QMutexLocker locker(&pauseMutex);
+    canceled = true;
+    unpaused.wakeAll();
+}
+
+void CopyEngine::setPaused(bool paused) {
+    QMutexLocker locker(&pauseMutex);
+    this->paused = paused;
+    if (!paused) {
+        unpaused.wakeAll();
+    }
+}
+
+bool CopyEngine::isCanceled() const {
+    return canceled;
+}
+
+qint64 CopyEngine::copiedBytes() const {
+    return copied;
+}
+
+int CopyEngine::copiedFiles() const {
+    return copiedFileCount;
+}
+
+QString CopyEngine::errorMessage() const {
+    QMutexLocker locker(&errorMutex);
+    return error;
+}
+
+bool CopyEngine::copyFileNow(const QString& fromPath, const QString& toPath) {
+    if (!mayContinue() || failed) {
+        return false;
+    }
+
+    const QByteArray fromName = QFile::encodeName(fromPath);
+    const QByteArray toName = QFile::encodeName(toPath);
+    const QByteArray partName = QFile::encodeName(partialPath(toPath));
+
+    int fromFd = ::open(fromName.constData(), O_RDONLY | O_CLOEXEC);
+    if (fromFd < 0) {
+        setError(tr("Cannot open %1: %2").arg(fromPath, QString::fromLocal8Bit(strerror(errno))));
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fromFd, &st) != 0) {
+        setError(tr("Cannot read %1: %2").arg(fromPath, QString::fromLocal8Bit(strerror(errno))));
+        ::close(fromFd);
+        return false;
+    }
+
+    // O_EXCL so that we never write into a file or symlink that appeared in the meantime; when resuming,
+    // a partial copy that exists is what the interrupted run left behind
+    const bool resuming = journal && journal->isResumed();
+    int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (resuming ? O_NOFOLLOW : O_EXCL);
+    int toFd = ::open(partName.constData(), flags, S_IRUSR | S_IWUSR);
+    if (toFd < 0) {
+        setError(tr("Cannot create %1: %2").arg(toPath, QString::fromLocal8Bit(strerror(errno))));
+        ::close(fromFd);
+        return false;
+    }
+
+#if defined(__linux__)
+    posix_fadvise(fromFd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    Transfer transfer;
+    transfer.fromPath = fromPath;
+    transfer.fromFd = fromFd;
+    transfer.toFd = toFd;
+    transfer.size = st.st_size;
+    transfer.end = st.st_size;
+    transfer.offset = 0;
+    transfer.checkpoint = 0;
+    Xxh64 sourceHash;
+    transfer.hash = verify ? &sourceHash : nullptr;
+
+    if (resuming) {
+        // Continue after what the interrupted run had safely written, and drop whatever came after that
+        struct stat toStat;
+        qint64 offset = journal->resumeOffset(fromPath);
+        if (fstat(toFd, &toStat) == 0) {
+            offset = qMin<qint64>(offset, toStat.st_size);
+        } else {
+            offset = 0;
+        }
+        if (ftruncate(toFd, offset) != 0) {
+            offset = 0;
+            if (ftruncate(toFd, 0) != 0) {
+                qWarning() << "Cannot truncate" << QFile::decodeName(partName) << strerror(errno);
+            }
+        }
+        transfer.offset = offset;
+        transfer.checkpoint = offset;
+        addCopiedBytes(offset);
+    }
+
+    Status status = Copied;
+    if (verify && transfer.offset > 0 && hashFile(fromFd, transfer.offset, sourceHash) != transfer.offset) {
+        status = Failed;
+    }
+    if (status == Copied) {
+        // When verifying, the data has to pass through our hands to be hashed, so it cannot be cloned
+        status = transfer.offset == 0 && !verify ? cloneFile(transfer) : Unsupported;
+    }
+    if (status == Unsupported) {
+        // Fewer blocks than the size takes means that the file has holes, e.g., a disk image
+        status = static_cast<qint64>(st.st_blocks) * 512 < transfer.size ? copySparse(transfer) : copyRange(transfer);
+    }
+    if (status == Copied && verify) {
+        status = verifyTarget(transfer, partName);
+    }
+
+    if (status == Failed && !canceled) {
+        setError(tr("Cannot copy %1: %2").arg(fromPath, QString::fromLocal8Bit(strerror(errno))));
+    }
+
+    // Last, because verifying reads the target and thereby changes its access time
+    if (status == Copied) {
+        FileMetadata::copy(fromFd, toFd, st);
+    }
+
+    if (::close(toFd) != 0 && status == Copied) {
+        // Delayed write errors, e.g., on NFS, are reported here
+        setError(tr("Cannot write %1: %2").arg(toPath, QString::fromLocal8Bit(strerror(errno))));
+        status = Failed;
+    }
+    ::close(fromFd);
+
+    if (status == Copied && !canceled && !moveIntoPlace(partName, toName, resuming)) {
+        setError(tr("Cannot create %1: %2").arg(toPath, QString::fromLocal8Bit(strerror(errno))));
+        status = Failed;
+    }
+
+    if (status != Copied || canceled) {
+        // When the copy fails, the partial copy is kept so that a journaled job can be resumed;
+        // when it is canceled, the user does not want it
+        if (!journal || canceled) {
+            ::unlink(partName.constData());
+        }
+        return false;
+    }
+    if (journal) {
+        // The journal syncs the file before it records it, together with others
+        journal->recordCompleted(fromPath, toPath, transfer.size);
+    }
+    copiedFileCount++;
+    return true;
+}
+
+void CopyEngine::skipFile(qint64 size) {
+    addCopiedBytes(size);
+    copiedFileCount++;
+}
+
+void CopyEngine::setJournal(CopyJournal* journal) {
+    this->journal = journal;
+}
+
+void CopyEngine::setVerify(bool verify) {
+    this->verify = verify;
+}
+
+CopyEngine::Status CopyEngine::cloneFile(Transfer& transfer) {
+#if defined(__linux__) && defined(FICLONE)
+    // Reflinks share the extents of the source, so copying takes no time regardless of the size
+    if (transfer.size > 0 && ioctl(transfer.toFd, FICLONE, transfer.fromFd) == 0) {
+        transfer.offset = transfer.size;
+        addCopiedBytes(transfer.size);
+        return Copied;
+    }
+#else
+    Q_UNUSED(transfer)
+#endif
+    return Unsupported;
+}
+
+CopyEngine::Status CopyEngine::copyFileRange(Transfer& transfer) {
+#if defined(HAVE_COPY_FILE_RANGE)
+    while (transfer.offset < transfer.end) {
+        if (!mayContinue()) {
+            return Failed;
+        }
+        off_t fromOffset = transfer.offset;
+        off_t toOffset = transfer.offset;
+        ssize_t n = copy_file_range(transfer.fromFd, &fromOffset, transfer.toFd, &toOffset,
+                                    static_cast<size_t>(qMin(transfer.end - transfer.offset, kernelChunkSize)), 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            // Across file systems and on older kernels, the caller falls back to the next method,
+            // which continues where we stopped
+            if (n == 0 || errno == EXDEV || errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP
+                || errno == EBADF) {
+                return Unsupported;
+            }
+            return Failed;
+        }
+        advance(transfer, n);
+    }
+    return Copied;
+#else
+    Q_UNUSED(transfer)
+    return Unsupported;
+#endif
+}
+
+CopyEngine::Status CopyEngine::sendFile(Transfer& transfer) {
+#if defined(__linux__)
+    // sendfile() writes at the file position of the target
+    if (transfer.offset < transfer.end && lseek(transfer.toFd, transfer.offset, SEEK_SET) != transfer.offset) {
+        return Unsupported;
+    }
+    while (transfer.offset < transfer.end) {
+        if (!mayContinue()) {
+            return Failed;
+        }
+        off_t fromOffset = transfer.offset;
+        ssize_t n = sendfile(transfer.toFd, transfer.fromFd, &fromOffset,
+                             static_cast<size_t>(qMin(transfer.end - transfer.offset, kernelChunkSize)));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            if (n == 0 || errno == EINVAL || errno == ENOSYS) {
+                return Unsupported;
+            }
+            return Failed;
+        }
+        advance(transfer, n);
+    }
+    return Copied;
+#else
+    Q_UNUSED(transfer)
+    return Unsupported;
+#endif
+}
+
+// Copies from offset up to end with the fastest method that works for this pair of files
+CopyEngine::Status CopyEngine::copyRange(Transfer& transfer) {
+    if (transfer.hash) {
+        return copyBuffered(transfer);
+    }
+    Status status = copyFileRange(transfer);
+    if (status == Unsupported) {
+        status = sendFile(transfer);
+    }
+    if (status == Unsupported) {
+        status = copyBuffered(transfer);
+    }
+    return status;
+}
+
+// Copies only the parts of the file that hold data, so that the holes stay holes in the target
+CopyEngine::Status CopyEngine::copySparse(Transfer& transfer) {
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+    while (transfer.offset < transfer.size) {
+        if (!mayContinue()) {
+            return Failed;
+        }
+        off_t data = lseek(transfer.fromFd, transfer.offset, SEEK_DATA);
+        if (data < 0 && errno == ENXIO) {
+            // Only a hole is left
+            data = transfer.size;
+        } else if (data < 0) {
+            // The file system cannot tell us where the holes are
+            break;
+        }
+        skipHole(transfer, qMin<qint64>(data, transfer.size) - transfer.offset);
+        if (transfer.offset >= transfer.size) {
+            break;
+        }
+
+        off_t hole = lseek(transfer.fromFd, transfer.offset, SEEK_HOLE);
+        const qint64 segmentEnd = hole < 0 ? transfer.size : qMin<qint64>(hole, transfer.size);
+        transfer.end = segmentEnd;
+        Status status = copyRange(transfer);
+        transfer.end = transfer.size;
+        if (status != Copied) {
+            return status;
+        }
+        if (transfer.offset < segmentEnd) {
+            // The file has shrunk while we copied it
+            return Copied;
+        }
+    }
+    if (transfer.offset >= transfer.size) {
+        // Writing past the end leaves holes in between; a hole at the end needs the size to be set
+        return ftruncate(transfer.toFd, transfer.size) == 0 ? Copied : Failed;
+    }
+#endif
+    return copyRange(transfer);
+}
+
+// Passes over a hole in the source without writing anything
+void CopyEngine::skipHole(Transfer& transfer, qint64 length) {
+    if (length <= 0) {
+        return;
+    }
+    if (transfer.hash) {
+        // Holes read as zeros, so they are part of the hash
+        static const char zeros[64 * 1024] = {};
+        for (qint64 remaining = length; remaining > 0; remaining -= sizeof(zeros)) {
+            transfer.hash->update(zeros, static_cast<size_t>(qMin<qint64>(remaining, sizeof(zeros))));
+        }
+    }
+    advance(transfer, length);
+}
+
+CopyEngine::Status CopyEngine::copyBuffered(Transfer& transfer) {
+    void* memory = nullptr;
+    int result = posix_memalign(&memory, bufferAlignment, bufferSize);
+    if (result != 0) {
+        errno = result;
+        return Failed;
+    }
+    char* buffer = static_cast<char*>(memory);
+
+    Status status = Copied;
+    while (transfer.offset < transfer.end) {
+        if (!mayContinue()) {
+            status = Failed;
+            break;
+        }
+        size_t wanted = static_cast<size_t>(qMin<qint64>(transfer.end - transfer.offset, bufferSize));
+        ssize_t bytesRead = pread(transfer.fromFd, buffer, wanted, transfer.offset);
+        if (bytesRead < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytesRead < 0) {
+            status = Failed;
+            break;
+        }
+        if (bytesRead == 0) {
+            // The file has shrunk while we copied it
+            break;
+        }
+        if (transfer.hash) {
+            // Have the kernel read the next chunk while we hash this one
+            prefetch(transfer.fromFd, transfer.offset + bytesRead);
+            transfer.hash->update(buffer, static_cast<size_t>(bytesRead));
+        }
+        ssize_t bytesWritten = 0;
+        while (bytesWritten < bytesRead) {
+            ssize_t n = pwrite(transfer.toFd, buffer + bytesWritten, bytesRead - bytesWritten,
+                               transfer.offset + bytesWritten);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n < 0) {
+                status = Failed;
+                break;
+            }
+            bytesWritten += n;
+        }
+        if (status == Failed) {
+            break;
+        }
+        advance(transfer, bytesRead);
+    }
+    // free() may clobber errno
+    int savedErrno = errno;
+    free(memory);
+    errno = savedErrno;
+    return status;
+}
+
+// Reads the target back, bypassing the page cache where possible, and compares its hash with that of the source
+CopyEngine::Status CopyEngine::verifyTarget(Transfer& transfer, const QByteArray& toName) {
+    // Dirty pages cannot be dropped, so they have to be written first; then we can read from the disk
+    if (fdatasync(transfer.toFd) != 0) {
+        return Failed;
+    }
+#if defined(POSIX_FADV_DONTNEED)
+    posix_fadvise(transfer.toFd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+
+    Xxh64 targetHash;
+    qint64 length = -1;
+#if defined(O_DIRECT)
+    int fd = ::open(toName.constData(), O_RDONLY | O_CLOEXEC | O_DIRECT);
+    if (fd >= 0) {
+        length = hashFile(fd, -1, targetHash);
+        ::close(fd);
+        if (length < 0 && errno != EINVAL) {
+            return Failed;
+        }
+    }
+#endif
+    if (length < 0) {
+        // The file system does not support O_DIRECT
+        targetHash.reset();
+        int fd = ::open(toName.constData(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return Failed;
+        }
+        length = hashFile(fd, -1, targetHash);
+        ::close(fd);
+        if (length < 0) {
+            return Failed;
+        }
+    }
+
+    if (length != transfer.offset || targetHash.digest() != transfer.hash->digest()) {
+        if (!canceled) {
+            setError(tr("The copy of %1 differs from the original.").arg(transfer.fromPath));
+        }
+        errno = EIO;
+        return Failed;
+    }
+    return Copied;
+}
+
+// Hashes the first length bytes of a file, or all of it if length is negative, and returns how many
+// bytes were hashed or -1 on error. The buffer is aligned so that this also works with O_DIRECT
+qint64 CopyEngine::hashFile(int fd, qint64 length, Xxh64& hash) {
+    void* memory = nullptr;
+    int result = posix_memalign(&memory, bufferAlignment, bufferSize);
+    if (result != 0) {
+        errno = result;
+        return -1;
+    }
+    char* buffer = static_cast<char*>(memory);
+
+    qint64 offset = 0;
+    prefetch(fd, 0);
+    while (length < 0 || offset < length) {
+        if (!mayContinue()) {
+            offset = -1;
+            break;
+        }
+        size_t wanted = bufferSize;
+        if (length >= 0 && length - offset < static_cast<qint64>(bufferSize)) {
+            wanted = static_cast<size_t>(length - offset);
+        }
+        ssize_t n = pread(fd, buffer, wanted, offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            offset = -1;
+            break;
+        }
+        if (n == 0) {
+            break;
+        }
+        prefetch(fd, offset + n);
+        hash.update(buffer, static_cast<size_t>(n));
+        offset += n;
+    }
+
+    int savedErrno = errno;
+    free(memory);
+    errno = savedErrno;
+    return offset;
+}
+
+// Starts reading the chunk at offset in the background
+void CopyEngine::prefetch(int fd, qint64 offset) {
+#if defined(POSIX_FADV_WILLNEED)
+    posix_fadvise(fd, offset, static_cast<off_t>(bufferSize), POSIX_FADV_WILLNEED);
+#else
+    Q_UNUSED(fd)
+    Q_UNUSED(offset)
+#endif
+}
+
+// Blocks while the copy is paused, and returns false once it has been canceled
+bool CopyEngine::mayContinue() {
+    if (paused) {
+        QMutexLocker locker(&pauseMutex);
+        while (paused && !canceled) {
+            unpaused.wait(&pauseMutex);
+        }
+    }
+    return !canceled;
+}
+
+// Accounts for bytes that have been copied and, now and then, makes them durable and records them in the journal
+void CopyEngine::advance(Transfer& transfer, qint64 bytes) {
+    transfer.offset += bytes;
+    addCopiedBytes(bytes);
+    if (journal && transfer.offset - transfer.checkpoint >= checkpointInterval) {
+        // Only what is on the disk may be skipped when resuming, e.g., after the disk was unplugged
+        if (fdatasync(transfer.toFd) == 0) {
+            journal->recordOffset(transfer.fromPath, transfer.offset);
+            transfer.checkpoint = transfer.offset;
+        }
+    }
+}
+
+void CopyEngine::addCopiedBytes(qint64 bytes) {
+    copied += bytes;
+}
+
+void CopyEngine::setError(const QString& errorMessage) {
+    QMutexLocker locker(&errorMutex);
+    if (!failed) {
+        error = errorMessage;
+        failed = true;
+        qDebug() << "CopyEngine:" << errorMessage;
+    }
+}
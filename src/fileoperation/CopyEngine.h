@@ -0,0 +1,138 @@
+#ifndef COPYENGINE_H
+#define COPYENGINE_H
+
+#include <QString>
+#include <QMutex>
+#include <QSemaphore>
+#include <QThreadPool>
+#include <QWaitCondition>
+#include <atomic>
+
+/**
+ * @brief Copies the contents of files using the fastest means the kernel offers.
+ *
+ * A file is cloned with FICLONE where the file system supports it (btrfs, XFS), otherwise it is
+ * copied inside the kernel with copy_file_range() or sendfile(), and only otherwise through a
+ * large aligned buffer. Small files are handed to a bounded pool of worker threads so that opening,
+ * creating and closing many of them overlaps; large files are copied on the calling thread one after
+ * the other so that the disks see sequential reads and writes. Holes in sparse files are skipped
+ * rather than filled with zeros, and extended attributes, ownership, permissions and times are
+ * carried over (see FileMetadata). Each file is written under a temporary name and renamed to its
+ * target once it is complete.
+ */
+class CopyJournal;
+class Xxh64;
+
+class CopyEngine {
+public:
+    CopyEngine();
+    ~CopyEngine();
+
+    /**
+     * @brief Copies a regular file, either right away or, if it is small, on the worker pool.
+     *
+     * Blocks while the queue of the worker pool is full. The target must not exist yet, unless
+     * the job is being resumed.
+     * @return False if the copy was canceled or a copy has failed; see errorMessage().
+     */
+    bool copyFile(const QString& fromPath, const QString& toPath);
+
+    /**
+     * @brief Counts a file that an interrupted run of the job had copied already.
+     */
+    void skipFile(qint64 size);
+
+    /**
+     * @brief Records the progress of the copy in the journal, so that it can be resumed.
+     *
+     * With a journal, partially written files are kept under a temporary name next to their target
+     * when the copy fails; they are removed when it is canceled.
+     */
+    void setJournal(CopyJournal* journal);
+
+    /**
+     * @brief Checks every copy by reading it back from the disk and comparing its XXH64 hash with that of the source.
+     *
+     * The source is hashed while it is copied, so it is only read once.
+     */
+    void setVerify(bool verify);
+
+    /**
+     * @brief Waits until the files queued on the worker pool have been copied.
+     * @return False if the copy was canceled or a copy has failed; see errorMessage().
+     */
+    bool waitForDone();
+
+    /**
+     * @brief Stops copying as soon as possible. Thread-safe.
+     */
+    void cancel();
+
+    bool isCanceled() const;
+
+    /**
+     * @brief Holds the copy at the next chunk until it is unpaused or canceled. Thread-safe.
+     */
+    void setPaused(bool paused);
+
+    /**
+     * @brief The number of bytes copied so far. Thread-safe, and cheap enough to be polled.
+     */
+    qint64 copiedBytes() const;
+
+    /**
+     * @brief The number of files copied completely so far. Thread-safe.
+     */
+    int copiedFiles() const;
+
+    QString errorMessage() const;
+
+private:
+    friend class CopyFileJob;
+
+    enum Status { Copied, Unsupported, Failed };
+
+    // The state of copying one file; each method continues at offset
+    struct Transfer {
+        QString fromPath;
+        int fromFd;
+        int toFd;
+        qint64 size;
+        qint64 end;        ///< Where the current method stops; less than the size between the holes of a sparse file.
+        qint64 offset;
+        qint64 checkpoint; ///< The offset last recorded in the journal.
+        Xxh64* hash;       ///< The hash of the source up to offset when verifying, otherwise nullptr.
+    };
+
+    bool copyFileNow(const QString& fromPath, const QString& toPath);
+    Status cloneFile(Transfer& transfer);
+    Status copyFileRange(Transfer& transfer);
+    Status sendFile(Transfer& transfer);
+    Status copyBuffered(Transfer& transfer);
+    Status copyRange(Transfer& transfer);
+    Status copySparse(Transfer& transfer);
+    void skipHole(Transfer& transfer, qint64 length);
+    Status verifyTarget(Transfer& transfer, const QByteArray& toName);
+    qint64 hashFile(int fd, qint64 length, Xxh64& hash);
+    static void prefetch(int fd, qint64 offset);
+    bool mayContinue();
+    void advance(Transfer& transfer, qint64 bytes);
+    void addCopiedBytes(qint64 bytes);
+    void setError(const QString& errorMessage);
+
+    CopyJournal* journal;
+    bool verify;
+    QThreadPool workerPool;
+    QSemaphore queueSlots; ///< Bounds the number of small files waiting for a worker.
+    std::atomic<bool> canceled;
+    std::atomic<bool> paused;
+    QMutex pauseMutex; ///< Guards changes to canceled and paused, so that waiting threads notice them.
+    QWaitCondition unpaused;
+    std::atomic<bool> failed;
+    std::atomic<qint64> copied;
+    std::atomic<int> copiedFileCount;
+    mutable QMutex errorMutex;
+    QString error; ///< The first error that occurred.
+};
+
+#endif // COPYENGINE_H
@@ -0,0 +1,257 @@
+#include "CopyJournal.h"
+#include <QAtomicInt>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QStandardPaths>
+#include <QDebug>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+const QByteArray magic = "Filer copy journal 1";
+
+// Completed files are synced and recorded in groups of this many files or bytes, whichever comes first
+const int groupFileCount = 1000;
+const qint64 groupSize = 64 * 1024 * 1024;
+
+// Journals of jobs that were never resumed are removed after this many days
+const int expiryDays = 14;
+
+// Jobs run in Filer itself, several at a time, so the process id alone does not tell them apart
+QAtomicInt jobCounter;
+
+}
+
+CopyJournal::CopyJournal() : resumed(false), pendingSize(0) {
+}
+
+CopyJournal::~CopyJournal() {
+    if (file.isOpen()) {
+        file.close();
+    }
+}
+
+QString CopyJournal::jobsDirectory() {
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + "/Filer/jobs";
+}
+
+bool CopyJournal::create(const QString& operation, const QStringList& fromPaths, const QString& toPath) {
+    operationName = operation;
+    target = QFileInfo(toPath).absoluteFilePath();
+    sources.clear();
+    for (const QString& fromPath : fromPaths) {
+        sources.append(QFileInfo(fromPath).absoluteFilePath());
+    }
+    id = QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss") + "-" + QString::number(QCoreApplication::applicationPid())
+         + "-" + QString::number(jobCounter.fetchAndAddRelaxed(1));
+
+    if (!QDir().mkpath(jobsDirectory())) {
+        qWarning() << "Cannot create" << jobsDirectory() << "; the job cannot be resumed";
+        return false;
+    }
+    removeExpired();
+    file.setFileName(jobsDirectory() + "/" + id);
+    // Never take over the journal of another job, e.g., one that failed and may still be resumed
+    if (!file.open(QIODevice::WriteOnly | QIODevice::NewOnly | QIODevice::Unbuffered)) {
+        qWarning() << "Cannot create" << file.fileName() << "; the job cannot be resumed";
+        // remove() must not delete a file that is not ours
+        file.setFileName(QString());
+        return false;
+    }
+
+    QByteArray header = magic + "\n";
+    header += "operation\t" + operation.toUtf8() + "\n";
+    header += "target\t" + encode(target) + "\n";
+    for (const QString& source : sources) {
+        header += "source\t" + encode(source) + "\n";
+    }
+    append(header);
+    return true;
+}
+
+bool CopyJournal::open(const QString& jobId) {
+    id = jobId;
+    file.setFileName(jobsDirectory() + "/" + QFileInfo(jobId).fileName());
+    QFile reader(file.fileName());
+    if (!reader.open(QIODevice::ReadOnly)) {
+        qWarning() << "Cannot open the journal" << file.fileName();
+        return false;
+    }
+    const QList<QByteArray> lines = reader.readAll().split('\n');
+    reader.close();
+    if (lines.isEmpty() || lines.first() != magic) {
+        qWarning() << file.fileName() << "is not a journal";
+        return false;
+    }
+
+    // A line cut short by a crash has fewer fields or no newline; it is the last one and is ignored
+    for (int i = 1; i < lines.size() - 1; i++) {
+        const QList<QByteArray> fields = lines.at(i).split('\t');
+        const QByteArray& key = fields.first();
+        if (key == "operation" && fields.size() == 2) {
+            operationName = QString::fromUtf8(fields.at(1));
+        } else if (key == "target" && fields.size() == 2) {
+            target = decode(fields.at(1));
+        } else if (key == "source" && fields.size() == 2) {
+            sources.append(decode(fields.at(1)));
+        } else if (key == "done" && fields.size() == 2) {
+            QString path = decode(fields.at(1));
+            completedPaths.insert(path);
+            offsets.remove(path);
+        } else if (key == "offset" && fields.size() == 3) {
+            offsets.insert(decode(fields.at(1)), fields.at(2).toLongLong());
+        }
+    }
+
+    if (operationName.isEmpty() || target.isEmpty() || sources.isEmpty()) {
+        qWarning() << file.fileName() << "is incomplete";
+        return false;
+    }
+    // A line cut short by a crash must not be continued by the next one
+    if (!lines.last().isEmpty()) {
+        reader.resize(reader.size() - lines.last().size());
+    }
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Unbuffered)) {
+        qWarning() << "Cannot open the journal" << file.fileName();
+        return false;
+    }
+    resumed = true;
+    return true;
+}
+
+// Nothing resumes a job on its own, so a journal that was left behind by a failed job would stay forever
+void CopyJournal::removeExpired() {
+    const QDateTime expiry = QDateTime::currentDateTime().addDays(-expiryDays);
+    const QFileInfoList journals = QDir(jobsDirectory()).entryInfoList(QDir::Files);
+    for (const QFileInfo& journal : journals) {
+        if (journal.lastModified() < expiry) {
+            QFile::remove(journal.absoluteFilePath());
+        }
+    }
+}
+
+QString CopyJournal::jobId() const {
+    return id;
+}
+
+QString CopyJournal::operation() const {
+    return operationName;
+}
+
+QStringList CopyJournal::fromPaths() const {
+    return sources;
+}
+
+QString CopyJournal::toPath() const {
+    return target;
+}
+
+bool CopyJournal::isResumed() const {
+    return resumed;
+}
+
+bool CopyJournal::isCompleted(const QString& fromPath) const {
+    return completedPaths.contains(fromPath);
+}
+
+qint64 CopyJournal::resumeOffset(const QString& fromPath) const {
+    return offsets.value(fromPath);
+}
+
+void CopyJournal::recordCompleted(const QString& fromPath, const QString& toPath, qint64 size) {
+    {
+        QMutexLocker locker(&mutex);
+        pending.append({ fromPath, toPath });
+        pendingSize += size;
+        if (pending.size() < groupFileCount && pendingSize < groupSize) {
+            return;
+        }
+    }
+    flush();
+}
+
+bool CopyJournal::flush() {
+    // Sync without holding the lock, so that the other workers can go on copying meanwhile
+    QVector<Completed> completed;
+    {
+        QMutexLocker locker(&mutex);
+        completed.swap(pending);
+        pendingSize = 0;
+    }
+    if (completed.isEmpty()) {
+        return true;
+    }
+
+    // A resume after the disk was unplugged must not skip a target that has the right size but not the right contents
+    if (!sync(completed)) {
+        qWarning() << "Cannot sync the copies to" << target << "; a resume will copy them again";
+        return false;
+    }
+    QByteArray lines;
+    for (const Completed& file : completed) {
+        lines += "done\t" + encode(file.fromPath) + "\n";
+    }
+    append(lines);
+    return true;
+}
+
+void CopyJournal::recordOffset(const QString& fromPath, qint64 offset) {
+    append("offset\t" + encode(fromPath) + "\t" + QByteArray::number(offset) + "\n");
+}
+
+void CopyJournal::remove() {
+    QMutexLocker locker(&mutex);
+    if (!file.fileName().isEmpty()) {
+        file.remove();
+    }
+}
+
+// Writes the copies to disk, all at once if the system can sync a whole file system
+bool CopyJournal::sync(const QVector<Completed>& completed) const {
+#if defined(__linux__)
+    int directoryFd = ::open(QFile::encodeName(target).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (directoryFd >= 0) {
+        int result = syncfs(directoryFd);
+        ::close(directoryFd);
+        if (result == 0) {
+            return true;
+        }
+    }
+#endif
+    for (const Completed& file : completed) {
+        int fd = ::open(QFile::encodeName(file.toPath).constData(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+        if (fd < 0) {
+            return false;
+        }
+        int result = fsync(fd);
+        ::close(fd);
+        if (result != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void CopyJournal::append(const QByteArray& line) {
+    QMutexLocker locker(&mutex);
+    if (!file.isOpen()) {
+        return;
+    }
+    // Unbuffered, so that every line reaches the kernel right away and survives a crash of this process
+    if (file.write(line) != line.size()) {
+        qWarning() << "Cannot write to the journal" << file.fileName();
+    }
+}
+
+// Paths may contain tabs and newlines
+QByteArray CopyJournal::encode(const QString& path) {
+    return QFile::encodeName(path).toPercentEncoding("/");
+}
+
+QString CopyJournal::decode(const QByteArray& data) {
+    return QFile::decodeName(QByteArray::fromPercentEncoding(data));
+}
@@ -0,0 +1,122 @@
+#ifndef COPYJOURNAL_H
+#define COPYJOURNAL_H
+
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+/**
+ * @brief An on-disk record of a copy or move job, so that an interrupted job can be resumed.
+ *
+ * Each job has a file in ~/.cache/Filer/jobs that names the operation, the source paths and the
+ * target directory, followed by a line for every file that has been copied completely and, for large
+ * files, the offset up to which the copy has been written. Only what is on the disk is recorded. The file is only ever
+ * appended to, so that a crash can at most lose the last line. It is removed when the job completes
+ * or is canceled, and otherwise expires after two weeks.
+ *
+ * `fileoperation --resume <job>` reads it back and skips what has been copied already.
+ */
+class CopyJournal {
+public:
+    CopyJournal();
+    ~CopyJournal();
+
+    /**
+     * @brief The directory that holds the journals.
+     */
+    static QString jobsDirectory();
+
+    /**
+     * @brief Starts the journal of a new job.
+     * @param operation "copy" or "move".
+     * @return False if the journal cannot be written; the job can still run, but not be resumed.
+     */
+    bool create(const QString& operation, const QStringList& fromPaths, const QString& toPath);
+
+    /**
+     * @brief Reads the journal of an interrupted job and continues it.
+     * @param jobId The name of the job as given by jobId().
+     */
+    bool open(const QString& jobId);
+
+    QString jobId() const;
+    QString operation() const;
+    QStringList fromPaths() const;
+    QString toPath() const;
+
+    /**
+     * @brief True if the job was started earlier and is being resumed.
+     */
+    bool isResumed() const;
+
+    /**
+     * @brief True if the file was copied completely before the job was interrupted.
+     */
+    bool isCompleted(const QString& fromPath) const;
+
+    /**
+     * @brief The number of bytes of the file that had safely been written before the job was interrupted.
+     */
+    qint64 resumeOffset(const QString& fromPath) const;
+
+    /**
+     * @brief Records that a file has been copied completely, once it is on the disk. Thread-safe.
+     *
+     * Syncing each file on its own would serialize the copying of small files, so files are recorded
+     * in groups: once enough of them have accumulated, the file system of the target is synced and
+     * then they are all recorded at once.
+     * @param toPath The copy, in case the file system cannot be synced as a whole.
+     * @param size The size of the copy, which counts towards the size of the group.
+     */
+    void recordCompleted(const QString& fromPath, const QString& toPath, qint64 size);
+
+    /**
+     * @brief Syncs and records the files that have been copied but not recorded yet. Thread-safe.
+     * @return False if the files could not be synced; they are not recorded then.
+     */
+    bool flush();
+
+    /**
+     * @brief Records that the first bytes of a file have been written to disk. Thread-safe.
+     */
+    void recordOffset(const QString& fromPath, qint64 offset);
+
+    /**
+     * @brief Removes the journal once the job is complete.
+     */
+    void remove();
+
+private:
+    // A file that has been copied but is not recorded yet
+    struct Completed {
+        QString fromPath;
+        QString toPath;
+    };
+
+    static void removeExpired();
+    bool sync(const QVector<Completed>& completed) const;
+    void append(const QByteArray& line);
+    static QByteArray encode(const QString& path);
+    static QString decode(const QByteArray& data);
+
+    QString id;
+    QString operationName;
+    QStringList sources;
+    QString target;
+    bool resumed;
+
+    // What the interrupted run had done
+    QSet<QString> completedPaths;
+    QHash<QString, qint64> offsets;
+
+    QMutex mutex; ///< Guards file and the files that are not recorded yet.
+    QFile file;
+    QVector<Completed> pending;
+    qint64 pendingSize;
+};
+
+#endif // COPYJOURNAL_H
@@ -3,7 +3,8 @@
 #include "CopyThread.h"
 #include <QDebug>
 
-CopyManager::CopyManager(QObject* parent) : QObject(parent), progressDialog(nullptr), copyThread(nullptr) {
+CopyManager::CopyManager(QObject* parent)
+        : QObject(parent), progressDialog(nullptr), copyThread(nullptr), outcome(Running), threadFinished(false) {
 
 }
 
@@ -11,7 +12,8 @@ CopyManager::~CopyManager() {
 
 }
 
-void CopyManager::copyWithProgress(const QStringList& fromPaths, const QString& toPath) {
+void CopyManager::copyWithProgress(const QStringList& fromPaths, const QString& toPath, CopyJournal* journal,
+                                   bool verify) {
     if (copyThread && copyThread->isRunning()) {
         qDebug() << "Another copy operation is already in progress.";
         return;
@@ -21,11 +23,19 @@ void CopyManager::copyWithProgress(const QStringList& fromPaths, const QString&
     progressDialog->setCopyPaths(fromPaths, toPath);
 
     copyThread = new CopyThread(fromPaths, toPath); // Note: No need to specify parent, as it's handled internally by Qt.
+    copyThread->setJournal(journal);
+    copyThread->setVerify(verify);
+    outcome = Running;
+    threadFinished = false;
+    // The thread has ended by the time this reaches the main thread
+    connect(copyThread, &QThread::finished, copyThread, &QObject::deleteLater);
+    connect(copyThread, &QThread::finished, this, &CopyManager::onThreadFinished);
 
     // Inform the progress dialog when the operation is finished or canceled
     connect(copyThread, &CopyThread::copyFinished, progressDialog, &CopyProgressDialog::onCopyFinished);
     connect(copyThread, &CopyThread::error, progressDialog, &CopyProgressDialog::onErrorOccurred);
     connect(copyThread, &CopyThread::progress, progressDialog, &CopyProgressDialog::onCopyProgress);
+    connect(copyThread, &CopyThread::progressChanged, progressDialog, &CopyProgressDialog::onProgressChanged);
 
     // Inform the copy thread when the user wants to cancel the operation
     connect(progressDialog, &CopyProgressDialog::cancelCopyRequested, copyThread, &CopyThread::cancelCopyRequested);
@@ -41,6 +51,18 @@ void CopyManager::copyWithProgress(const QStringList& fromPaths, const QString&
     progressDialog->show();
 }
 
+void CopyManager::setPaused(bool paused) {
+    if (copyThread) {
+        copyThread->setPaused(paused);
+    }
+}
+
+void CopyManager::cancel() {
+    if (copyThread) {
+        emit copyThread->cancelCopyRequested();
+    }
+}
+
 void CopyManager::onCopyProgress(int progress) {
     // You can perform actions related to progress, if needed.
     qDebug() << "Copy progress: " << progress << "%";
@@ -48,41 +70,61 @@ void CopyManager::onCopyProgress(int progress) {
 
 void CopyManager::onCopyFinished() {
     qDebug() << "CopyManager: Copy operation completed.";
-    emit copyFinished();
-    if (progressDialog) {
-        progressDialog->hide();
-        delete progressDialog;
-        progressDialog = nullptr;
-    }
-    if (copyThread) {
-        copyThread = nullptr;
+    if (outcome != Running) {
+        // Canceled just as the copy was complete
+        return;
     }
+    outcome = Succeeded;
+    copyThread = nullptr;
+    emit copyFinished();
+    hideProgressDialog();
 }
 
 void CopyManager::onCancelCopy() {
     qDebug() << "CopyManager: Copy operation canceled.";
-    emit copyCanceled();
-    if (copyThread && copyThread->isRunning()) {
-        copyThread->quit();
-        copyThread->wait();
-        copyThread = nullptr;
-    }
-    if (progressDialog) {
-        progressDialog->hide();
-        delete progressDialog;
-    }
+    endCopy(Canceled, QString());
 }
 
 void CopyManager::onErrorOccurred(const QString& errorMessage) {
     qDebug() << "CopyManager:" << errorMessage;
-    emit errorOccured(errorMessage);
-    if (copyThread && copyThread->isRunning()) {
-        copyThread->quit();
-        copyThread->wait();
-        copyThread = nullptr;
+    endCopy(Failed, errorMessage);
+}
+
+void CopyManager::onThreadFinished() {
+    threadFinished = true;
+    copyThread = nullptr;
+    reportOutcome();
+}
+
+// A canceled move is rolled back, which must not start before the thread and its workers have stopped
+// writing into the targets. Waiting for them here would freeze every window of Filer, e.g., while a large
+// file is being synced or verified, so the outcome is only reported once the thread has finished
+void CopyManager::endCopy(Outcome outcome, const QString& errorMessage) {
+    if (this->outcome != Running) {
+        // E.g., the copy failed while it was being canceled; the first outcome counts
+        return;
+    }
+    this->outcome = outcome;
+    this->errorMessage = errorMessage;
+    copyThread = nullptr;
+    hideProgressDialog();
+    if (threadFinished) {
+        reportOutcome();
+    }
+}
+
+void CopyManager::reportOutcome() {
+    if (outcome == Canceled) {
+        emit copyCanceled();
+    } else if (outcome == Failed) {
+        emit errorOccured(errorMessage);
     }
+}
+
+void CopyManager::hideProgressDialog() {
     if (progressDialog) {
         progressDialog->hide();
         delete progressDialog;
+        progressDialog = nullptr;
     }
-}
\ No newline at end of file
+}
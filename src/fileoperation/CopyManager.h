@@ -6,6 +6,7 @@
 
 class CopyProgressDialog;
 class CopyThread;
+class CopyJournal;
 
 class CopyManager : public QObject {
     Q_OBJECT
@@ -14,7 +15,18 @@ public:
     explicit CopyManager(QObject* parent = nullptr);
     ~CopyManager();
 
-    void copyWithProgress(const QStringList& fromPaths, const QString& toPath);
+    void copyWithProgress(const QStringList& fromPaths, const QString& toPath, CopyJournal* journal = nullptr,
+                          bool verify = false);
+
+    /**
+     * @brief Holds the running copy, or lets it continue.
+     */
+    void setPaused(bool paused);
+
+    /**
+     * @brief Cancels the running copy as if the user had clicked Cancel.
+     */
+    void cancel();
 
     signals:
         void copyFinished();
@@ -26,10 +38,20 @@ private slots:
     void onCopyFinished();
     void onCancelCopy();
     void onErrorOccurred(const QString& errorMessage);
+    void onThreadFinished();
 
 private:
+    enum Outcome { Running, Succeeded, Canceled, Failed };
+
+    void endCopy(Outcome outcome, const QString& errorMessage);
+    void reportOutcome();
+    void hideProgressDialog();
+
     CopyProgressDialog* progressDialog;
     CopyThread* copyThread;
+    Outcome outcome;
+    QString errorMessage; ///< Why the copy failed.
+    bool threadFinished;
 };
 
 #endif // COPYMANAGER_H
\ No newline at end of file
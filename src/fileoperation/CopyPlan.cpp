@@ -0,0 +1,226 @@
+#include "CopyPlan.h"
+#include <QCoreApplication>
+#include <QFile>
+#include <QMutexLocker>
+#include <QDebug>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace {
+
+// Number of entries the scan collects before it makes them visible to the copier
+const int batchSize = 256;
+
+QString tr(const char* text)
+{
+    return QCoreApplication::translate("CopyPlan", text);
+}
+
+}
+
+CopyPlan::CopyPlan(const QStringList& fromPaths)
+        : fromPaths(fromPaths), canceled(false), size(0), fileCount(0), finished(false) {
+}
+
+CopyPlan::~CopyPlan() {
+    cancel();
+    if (scanThread.joinable()) {
+        scanThread.join();
+    }
+}
+
+void CopyPlan::start() {
+    scanThread = std::thread([this]() { scan(); });
+}
+
+void CopyPlan::cancel() {
+    canceled = true;
+}
+
+bool CopyPlan::waitForEntry(int index) {
+    QMutexLocker locker(&mutex);
+    while (index >= entries.size() && !finished) {
+        entriesAdded.wait(&mutex);
+    }
+    return index < entries.size();
+}
+
+CopyPlan::Entry CopyPlan::entry(int index) const {
+    QMutexLocker locker(&mutex);
+    return entries.at(index);
+}
+
+QString CopyPlan::sourcePath(const Entry& entry) const {
+    return fromPaths.at(entry.root) + relativePath(entry);
+}
+
+QString CopyPlan::relativePath(const Entry& entry) const {
+    QMutexLocker locker(&mutex);
+    return QFile::decodeName(paths.mid(entry.pathOffset, entry.pathLength));
+}
+
+QString CopyPlan::linkTarget(const Entry& entry) const {
+    QMutexLocker locker(&mutex);
+    return QFile::decodeName(paths.mid(entry.linkOffset, entry.linkLength));
+}
+
+qint64 CopyPlan::totalSize() const {
+    return size;
+}
+
+int CopyPlan::totalFiles() const {
+    return fileCount;
+}
+
+bool CopyPlan::isFinished() const {
+    QMutexLocker locker(&mutex);
+    return finished;
+}
+
+QString CopyPlan::errorMessage() const {
+    QMutexLocker locker(&mutex);
+    return error;
+}
+
+void CopyPlan::scan() {
+    for (int root = 0; root < fromPaths.size() && !canceled; root++) {
+        QByteArray rootPath = QFile::encodeName(fromPaths.at(root));
+        struct stat st;
+        if (fstatat(AT_FDCWD, rootPath.constData(), &st, AT_SYMLINK_NOFOLLOW) != 0) {
+            setError(tr("Cannot read %1: %2").arg(fromPaths.at(root), QString::fromLocal8Bit(strerror(errno))));
+            break;
+        }
+
+        QByteArray linkTarget;
+        if (S_ISLNK(st.st_mode)) {
+            linkTarget.resize(st.st_size > 0 ? st.st_size : PATH_MAX);
+            ssize_t length = readlinkat(AT_FDCWD, rootPath.constData(), linkTarget.data(), linkTarget.size());
+            linkTarget.resize(length > 0 ? length : 0);
+        }
+        addEntry(root, QByteArray(), linkTarget, st.st_mode, st.st_size);
+
+        if (S_ISDIR(st.st_mode)) {
+            int fd = openat(AT_FDCWD, rootPath.constData(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+            if (fd < 0) {
+                setError(tr("Cannot read %1: %2").arg(fromPaths.at(root), QString::fromLocal8Bit(strerror(errno))));
+                break;
+            }
+            scanDirectory(root, fd, QByteArray());
+        }
+    }
+
+    publish();
+    QMutexLocker locker(&mutex);
+    finished = true;
+    entriesAdded.wakeAll();
+}
+
+// Takes ownership of directoryFd
+void CopyPlan::scanDirectory(int root, int directoryFd, const QByteArray& relativePath) {
+    DIR* dir = fdopendir(directoryFd);
+    if (!dir) {
+        ::close(directoryFd);
+        setError(tr("Cannot read %1: %2").arg(fromPaths.at(root) + QFile::decodeName(relativePath),
+                                              QString::fromLocal8Bit(strerror(errno))));
+        return;
+    }
+
+    while (!canceled) {
+        errno = 0;
+        struct dirent* dirEntry = readdir(dir);
+        if (!dirEntry) {
+            if (errno != 0) {
+                setError(tr("Cannot read %1: %2").arg(fromPaths.at(root) + QFile::decodeName(relativePath),
+                                                      QString::fromLocal8Bit(strerror(errno))));
+            }
+            break;
+        }
+        const char* name = dirEntry->d_name;
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+            continue;
+        }
+
+        QByteArray entryPath = relativePath + '/' + name;
+        struct stat st;
+        if (fstatat(dirfd(dir), name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+            setError(tr("Cannot read %1: %2").arg(fromPaths.at(root) + QFile::decodeName(entryPath),
+                                                  QString::fromLocal8Bit(strerror(errno))));
+            break;
+        }
+
+        QByteArray linkTarget;
+        if (S_ISLNK(st.st_mode)) {
+            linkTarget.resize(st.st_size > 0 ? st.st_size : PATH_MAX);
+            ssize_t length = readlinkat(dirfd(dir), name, linkTarget.data(), linkTarget.size());
+            linkTarget.resize(length > 0 ? length : 0);
+        }
+        addEntry(root, entryPath, linkTarget, st.st_mode, st.st_size);
+
+        if (S_ISDIR(st.st_mode)) {
+            int fd = openat(dirfd(dir), name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+            if (fd < 0) {
+                setError(tr("Cannot read %1: %2").arg(fromPaths.at(root) + QFile::decodeName(entryPath),
+                                                      QString::fromLocal8Bit(strerror(errno))));
+                break;
+            }
+            scanDirectory(root, fd, entryPath);
+        }
+    }
+
+    closedir(dir);
+}
+
+void CopyPlan::addEntry(int root, const QByteArray& relativePath, const QByteArray& linkTarget, quint32 mode,
+                        qint64 entrySize) {
+    // Offsets are relative to pendingPaths until the entry is published
+    Entry entry;
+    entry.root = root;
+    entry.pathOffset = pendingPaths.size();
+    entry.pathLength = relativePath.size();
+    pendingPaths.append(relativePath);
+    entry.linkOffset = pendingPaths.size();
+    entry.linkLength = linkTarget.size();
+    pendingPaths.append(linkTarget);
+    entry.mode = mode;
+    entry.size = S_ISREG(mode) ? entrySize : 0;
+    pendingEntries.append(entry);
+    size += entry.size;
+    if (S_ISREG(mode)) {
+        fileCount++;
+    }
+
+    if (pendingEntries.size() >= batchSize) {
+        publish();
+    }
+}
+
+void CopyPlan::publish() {
+    if (pendingEntries.isEmpty()) {
+        return;
+    }
+    QMutexLocker locker(&mutex);
+    const int base = paths.size();
+    for (Entry& entry : pendingEntries) {
+        entry.pathOffset += base;
+        entry.linkOffset += base;
+    }
+    entries.append(pendingEntries);
+    paths.append(pendingPaths);
+    pendingEntries.clear();
+    pendingPaths.clear();
+    entriesAdded.wakeAll();
+}
+
+void CopyPlan::setError(const QString& errorMessage) {
+    qDebug() << "CopyPlan:" << errorMessage;
+    QMutexLocker locker(&mutex);
+    if (error.isEmpty()) {
+        error = errorMessage;
+    }
+    canceled = true;
+}
@@ -0,0 +1,98 @@
+#ifndef COPYPLAN_H
+#define COPYPLAN_H
+
+#include <QByteArray>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QWaitCondition>
+#include <atomic>
+#include <thread>
+
+/**
+ * @brief The entries of the source trees of a copy operation, found in a single pass.
+ *
+ * Each directory is read once with readdir() (getdents64 on Linux) on a file descriptor opened
+ * relative to its parent, and each entry is examined once with fstatat(); symlink targets are read
+ * with readlinkat(). The entries are stored in a flat array with all paths in a single buffer, in
+ * an order in which a directory always comes before its contents.
+ *
+ * The scan runs on a thread of its own so that copying can start before it is complete; waitForEntry()
+ * blocks until the entry with the given index has been found.
+ */
+class CopyPlan {
+public:
+    struct Entry {
+        int root;         ///< Index of the source path the entry belongs to.
+        int pathOffset;   ///< Start of the path relative to the source path in the path buffer; empty for the source path itself.
+        int pathLength;
+        int linkOffset;   ///< Start of the symlink target in the path buffer.
+        int linkLength;
+        quint32 mode;     ///< st_mode
+        qint64 size;      ///< st_size
+    };
+
+    explicit CopyPlan(const QStringList& fromPaths);
+    ~CopyPlan();
+
+    /**
+     * @brief Starts scanning the source trees in the background.
+     */
+    void start();
+
+    /**
+     * @brief Stops scanning as soon as possible. Thread-safe.
+     */
+    void cancel();
+
+    /**
+     * @brief Waits until the entry with the given index has been found.
+     * @return False if the scan ended with fewer entries.
+     */
+    bool waitForEntry(int index);
+
+    Entry entry(int index) const;
+    QString sourcePath(const Entry& entry) const;
+    QString relativePath(const Entry& entry) const;
+    QString linkTarget(const Entry& entry) const;
+
+    /**
+     * @brief The total size of the regular files found so far. Thread-safe.
+     */
+    qint64 totalSize() const;
+
+    /**
+     * @brief The number of regular files found so far. Thread-safe.
+     */
+    int totalFiles() const;
+
+    bool isFinished() const;
+    QString errorMessage() const;
+
+private:
+    void scan();
+    void scanDirectory(int root, int directoryFd, const QByteArray& relativePath);
+    void addEntry(int root, const QByteArray& relativePath, const QByteArray& linkTarget, quint32 mode, qint64 entrySize);
+    void publish();
+    void setError(const QString& errorMessage);
+
+    QStringList fromPaths;
+    std::thread scanThread;
+    std::atomic<bool> canceled;
+    std::atomic<qint64> size;
+    std::atomic<int> fileCount;
+
+    // Found by the scan but not yet visible to waitForEntry(), so that we do not lock for every entry
+    QVector<Entry> pendingEntries;
+    QByteArray pendingPaths;
+
+    mutable QMutex mutex; ///< Guards the members below.
+    QWaitCondition entriesAdded;
+    QVector<Entry> entries;
+    QByteArray paths;
+    bool finished;
+    QString error;
+};
+
+#endif // COPYPLAN_H
@@ -4,13 +4,20 @@
 #include <QPushButton>
 #include <QVBoxLayout>
 #include <QDebug>
+#include <QFileInfo>
+#include <QLocale>
 
 
 CopyProgressDialog::CopyProgressDialog(QWidget* parent) : QDialog(parent), fromLabel(nullptr), toLabel(nullptr),
-                                                          progressBar(nullptr), cancelButton(nullptr) {
+                                                          statusLabel(nullptr), currentFileLabel(nullptr),
+                                                          throughputLabel(nullptr), progressBar(nullptr),
+                                                          cancelButton(nullptr) {
 
     fromLabel = new QLabel(this);
     toLabel = new QLabel(this);
+    statusLabel = new QLabel(this);
+    currentFileLabel = new QLabel(this);
+    throughputLabel = new QLabel(this);
     progressBar = new QProgressBar(this);
     cancelButton = new QPushButton("Cancel", this);
 
@@ -21,6 +28,9 @@ CopyProgressDialog::CopyProgressDialog(QWidget* parent) : QDialog(parent), fromL
     mainLayout->addWidget(fromLabel);
     mainLayout->addWidget(toLabel);
     mainLayout->addWidget(progressBar);
+    mainLayout->addWidget(statusLabel);
+    mainLayout->addWidget(currentFileLabel);
+    mainLayout->addWidget(throughputLabel);
 
     // Layout for the cancel button in the bottom right corner
     QHBoxLayout* buttonLayout = new QHBoxLayout;
@@ -34,7 +44,7 @@ CopyProgressDialog::CopyProgressDialog(QWidget* parent) : QDialog(parent), fromL
     mainLayout->addLayout(buttonLayout);
 
     setWindowTitle("Copying...");
-    setFixedSize(400, 150);
+    setFixedSize(400, 220);
 }
 
 CopyProgressDialog::~CopyProgressDialog() {
@@ -51,6 +61,43 @@ void CopyProgressDialog::onCopyProgress(int progress) {
     progressBar->setValue(progress);
 }
 
+void CopyProgressDialog::onProgressChanged(const CopyProgress& progress) {
+    QLocale locale;
+
+    if (progress.totalsKnown) {
+        statusLabel->setText(tr("%1 of %2, %3 of %4 files")
+                                     .arg(locale.formattedDataSize(progress.bytesDone),
+                                          locale.formattedDataSize(progress.bytesTotal))
+                                     .arg(progress.filesDone)
+                                     .arg(progress.filesTotal));
+    } else {
+        statusLabel->setText(tr("%1 of at least %2, %3 of at least %4 files")
+                                     .arg(locale.formattedDataSize(progress.bytesDone),
+                                          locale.formattedDataSize(progress.bytesTotal))
+                                     .arg(progress.filesDone)
+                                     .arg(progress.filesTotal));
+    }
+
+    QString fileName = QFileInfo(progress.currentFile).fileName();
+    currentFileLabel->setText(currentFileLabel->fontMetrics().elidedText(fileName, Qt::ElideMiddle,
+                                                                         currentFileLabel->width()));
+
+    QString throughput = tr("%1/s (average %2/s)")
+            .arg(locale.formattedDataSize(static_cast<qint64>(progress.currentThroughput)),
+                 locale.formattedDataSize(static_cast<qint64>(progress.averageThroughput)));
+    QString remaining;
+    if (progress.secondsRemaining < 0) {
+        remaining = tr("Calculating time remaining...");
+    } else if (progress.secondsRemaining < 60) {
+        remaining = tr("%n second(s) remaining", nullptr, static_cast<int>(progress.secondsRemaining));
+    } else if (progress.secondsRemaining < 3600) {
+        remaining = tr("About %n minute(s) remaining", nullptr, static_cast<int>(progress.secondsRemaining / 60));
+    } else {
+        remaining = tr("About %n hour(s) remaining", nullptr, static_cast<int>(progress.secondsRemaining / 3600));
+    }
+    throughputLabel->setText(throughput + " - " + remaining);
+}
+
 void CopyProgressDialog::onCopyFinished() {
     this->close();
 }
@@ -6,6 +6,7 @@
 #include <QLabel>
 #include <QPushButton>
 #include <QKeyEvent>
+#include "ProgressAggregator.h"
 
 class CopyProgressDialog : public QDialog {
     Q_OBJECT
@@ -19,6 +20,7 @@ public:
 
 public slots:
     void onCopyProgress(int progress);
+    void onProgressChanged(const CopyProgress& progress);
     void onCopyFinished();
     void onCancelCopy();
     void onErrorOccurred(const QString& errorMessage);
@@ -33,6 +35,9 @@ protected:
 private:
     QLabel* fromLabel;
     QLabel* toLabel;
+    QLabel* statusLabel;
+    QLabel* currentFileLabel;
+    QLabel* throughputLabel;
     QProgressBar* progressBar;
     QPushButton* cancelButton;
     QStringList fromFilePaths;
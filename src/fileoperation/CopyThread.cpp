@@ -1,19 +1,38 @@
 #include "CopyThread.h"
+#include "FileMetadata.h"
 #include <QFile>
 #include <QDir>
+#include <QPair>
+#include <QVector>
 #include <QDebug>
-#include <QDirIterator>
 #include <QProcess>
+#include <sys/stat.h>
 
 CopyThread::CopyThread(const QStringList& fromPaths, const QString& toPath, QObject* parent)
-        : QThread(parent), fromPaths(fromPaths), toPath(toPath) {
+        : QThread(parent), fromPaths(fromPaths), toPath(toPath), journal(nullptr), plan(fromPaths),
+          lastPercentage(-1) {
     connect(this, &CopyThread::cancelCopyRequested, this, &CopyThread::requestInterruption);
+    // The engine may be busy in a system call on another thread, so tell it directly
+    connect(this, &CopyThread::cancelCopyRequested, this, [this]() {
+        plan.cancel();
+        engine.cancel();
+    }, Qt::DirectConnection);
+
+    // About 30 updates per second are plenty for the eye; the timer lives on our (the main) thread,
+    // so these connections are queued from the copy thread
+    progressTimer.setInterval(33);
+    connect(&progressTimer, &QTimer::timeout, this, &CopyThread::publishProgress);
+    connect(this, &QThread::started, this, [this]() {
+        aggregator.start();
+        progressTimer.start();
+    });
+    connect(this, &QThread::finished, this, [this]() {
+        progressTimer.stop();
+        publishProgress();
+    });
 }
 
 void CopyThread::run() {
-    qint64 totalSize = calculateTotalSize();
-    qint64 copiedSize = 0;
-
     for (const QString& fromPath : fromPaths) {
         QFileInfo fromInfo(fromPath);
         QFileInfo toInfo(toPath);
@@ -43,9 +62,9 @@ void CopyThread::run() {
             return;
         }
 
-        // Check if destination already exists
+        // Check if destination already exists; when resuming, it is what the interrupted run left behind
         QString toPath = toInfo.absoluteFilePath() + QDir::separator() + fromInfo.fileName();
-        if (QFileInfo(toPath).exists()) {
+        if (QFileInfo(toPath).exists() && !(journal && journal->isResumed())) {
             emit error(tr("Target already exists at the destination."));
             return;
         }
@@ -55,112 +74,92 @@ void CopyThread::run() {
             emit error(tr("Cannot create the target directory."));
             return;
         }
+    }
+
+    // The copy starts while the source trees are still being scanned
+    plan.start();
+    QString targetDir = QFileInfo(toPath).absoluteFilePath() + QDir::separator();
+    // The metadata of directories is copied once their contents are complete
+    QVector<QPair<QString, QString>> directories;
+    for (int i = 0; plan.waitForEntry(i); i++) {
+        if (isInterruptionRequested() || engine.isCanceled()) {
+            break;
+        }
+
+        const CopyPlan::Entry entry = plan.entry(i);
+        const QString fromPath = plan.sourcePath(entry);
+        const QString targetPath = targetDir + QFileInfo(fromPaths.at(entry.root)).fileName()
+                                   + plan.relativePath(entry);
 
-        // Handle symlinks
-        if (fromInfo.isSymLink()) {
-            QString symlinkTarget = fromInfo.symLinkTarget();
-            if (!QFile::link(symlinkTarget, toPath)) {
+        if (S_ISLNK(entry.mode)) {
+            // We must not write into the symlink target, so we recreate the link itself
+            if (journal && journal->isResumed() && QFileInfo(targetPath).isSymLink()) {
+                continue;
+            }
+            if (!QFile::link(plan.linkTarget(entry), targetPath)) {
+                engine.cancel();
+                engine.waitForDone();
                 emit error(tr("Failed to copy symbolic link."));
                 return;
-            } else {
-                // We must not write into the symlink target, so we skip it
-                continue;
             }
-        }
-
-        QString toSubdir = toDir.filePath(fromInfo.fileName());
-        if (fromInfo.isDir()) {
-            qDebug() << "Creating target subdirectory" << toSubdir;
-            if (!toDir.mkpath(toSubdir)) {
+            FileMetadata::copySymlink(fromPath, targetPath);
+        } else if (S_ISDIR(entry.mode)) {
+            if (!QDir().mkpath(targetPath)) {
+                engine.cancel();
+                engine.waitForDone();
                 emit error(tr("Cannot create the target subdirectory."));
                 return;
             }
+            directories.append(qMakePair(fromPath, targetPath));
+        } else if (S_ISREG(entry.mode)) {
+            // Files the interrupted run completed are skipped if they still have their full size
+            if (journal && journal->isCompleted(fromPath)) {
+                struct stat st;
+                if (::lstat(QFile::encodeName(targetPath).constData(), &st) == 0 && S_ISREG(st.st_mode)
+                    && st.st_size == entry.size) {
+                    engine.skipFile(entry.size);
+                    continue;
+                }
+            }
+            setCurrentFile(fromPath);
+            if (!engine.copyFile(fromPath, targetPath)) {
+                break;
+            }
+        } else {
+            qDebug() << "Skipping" << fromPath << "which is neither a file, a directory nor a symbolic link";
         }
+    }
 
-        if (fromInfo.isFile()) {
-            QString toFilePath = toInfo.absoluteFilePath() + QDir::separator() + fromInfo.fileName();
+    if (!plan.errorMessage().isEmpty() && !isInterruptionRequested()) {
+        engine.cancel();
+        engine.waitForDone();
+        emit error(plan.errorMessage());
+        return;
+    }
 
-            if (QFileInfo(toFilePath).exists()) {
-                emit error(tr("%1 already exists at the destination.").arg(fromInfo.fileName()));
-                return;
+    // Small files may still be being copied on the worker pool
+    if (!engine.waitForDone()) {
+        if (engine.isCanceled() || isInterruptionRequested()) {
+            qDebug() << "CopyThread: Interruption requested. Cleaning up and exiting...";
+        } else {
+            // Record the files that were copied before the error, so that a resume skips them
+            if (journal) {
+                journal->flush();
             }
+            emit error(engine.errorMessage());
+        }
+        return;
+    }
 
-            QFile sourceFile(fromPath);
-            QFile targetFile(toFilePath);
-
-            if (sourceFile.open(QIODevice::ReadOnly) && targetFile.open(QIODevice::WriteOnly)) {
-                char buffer[4096];
-
-                while (qint64 bytesRead = sourceFile.read(buffer, sizeof(buffer))) {
-                    qint64 bytesWritten = targetFile.write(buffer, bytesRead);
-                    copiedSize += bytesWritten;
-
-                    int percentage = static_cast<int>((copiedSize * 100) / totalSize);
-                    emit progress(percentage);
-
-                    if (isInterruptionRequested()) {
-                        qDebug() << "CopyThread: Interruption requested. Cleaning up and exiting...";
-                        targetFile.remove();
-                        return;
-                    }
-                }
-
-                sourceFile.close();
-                targetFile.close();
+    // The journal syncs the copies in groups; the last one is synced here, before the sources of a move are removed
+    if (journal && !journal->flush()) {
+        emit error(tr("Cannot write the copies to the disk."));
+        return;
+    }
 
-                // Set permissions
-                targetFile.setPermissions(sourceFile.permissions());
-            }
-        } else if (fromInfo.isDir()) {
-            QDirIterator it(fromPath, QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
-
-            while (it.hasNext()) {
-                it.next();
-                QString relativePath = it.filePath().mid(fromPath.size() + 1);
-                QString targetFilePath = toSubdir + QDir::separator() + relativePath;
-
-                if (it.fileInfo().isSymLink()) {
-                    // Handle symbolic link within subdirectory
-                    QString symlinkTarget = it.fileInfo().symLinkTarget();
-                    if (!QFile::link(symlinkTarget, targetFilePath)) {
-                        emit error(tr("Failed to copy symbolic link."));
-                        return;
-                    } else {
-                        // We must not write into the symlink target, so we skip it
-                        continue;
-                    }
-                } else if (QFileInfo(it.fileInfo()).isDir()) {
-                    QDir(targetFilePath).mkpath(".");
-                } else {
-                    QFile sourceFile(it.filePath());
-                    QFile targetFile(targetFilePath);
-
-                    if (sourceFile.open(QIODevice::ReadOnly) && targetFile.open(QIODevice::WriteOnly)) {
-                        char buffer[4096];
-
-                        while (qint64 bytesRead = sourceFile.read(buffer, sizeof(buffer))) {
-                            qint64 bytesWritten = targetFile.write(buffer, bytesRead);
-                            copiedSize += bytesWritten;
-
-                            int percentage = static_cast<int>((copiedSize * 100) / totalSize);
-                            emit progress(percentage);
-
-                            if (isInterruptionRequested()) {
-                                qDebug() << "CopyThread: Interruption requested. Cleaning up and exiting...";
-                                targetFile.remove();
-                                return;
-                            }
-                        }
-
-                        sourceFile.close();
-                        targetFile.close();
-
-                        // Set permissions
-                        targetFile.setPermissions(sourceFile.permissions());
-                    }
-                }
-            }
-        }
+    // Innermost first, so that setting the times of a directory is not undone by changes inside it
+    for (int i = directories.size() - 1; i >= 0; i--) {
+        FileMetadata::copyDirectory(directories.at(i).first, directories.at(i).second);
     }
 
     emit progress(100);
@@ -176,21 +175,39 @@ void CopyThread::run() {
     p.waitForFinished(-1);
 }
 
-qint64 CopyThread::calculateTotalSize() {
-    qint64 totalSize = 0;
+void CopyThread::setJournal(CopyJournal* journal) {
+    this->journal = journal;
+    engine.setJournal(journal);
+}
 
-    for (const QString& fromPath : fromPaths) {
-        QFileInfo fromInfo(fromPath);
-        if (fromInfo.isFile()) {
-            totalSize += fromInfo.size();
-        } else if (fromInfo.isDir()) {
-            QDirIterator it(fromPath, QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
-            while (it.hasNext()) {
-                it.next();
-                totalSize += QFileInfo(it.fileInfo()).size();
-            }
-        }
-    }
+void CopyThread::setVerify(bool verify) {
+    engine.setVerify(verify);
+}
+
+void CopyThread::setPaused(bool paused) {
+    engine.setPaused(paused);
+}
 
-    return totalSize;
-}
\ No newline at end of file
+void CopyThread::setCurrentFile(const QString& path) {
+    QMutexLocker locker(&currentFileMutex);
+    currentFile = path;
+}
+
+// Called by the progress timer on the main thread
+void CopyThread::publishProgress() {
+    QString file;
+    {
+        QMutexLocker locker(&currentFileMutex);
+        file = currentFile;
+    }
+    CopyProgress snapshot = aggregator.sample(engine.copiedBytes(), plan.totalSize(), engine.copiedFiles(),
+                                              plan.totalFiles(), plan.isFinished(), file);
+    emit progressChanged(snapshot);
+
+    // While the scan is running, the total grows; the percentage must not go backwards though
+    int percentage = snapshot.percentage();
+    if (percentage > lastPercentage) {
+        lastPercentage = percentage;
+        emit progress(percentage);
+    }
+}
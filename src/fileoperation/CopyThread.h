@@ -2,6 +2,12 @@
 #define COPYTHREAD_H
 
 #include <QThread>
+#include <QMutex>
+#include <QTimer>
+#include "CopyEngine.h"
+#include "CopyJournal.h"
+#include "CopyPlan.h"
+#include "ProgressAggregator.h"
 
 class CopyThread : public QThread {
     Q_OBJECT
@@ -9,8 +15,26 @@ class CopyThread : public QThread {
 public:
     CopyThread(const QStringList& fromPaths, const QString& toPath, QObject* parent = nullptr);
 
+    /**
+     * @brief Records the progress in a journal, and skips what it says has been copied already.
+     *
+     * Must be called before the thread is started.
+     */
+    void setJournal(CopyJournal* journal);
+
+    /**
+     * @brief Reads every copy back and compares it with the source. Must be called before the thread is started.
+     */
+    void setVerify(bool verify);
+
+    /**
+     * @brief Holds the copy until it is unpaused; the scan of the sources goes on. Thread-safe.
+     */
+    void setPaused(bool paused);
+
     signals:
         void progress(int value);
+        void progressChanged(const CopyProgress& progress);
         void copyFinished();
         void cancelCopyRequested();
         void error(const QString& errorMessage);
@@ -19,12 +43,21 @@ protected:
     void run() override;
 
 private:
-    qint64 calculateTotalSize();
-
-    const QStringList& fromPaths;
-    const QString& toPath;
-
-
+    void publishProgress();
+    void setCurrentFile(const QString& path);
+
+    const QStringList fromPaths;
+    const QString toPath;
+    CopyJournal* journal;
+    CopyPlan plan; ///< Declared before the engine so that it outlives the engine's worker threads.
+    CopyEngine engine;
+
+    // Progress is sampled by a timer on the main thread rather than reported for every chunk
+    QTimer progressTimer;
+    ProgressAggregator aggregator;
+    int lastPercentage;
+    QMutex currentFileMutex;
+    QString currentFile;
 };
 
 #endif // COPYTHREAD_H
\ No newline at end of file
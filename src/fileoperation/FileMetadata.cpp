@@ -0,0 +1,195 @@
+#include "FileMetadata.h"
+#include <QFile>
+#include <QDebug>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+#if defined(__linux__)
+#include <sys/xattr.h>
+#elif defined(__FreeBSD__)
+#include <sys/extattr.h>
+#endif
+
+namespace {
+
+// Extended attributes are copied in chunks of at least this size
+const int initialValueSize = 4096;
+
+#if defined(__linux__)
+// security.* holds SELinux labels and capabilities, which the target must get from its own context,
+// and system.* holds ACLs, which would have to be merged with the permissions
+bool isCopied(const char* name, bool privileged)
+{
+    if (strncmp(name, "user.", 5) == 0) {
+        return true;
+    }
+    return privileged && strncmp(name, "trusted.", 8) == 0;
+}
+#endif
+
+void copyOwner(int toFd, const struct stat& st)
+{
+    // Only root may give files away; failing that, keep at least the group if we are a member of it
+    if (fchown(toFd, st.st_uid, st.st_gid) != 0 && fchown(toFd, static_cast<uid_t>(-1), st.st_gid) != 0) {
+        // The copy belongs to us, just as with a plain cp
+        qDebug() << "Cannot keep the owner:" << strerror(errno);
+    }
+}
+
+}
+
+void FileMetadata::copy(int fromFd, int toFd, const struct stat& st) {
+    // Setting user attributes needs write permission, which the permissions copied below may take away
+    copyExtendedAttributes(fromFd, toFd);
+    // Changing the owner clears the setuid and setgid bits, so the permissions come after it
+    copyOwner(toFd, st);
+    if (fchmod(toFd, st.st_mode & 07777) != 0) {
+        qWarning() << "Cannot set permissions:" << strerror(errno);
+    }
+    const struct timespec times[2] = { st.st_atim, st.st_mtim };
+    if (futimens(toFd, times) != 0) {
+        qWarning() << "Cannot set times:" << strerror(errno);
+    }
+}
+
+void FileMetadata::copyDirectory(const QString& fromPath, const QString& toPath) {
+    const int flags = O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC;
+    int fromFd = ::open(QFile::encodeName(fromPath).constData(), flags);
+    if (fromFd < 0) {
+        qWarning() << "Cannot open" << fromPath << strerror(errno);
+        return;
+    }
+    int toFd = ::open(QFile::encodeName(toPath).constData(), flags);
+    if (toFd < 0) {
+        qWarning() << "Cannot open" << toPath << strerror(errno);
+        ::close(fromFd);
+        return;
+    }
+    struct stat st;
+    if (fstat(fromFd, &st) == 0) {
+        copy(fromFd, toFd, st);
+    }
+    ::close(toFd);
+    ::close(fromFd);
+}
+
+void FileMetadata::copySymlink(const QString& fromPath, const QString& toPath) {
+    const QByteArray toName = QFile::encodeName(toPath);
+    struct stat st;
+    if (::lstat(QFile::encodeName(fromPath).constData(), &st) != 0) {
+        qWarning() << "Cannot read" << fromPath << strerror(errno);
+        return;
+    }
+    // Symbolic links have no permissions of their own, and Linux allows no user attributes on them
+    if (lchown(toName.constData(), st.st_uid, st.st_gid) != 0
+        && lchown(toName.constData(), static_cast<uid_t>(-1), st.st_gid) != 0) {
+        qDebug() << "Cannot keep the owner of" << toPath << strerror(errno);
+    }
+    const struct timespec times[2] = { st.st_atim, st.st_mtim };
+    if (utimensat(AT_FDCWD, toName.constData(), times, AT_SYMLINK_NOFOLLOW) != 0) {
+        qWarning() << "Cannot set times of" << toPath << strerror(errno);
+    }
+}
+
+// Lists the attributes once and copies them one after the other with a buffer that is reused
+void FileMetadata::copyExtendedAttributes(int fromFd, int toFd) {
+    const bool privileged = geteuid() == 0;
+    QByteArray value(initialValueSize, Qt::Uninitialized);
+
+#if defined(__linux__)
+    QByteArray names;
+    for (;;) {
+        ssize_t size = flistxattr(fromFd, nullptr, 0);
+        if (size <= 0) {
+            // No attributes, or the file system does not support them
+            return;
+        }
+        names.resize(static_cast<int>(size));
+        size = flistxattr(fromFd, names.data(), static_cast<size_t>(names.size()));
+        if (size >= 0) {
+            names.resize(static_cast<int>(size));
+            break;
+        }
+        if (errno != ERANGE) {
+            return;
+        }
+        // An attribute was added in the meantime
+    }
+
+    const char* end = names.constData() + names.size();
+    for (const char* name = names.constData(); name < end; name += strlen(name) + 1) {
+        if (!isCopied(name, privileged)) {
+            continue;
+        }
+        ssize_t length = fgetxattr(fromFd, name, value.data(), static_cast<size_t>(value.size()));
+        if (length < 0 && errno == ERANGE) {
+            length = fgetxattr(fromFd, name, nullptr, 0);
+            if (length > 0) {
+                value.resize(static_cast<int>(length));
+                length = fgetxattr(fromFd, name, value.data(), static_cast<size_t>(value.size()));
+            }
+        }
+        if (length < 0) {
+            // Removed in the meantime
+            continue;
+        }
+        if (fsetxattr(toFd, name, value.constData(), static_cast<size_t>(length), 0) != 0) {
+            qWarning() << "Cannot copy the extended attribute" << name << strerror(errno);
+            if (errno == ENOTSUP) {
+                // The target file system does not support them at all
+                return;
+            }
+        }
+    }
+#elif defined(__FreeBSD__)
+    const int namespaces[] = { EXTATTR_NAMESPACE_USER, EXTATTR_NAMESPACE_SYSTEM };
+    const int namespaceCount = privileged ? 2 : 1;
+    for (int i = 0; i < namespaceCount; i++) {
+        const int attrNamespace = namespaces[i];
+        ssize_t size = extattr_list_fd(fromFd, attrNamespace, nullptr, 0);
+        if (size <= 0) {
+            continue;
+        }
+        QByteArray names(static_cast<int>(size), Qt::Uninitialized);
+        size = extattr_list_fd(fromFd, attrNamespace, names.data(), static_cast<size_t>(names.size()));
+        if (size < 0) {
+            continue;
+        }
+
+        // Each name is preceded by its length in one byte and not terminated
+        int position = 0;
+        while (position < size) {
+            const int nameLength = static_cast<unsigned char>(names.at(position));
+            const QByteArray name = names.mid(position + 1, nameLength);
+            position += 1 + nameLength;
+
+            ssize_t length = extattr_get_fd(fromFd, attrNamespace, name.constData(), nullptr, 0);
+            if (length < 0) {
+                continue;
+            }
+            if (length > value.size()) {
+                value.resize(static_cast<int>(length));
+            }
+            length = extattr_get_fd(fromFd, attrNamespace, name.constData(), value.data(), static_cast<size_t>(length));
+            if (length < 0) {
+                continue;
+            }
+            if (extattr_set_fd(toFd, attrNamespace, name.constData(), value.constData(),
+                               static_cast<size_t>(length)) < 0) {
+                qWarning() << "Cannot copy the extended attribute" << name << strerror(errno);
+                if (errno == EOPNOTSUPP) {
+                    return;
+                }
+            }
+        }
+    }
+#else
+    Q_UNUSED(fromFd)
+    Q_UNUSED(toFd)
+    Q_UNUSED(privileged)
+    Q_UNUSED(value)
+#endif
+}
@@ -0,0 +1,40 @@
+#ifndef FILEMETADATA_H
+#define FILEMETADATA_H
+
+#include <QString>
+#include <sys/stat.h>
+
+/**
+ * @brief Carries the metadata of a file over to its copy: extended attributes, ownership, permissions and times.
+ *
+ * Everything is done with a handful of system calls on open file descriptors, so that the metadata
+ * ends up on the file that was copied even if paths are renamed in the meantime. Extended attributes
+ * in the user namespace are always copied, since Filer keeps its own data there (see ExtendedAttributes);
+ * those in privileged namespaces only when running as root. Ownership is kept where the kernel permits it,
+ * i.e., as root, or at least the group if we are a member of it. The times are set last because
+ * everything else would change them.
+ */
+class FileMetadata {
+public:
+    /**
+     * @brief Copies the metadata of an open file. The contents must have been written completely.
+     * @param st The status of the source as returned by fstat(fromFd).
+     */
+    static void copy(int fromFd, int toFd, const struct stat& st);
+
+    /**
+     * @brief Copies the metadata of a directory. Must be called after its contents have been copied,
+     * since creating entries changes its modification time and it may not be writable.
+     */
+    static void copyDirectory(const QString& fromPath, const QString& toPath);
+
+    /**
+     * @brief Copies the ownership and times of a symbolic link, not of what it points to.
+     */
+    static void copySymlink(const QString& fromPath, const QString& toPath);
+
+private:
+    static void copyExtendedAttributes(int fromFd, int toFd);
+};
+
+#endif // FILEMETADATA_H
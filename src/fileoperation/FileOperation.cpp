@@ -0,0 +1,159 @@
+#include "FileOperation.h"
+#include "CopyManager.h"
+#include "MoveEngine.h"
+#include <QMessageBox>
+#include <QThread>
+#include <QTimer>
+#include <QDebug>
+
+FileOperation::FileOperation(QObject* parent)
+        : QObject(parent), verify(false), journaled(false), paused(false), canceled(false), copyManager(nullptr),
+          sourceRemover(nullptr) {
+}
+
+FileOperation::~FileOperation() {
+    // The thread uses the MoveEngine
+    if (sourceRemover) {
+        sourceRemover->wait();
+    }
+}
+
+void FileOperation::setVerify(bool verify) {
+    this->verify = verify;
+}
+
+bool FileOperation::copy(const QStringList& fromPaths, const QString& toPath) {
+    if (canceled) {
+        return false;
+    }
+    // Keep a journal so that the copy can be resumed if it gets interrupted
+    journaled = journal.create("copy", fromPaths, toPath);
+    startCopy(journaled ? journal.fromPaths() : fromPaths, toPath);
+    return true;
+}
+
+bool FileOperation::move(const QStringList& fromPaths, const QString& toPath) {
+    if (canceled) {
+        return false;
+    }
+    // Items on the same file system as the target are renamed; only the others are copied
+    mover.reset(new MoveEngine(fromPaths, toPath));
+    if (!mover->renameWithinDevice()) {
+        qWarning() << mover->errorMessage();
+        QMessageBox::critical(nullptr, tr("Error"), mover->errorMessage());
+        return false;
+    }
+    QStringList copyPaths = mover->crossDevicePaths();
+    if (copyPaths.isEmpty()) {
+        // Queued, so that the caller can start its event loop first
+        QTimer::singleShot(0, this, [this]() { emit finished(0); });
+        return true;
+    }
+
+    journaled = journal.create("move", copyPaths, toPath);
+    startCopy(journaled ? journal.fromPaths() : copyPaths, toPath);
+    return true;
+}
+
+bool FileOperation::resume(const QString& jobId) {
+    if (canceled) {
+        return false;
+    }
+    if (!journal.open(jobId)) {
+        QMessageBox::critical(nullptr, tr("Error"), tr("The job %1 cannot be resumed.").arg(jobId));
+        return false;
+    }
+    journaled = true;
+    qDebug() << "Resuming" << journal.operation() << "of" << journal.fromPaths() << "to" << journal.toPath();
+
+    if (journal.operation() == "move") {
+        // The interrupted run renamed what it could; everything in the journal was being copied
+        mover.reset(new MoveEngine(journal.fromPaths(), journal.toPath()));
+        mover->resumeCopy();
+    }
+    startCopy(journal.fromPaths(), journal.toPath());
+    return true;
+}
+
+void FileOperation::setPaused(bool paused) {
+    this->paused = paused;
+    if (copyManager) {
+        copyManager->setPaused(paused);
+    }
+}
+
+void FileOperation::cancel() {
+    canceled = true;
+    if (copyManager) {
+        copyManager->cancel();
+    }
+}
+
+void FileOperation::startCopy(const QStringList& fromPaths, const QString& toPath) {
+    copyManager = new CopyManager(this);
+    connect(copyManager, &CopyManager::copyFinished, this, [this]() { finish(0); });
+    connect(copyManager, &CopyManager::copyCanceled, this, [this]() { finish(1); });
+    connect(copyManager, &CopyManager::errorOccured, this, [this](const QString& errorMessage) {
+        QMessageBox::critical(nullptr, tr("Error"), errorMessage);
+        // A different result than for canceling, so that a move can tell the two apart
+        finish(2);
+    });
+    copyManager->copyWithProgress(fromPaths, toPath, journaled ? &journal : nullptr, verify);
+    copyManager->setPaused(paused);
+}
+
+void FileOperation::finish(int result) {
+    qDebug() << "Result:" << result;
+    if (mover) {
+        finishMove(result);
+        return;
+    }
+    if (result == 2 && journaled) {
+        qWarning() << "The copy can be resumed with: fileoperation --resume" << journal.jobId();
+    } else {
+        // Canceled copies are not resumed; the files that were copied completely are kept
+        journal.remove();
+    }
+    emit finished(result);
+}
+
+// Completes a move after the items on other file systems have been copied (or not)
+void FileOperation::finishMove(int result) {
+    if (result == 1) {
+        // Canceled; leave everything as it was
+        mover->rollback();
+        journal.remove();
+        emit finished(result);
+        return;
+    }
+    if (result != 0) {
+        // Failed, e.g., because the target was unplugged; keep what was copied so that the move can be resumed
+        qWarning() << "The move can be resumed with: fileoperation --resume" << journal.jobId();
+        emit finished(result);
+        return;
+    }
+    // Only remove the sources once we know that the copies match them. This walks and deletes
+    // whole trees, so it must not block the event loop of Filer
+    MoveEngine* moveEngine = mover.data();
+    sourceRemover = QThread::create([this, moveEngine]() {
+        bool verified = moveEngine->verifyAndRemoveSources();
+        QMetaObject::invokeMethod(this, [this, verified]() { finishSourceRemoval(verified); }, Qt::QueuedConnection);
+    });
+    sourceRemover->setParent(this);
+    sourceRemover->start();
+}
+
+void FileOperation::finishSourceRemoval(bool verified) {
+    sourceRemover->wait();
+    delete sourceRemover;
+    sourceRemover = nullptr;
+
+    journal.remove();
+    if (!verified) {
+        qWarning() << mover->errorMessage();
+        QMessageBox::critical(nullptr, tr("Error"), mover->errorMessage());
+        emit finished(2);
+        return;
+    }
+    emit finished(0);
+}
@@ -0,0 +1,86 @@
+#ifndef FILEOPERATION_H
+#define FILEOPERATION_H
+
+#include <QObject>
+#include <QScopedPointer>
+#include <QStringList>
+#include "CopyJournal.h"
+
+class CopyManager;
+class QThread;
+class MoveEngine;
+
+/**
+ * @brief A copy or move job with a progress dialog, run on a worker thread of the calling process.
+ *
+ * Filer runs the jobs it has permission for in-process; the fileoperation binary runs the same
+ * jobs through sudo for those that need root. Each job keeps a journal, so that it can be resumed
+ * with resume() (or `fileoperation --resume`) if it fails or gets interrupted.
+ */
+class FileOperation : public QObject {
+    Q_OBJECT
+
+public:
+    explicit FileOperation(QObject* parent = nullptr);
+    ~FileOperation();
+
+    /**
+     * @brief Reads every copy back and compares it with the source. Must be called before the job is started.
+     */
+    void setVerify(bool verify);
+
+    /**
+     * @brief Starts copying the paths into the target directory.
+     * @return False if the job could not be started; finished() is not emitted then.
+     */
+    bool copy(const QStringList& fromPaths, const QString& toPath);
+
+    /**
+     * @brief Moves the paths into the target directory. Items on the same file system are renamed right away.
+     * @return False if the job could not be started; finished() is not emitted then.
+     */
+    bool move(const QStringList& fromPaths, const QString& toPath);
+
+    /**
+     * @brief Continues a copy or move that was interrupted.
+     * @param jobId The name of the job as given by CopyJournal::jobId().
+     * @return False if the job could not be started; finished() is not emitted then.
+     */
+    bool resume(const QString& jobId);
+
+    /**
+     * @brief Holds the job, or lets it continue. May be called before the job is started.
+     */
+    void setPaused(bool paused);
+
+    /**
+     * @brief Stops the job; a copy keeps the files that were copied completely, a move is rolled back.
+     *
+     * If the job has not been started yet, it will not start.
+     */
+    void cancel();
+
+signals:
+    /**
+     * @brief Emitted when the job has ended.
+     * @param result 0 on success, 1 if it was canceled and 2 if an error occurred.
+     */
+    void finished(int result);
+
+private:
+    void startCopy(const QStringList& fromPaths, const QString& toPath);
+    void finish(int result);
+    void finishMove(int result);
+    void finishSourceRemoval(bool verified);
+
+    bool verify;
+    bool journaled;
+    bool paused;
+    bool canceled;
+    CopyJournal journal;
+    QScopedPointer<MoveEngine> mover; ///< Only for moves.
+    CopyManager* copyManager;
+    QThread* sourceRemover; ///< Verifies the copies of a move and removes the sources.
+};
+
+#endif // FILEOPERATION_H
@@ -0,0 +1,215 @@
+#include "MoveEngine.h"
+#include <QCoreApplication>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QDebug>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace {
+
+QString tr(const char* text)
+{
+    return QCoreApplication::translate("MoveEngine", text);
+}
+
+}
+
+MoveEngine::MoveEngine(const QStringList& fromPaths, const QString& toPath)
+        : fromPaths(fromPaths), toPath(QFileInfo(toPath).absoluteFilePath()) {
+}
+
+QString MoveEngine::targetPathFor(const QString& fromPath) const {
+    return toPath + QDir::separator() + QFileInfo(fromPath).fileName();
+}
+
+bool MoveEngine::renameWithinDevice() {
+    struct stat toStat;
+    if (::stat(QFile::encodeName(toPath).constData(), &toStat) != 0 || !S_ISDIR(toStat.st_mode)) {
+        error = tr("Target path must be a directory.");
+        return false;
+    }
+
+    for (const QString& fromPath : fromPaths) {
+        struct stat fromStat;
+        if (::lstat(QFile::encodeName(fromPath).constData(), &fromStat) != 0) {
+            error = tr("Source path does not exist or is not accessible.");
+            rollback();
+            return false;
+        }
+
+        QString targetPath = targetPathFor(fromPath);
+        const bool crossDevice = fromStat.st_dev != toStat.st_dev;
+        if (!crossDevice && renameNoReplace(fromPath, targetPath)) {
+            renamedPaths.append(qMakePair(fromPath, targetPath));
+            continue;
+        }
+
+        // Renaming fails with EXDEV, e.g., across different bind mounts of the same file system,
+        // before it checks whether the target exists
+        if (crossDevice || errno == EXDEV) {
+            // Checked here because rollback() removes the targets of cross-device items,
+            // so they must be ones this job creates
+            struct stat st;
+            if (::lstat(QFile::encodeName(targetPath).constData(), &st) == 0) {
+                error = tr("%1 already exists at the destination.").arg(QFileInfo(fromPath).fileName());
+                rollback();
+                return false;
+            }
+            copiedPaths.append(fromPath);
+            continue;
+        }
+
+        if (errno == EEXIST || errno == ENOTEMPTY) {
+            error = tr("%1 already exists at the destination.").arg(QFileInfo(fromPath).fileName());
+        } else if (errno == EINVAL) {
+            error = tr("Target path is a subdirectory of the source.");
+        } else {
+            error = tr("Cannot move %1: %2").arg(fromPath, QString::fromLocal8Bit(strerror(errno)));
+        }
+        rollback();
+        return false;
+    }
+    return true;
+}
+
+void MoveEngine::resumeCopy() {
+    renamedPaths.clear();
+    copiedPaths = fromPaths;
+}
+
+QStringList MoveEngine::crossDevicePaths() const {
+    return copiedPaths;
+}
+
+bool MoveEngine::verifyAndRemoveSources() {
+    for (const QString& fromPath : copiedPaths) {
+        if (!verifyCopy(fromPath, targetPathFor(fromPath))) {
+            if (error.isEmpty()) {
+                error = tr("The copy of %1 does not match the original.").arg(fromPath);
+            }
+            rollback();
+            return false;
+        }
+    }
+
+    for (const QString& fromPath : copiedPaths) {
+        if (!removeItem(fromPath)) {
+            // The copy is complete, so we keep it rather than rolling back
+            error = tr("Failed to delete %1 after copying it.").arg(fromPath);
+            qWarning() << "Failed to delete" << fromPath;
+            return false;
+        }
+    }
+    return true;
+}
+
+void MoveEngine::rollback() {
+    for (const QString& fromPath : copiedPaths) {
+        QString targetPath = targetPathFor(fromPath);
+        struct stat st;
+        if (::lstat(QFile::encodeName(targetPath).constData(), &st) == 0 && !removeItem(targetPath)) {
+            qWarning() << "Failed to remove the partial copy" << targetPath;
+        }
+    }
+
+    // Put renamed items back in reverse order
+    while (!renamedPaths.isEmpty()) {
+        QPair<QString, QString> renamed = renamedPaths.takeLast();
+        if (!renameNoReplace(renamed.second, renamed.first)) {
+            qWarning() << "Failed to move" << renamed.second << "back to" << renamed.first << strerror(errno);
+        }
+    }
+}
+
+QString MoveEngine::errorMessage() const {
+    return error;
+}
+
+// Checks that the copy has the same entries, types, file sizes and symlink targets as the source
+bool MoveEngine::verifyCopy(const QString& fromPath, const QString& toPath) {
+    QStringList relativePaths;
+    relativePaths.append(QString());
+
+    QFileInfo fromInfo(fromPath);
+    if (fromInfo.isDir() && !fromInfo.isSymLink()) {
+        QDirIterator it(fromPath, QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot,
+                        QDirIterator::Subdirectories);
+        while (it.hasNext()) {
+            relativePaths.append(it.next().mid(fromPath.size()));
+        }
+    }
+
+    for (const QString& relativePath : relativePaths) {
+        struct stat fromStat;
+        struct stat toStat;
+        QByteArray fromName = QFile::encodeName(fromPath + relativePath);
+        QByteArray toName = QFile::encodeName(toPath + relativePath);
+        if (::lstat(fromName.constData(), &fromStat) != 0) {
+            error = tr("Cannot read %1.").arg(fromPath + relativePath);
+            return false;
+        }
+        if (::lstat(toName.constData(), &toStat) != 0) {
+            error = tr("%1 is missing at the destination.").arg(fromPath + relativePath);
+            return false;
+        }
+        if ((fromStat.st_mode & S_IFMT) != (toStat.st_mode & S_IFMT)) {
+            return false;
+        }
+        if (S_ISREG(fromStat.st_mode) && fromStat.st_size != toStat.st_size) {
+            return false;
+        }
+        if (S_ISLNK(fromStat.st_mode) && readLink(fromName) != readLink(toName)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Returns the target of a symlink as stored, i.e., without making it absolute
+QByteArray MoveEngine::readLink(const QByteArray& path) {
+    QByteArray target(PATH_MAX, '\0');
+    ssize_t length = ::readlink(path.constData(), target.data(), target.size());
+    target.resize(length > 0 ? length : 0);
+    return target;
+}
+
+bool MoveEngine::renameNoReplace(const QString& fromPath, const QString& toPath) {
+    QByteArray fromName = QFile::encodeName(fromPath);
+    QByteArray toName = QFile::encodeName(toPath);
+#if defined(__linux__) && defined(RENAME_NOREPLACE)
+    if (renameat2(AT_FDCWD, fromName.constData(), AT_FDCWD, toName.constData(), RENAME_NOREPLACE) == 0) {
+        return true;
+    }
+    if (errno != ENOSYS && errno != EINVAL) {
+        return false;
+    }
+    // Older kernels and some file systems do not support RENAME_NOREPLACE
+#endif
+    struct stat st;
+    if (::lstat(toName.constData(), &st) == 0) {
+        errno = EEXIST;
+        return false;
+    }
+    return ::rename(fromName.constData(), toName.constData()) == 0;
+}
+
+// Removes a file, a symlink without following it, or a directory with its contents
+bool MoveEngine::removeItem(const QString& path) {
+    QByteArray name = QFile::encodeName(path);
+    struct stat st;
+    if (::lstat(name.constData(), &st) != 0) {
+        return false;
+    }
+    if (S_ISDIR(st.st_mode)) {
+        return QDir(path).removeRecursively();
+    }
+    return ::unlink(name.constData()) == 0;
+}
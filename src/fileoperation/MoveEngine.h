@@ -0,0 +1,67 @@
+#ifndef MOVEENGINE_H
+#define MOVEENGINE_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QPair>
+
+/**
+ * @brief Moves files and directories into a target directory.
+ *
+ * Items on the same file system as the target directory are renamed, which takes the same time
+ * regardless of their size. Only the remaining items need to be copied; once they have been,
+ * the copies are verified against the sources before any source is removed. If anything fails,
+ * rollback() puts renamed items back and removes the copies, so that a move either happens
+ * completely or not at all.
+ */
+class MoveEngine {
+public:
+    MoveEngine(const QStringList& fromPaths, const QString& toPath);
+
+    /**
+     * @brief Renames the items that are on the same file system as the target directory.
+     * @return False if an item could not be moved; the items renamed so far are put back.
+     */
+    bool renameWithinDevice();
+
+    /**
+     * @brief Continues a move whose copy was interrupted: all items are taken to be copied across devices.
+     */
+    void resumeCopy();
+
+    /**
+     * @brief The items that are on a different file system and need to be copied.
+     */
+    QStringList crossDevicePaths() const;
+
+    /**
+     * @brief Compares the copies of the cross-device items with their sources, then removes the sources.
+     *
+     * No source is removed unless all copies match; if one does not, the move is rolled back.
+     * @return False if a copy differs from its source or a source could not be removed.
+     */
+    bool verifyAndRemoveSources();
+
+    /**
+     * @brief Undoes the move: renamed items are put back and copies of cross-device items are removed.
+     */
+    void rollback();
+
+    QString errorMessage() const;
+
+private:
+    QString targetPathFor(const QString& fromPath) const;
+    bool verifyCopy(const QString& fromPath, const QString& toPath);
+    static QByteArray readLink(const QByteArray& path);
+    static bool renameNoReplace(const QString& fromPath, const QString& toPath);
+    static bool removeItem(const QString& path);
+
+    QStringList fromPaths;
+    QString toPath;
+    QList<QPair<QString, QString>> renamedPaths; ///< Source and target of each renamed item, in order.
+    QStringList copiedPaths; ///< Items that need to be copied.
+    QString error;
+};
+
+#endif // MOVEENGINE_H
@@ -0,0 +1,62 @@
+#include "ProgressAggregator.h"
+#include <QtGlobal>
+
+namespace {
+
+// The current throughput is averaged over this many milliseconds
+const qint64 throughputWindow = 3000;
+
+}
+
+int CopyProgress::percentage() const {
+    if (bytesTotal <= 0) {
+        return totalsKnown ? 100 : 0;
+    }
+    return static_cast<int>(qMin<qint64>((bytesDone * 100) / bytesTotal, 100));
+}
+
+ProgressAggregator::ProgressAggregator() {
+}
+
+void ProgressAggregator::start() {
+    elapsed.start();
+    samples.clear();
+}
+
+CopyProgress ProgressAggregator::sample(qint64 bytesDone, qint64 bytesTotal, int filesDone, int filesTotal,
+                                        bool totalsKnown, const QString& currentFile) {
+    CopyProgress progress;
+    progress.bytesDone = bytesDone;
+    progress.bytesTotal = bytesTotal;
+    progress.filesDone = filesDone;
+    progress.filesTotal = filesTotal;
+    progress.totalsKnown = totalsKnown;
+    progress.currentFile = currentFile;
+
+    if (!elapsed.isValid()) {
+        return progress;
+    }
+
+    const qint64 now = elapsed.elapsed();
+    samples.append(qMakePair(now, bytesDone));
+    while (samples.size() > 2 && now - samples.at(1).first >= throughputWindow) {
+        samples.removeFirst();
+    }
+
+    if (now > 0) {
+        progress.averageThroughput = bytesDone * 1000.0 / now;
+    }
+    const QPair<qint64, qint64>& oldest = samples.first();
+    if (now > oldest.first) {
+        progress.currentThroughput = (bytesDone - oldest.second) * 1000.0 / (now - oldest.first);
+    }
+
+    // Until the scan is complete, we do not know how much is left. The current throughput reacts to
+    // changes such as a full write cache quickly, but stalls briefly; then we go by the average
+    double throughput = progress.currentThroughput > 0 ? progress.currentThroughput : progress.averageThroughput;
+    if (totalsKnown && throughput > 0 && now >= 1000) {
+        progress.secondsRemaining = static_cast<qint64>((qMax<qint64>(bytesTotal - bytesDone, 0)) / throughput);
+    }
+
+    return progress;
+}
@@ -0,0 +1,55 @@
+#ifndef PROGRESSAGGREGATOR_H
+#define PROGRESSAGGREGATOR_H
+
+#include <QElapsedTimer>
+#include <QMetaType>
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+/**
+ * @brief A snapshot of the progress of a copy operation.
+ */
+struct CopyProgress {
+    qint64 bytesDone = 0;
+    qint64 bytesTotal = 0;         ///< Grows while the source trees are being scanned.
+    int filesDone = 0;
+    int filesTotal = 0;            ///< Grows while the source trees are being scanned.
+    bool totalsKnown = false;      ///< True once the scan is complete.
+    QString currentFile;
+    double currentThroughput = 0;  ///< Bytes per second over the last few seconds.
+    double averageThroughput = 0;  ///< Bytes per second since the start.
+    qint64 secondsRemaining = -1;  ///< -1 while unknown.
+
+    int percentage() const;
+};
+
+Q_DECLARE_METATYPE(CopyProgress)
+
+/**
+ * @brief Turns the counters of a copy operation into CopyProgress snapshots with throughput and ETA.
+ *
+ * Meant to be sampled by a timer at a fixed rate rather than for every chunk that is copied,
+ * so that the copy does not flood the event loop of the progress dialog.
+ */
+class ProgressAggregator {
+public:
+    ProgressAggregator();
+
+    /**
+     * @brief Starts measuring time; call when copying starts.
+     */
+    void start();
+
+    /**
+     * @brief Records the current counters and returns the snapshot to show.
+     */
+    CopyProgress sample(qint64 bytesDone, qint64 bytesTotal, int filesDone, int filesTotal, bool totalsKnown,
+                        const QString& currentFile);
+
+private:
+    QElapsedTimer elapsed;
+    QVector<QPair<qint64, qint64>> samples; ///< Elapsed milliseconds and bytes done, for the current throughput.
+};
+
+#endif // PROGRESSAGGREGATOR_H
@@ -0,0 +1,138 @@
+#include "Xxh64.h"
+#include <QtEndian>
+#include <cstring>
+
+namespace {
+
+const quint64 prime1 = 0x9E3779B185EBCA87ULL;
+const quint64 prime2 = 0xC2B2AE3D27D4EB4FULL;
+const quint64 prime3 = 0x165667B19E3779F9ULL;
+const quint64 prime4 = 0x85EBCA77C2B2AE63ULL;
+const quint64 prime5 = 0x27D4EB2F165667C5ULL;
+
+inline quint64 rotateLeft(quint64 value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+inline quint64 read64(const unsigned char* data)
+{
+    return qFromLittleEndian<quint64>(data);
+}
+
+inline quint32 read32(const unsigned char* data)
+{
+    return qFromLittleEndian<quint32>(data);
+}
+
+inline quint64 round(quint64 accumulator, quint64 input)
+{
+    accumulator += input * prime2;
+    accumulator = rotateLeft(accumulator, 31);
+    return accumulator * prime1;
+}
+
+inline quint64 mergeRound(quint64 hash, quint64 accumulator)
+{
+    hash ^= round(0, accumulator);
+    return hash * prime1 + prime4;
+}
+
+}
+
+Xxh64::Xxh64(quint64 seed) {
+    reset(seed);
+}
+
+void Xxh64::reset(quint64 seed) {
+    this->seed = seed;
+    accumulators[0] = seed + prime1 + prime2;
+    accumulators[1] = seed + prime2;
+    accumulators[2] = seed;
+    accumulators[3] = seed - prime1;
+    totalLength = 0;
+    bufferedLength = 0;
+}
+
+void Xxh64::update(const void* data, size_t length) {
+    const unsigned char* input = static_cast<const unsigned char*>(data);
+    const unsigned char* end = input + length;
+    totalLength += length;
+
+    if (bufferedLength + length < sizeof(buffer)) {
+        memcpy(buffer + bufferedLength, input, length);
+        bufferedLength += length;
+        return;
+    }
+
+    if (bufferedLength > 0) {
+        size_t missing = sizeof(buffer) - bufferedLength;
+        memcpy(buffer + bufferedLength, input, missing);
+        input += missing;
+        for (int i = 0; i < 4; i++) {
+            accumulators[i] = round(accumulators[i], read64(buffer + i * 8));
+        }
+        bufferedLength = 0;
+    }
+
+    // The four lanes are independent, so the CPU can work on them in parallel
+    quint64 v1 = accumulators[0];
+    quint64 v2 = accumulators[1];
+    quint64 v3 = accumulators[2];
+    quint64 v4 = accumulators[3];
+    while (end - input >= 32) {
+        v1 = round(v1, read64(input));
+        v2 = round(v2, read64(input + 8));
+        v3 = round(v3, read64(input + 16));
+        v4 = round(v4, read64(input + 24));
+        input += 32;
+    }
+    accumulators[0] = v1;
+    accumulators[1] = v2;
+    accumulators[2] = v3;
+    accumulators[3] = v4;
+
+    if (input < end) {
+        bufferedLength = static_cast<size_t>(end - input);
+        memcpy(buffer, input, bufferedLength);
+    }
+}
+
+quint64 Xxh64::digest() const {
+    quint64 hash;
+    if (totalLength >= 32) {
+        hash = rotateLeft(accumulators[0], 1) + rotateLeft(accumulators[1], 7)
+               + rotateLeft(accumulators[2], 12) + rotateLeft(accumulators[3], 18);
+        for (int i = 0; i < 4; i++) {
+            hash = mergeRound(hash, accumulators[i]);
+        }
+    } else {
+        hash = seed + prime5;
+    }
+    hash += totalLength;
+
+    const unsigned char* input = buffer;
+    const unsigned char* end = buffer + bufferedLength;
+    while (end - input >= 8) {
+        hash ^= round(0, read64(input));
+        hash = rotateLeft(hash, 27) * prime1 + prime4;
+        input += 8;
+    }
+    if (end - input >= 4) {
+        hash ^= static_cast<quint64>(read32(input)) * prime1;
+        hash = rotateLeft(hash, 23) * prime2 + prime3;
+        input += 4;
+    }
+    while (input < end) {
+        hash ^= (*input) * prime5;
+        hash = rotateLeft(hash, 11) * prime1;
+        input++;
+    }
+
+    hash ^= hash >> 33;
+    hash *= prime2;
+    hash ^= hash >> 29;
+    hash *= prime3;
+    hash ^= hash >> 32;
+    return hash;
+}
@@ -0,0 +1,30 @@
+#ifndef XXH64_H
+#define XXH64_H
+
+#include <QtGlobal>
+#include <cstddef>
+
+/**
+ * @brief The XXH64 hash by Yann Collet, computed incrementally.
+ *
+ * Not a cryptographic hash, but fast enough (several GB/s on one core) to check copies
+ * for corruption without slowing them down. Produces the same values as XXH64() of the
+ * reference implementation, so results can be checked with xxhsum -H64.
+ */
+class Xxh64 {
+public:
+    explicit Xxh64(quint64 seed = 0);
+
+    void reset(quint64 seed = 0);
+    void update(const void* data, size_t length);
+    quint64 digest() const;
+
+private:
+    quint64 seed;
+    quint64 accumulators[4];
+    quint64 totalLength;
+    unsigned char buffer[32]; ///< Input that does not fill a stripe of 32 bytes yet.
+    size_t bufferedLength;
+};
+
+#endif // XXH64_H
@@ -1,20 +1,14 @@
 #include <QApplication>
 #include <QCommandLineParser>
 #include <QDebug>
-#include <QStyle>
-#include <QDesktopWidget>
-#include <QTranslator>
-#include "MainWindow.h"
-#include <QMessageBox>
-#include <QFile>
-#include <QDir>
+#include "FileOperation.h"
 
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
     QApplication::setApplicationName("fileoperation");
-
-    QDesktopWidget desktop;
+    // The exit code comes from the job, not from closing its progress dialog
+    a.setQuitOnLastWindowClosed(false);
 
     QCommandLineParser parser;
     parser.setApplicationDescription("A command line tool for copying and moving files with a graphical progress dialog.");
@@ -24,12 +18,23 @@ int main(int argc, char *argv[])
     // Define custom options
     QCommandLineOption copyOption("copy", "Copy files.");
     QCommandLineOption moveOption("move", "Move files.");
+    QCommandLineOption resumeOption("resume", "Resume an interrupted copy or move.", "job");
+    QCommandLineOption verifyOption("verify", "Read every copied file back and compare it with the original.");
     parser.addOption(copyOption);
     parser.addOption(moveOption);
+    parser.addOption(resumeOption);
+    parser.addOption(verifyOption);
 
     // Process the command line arguments
     parser.process(a); // Use 'a' instead of 'app'
+    const bool verify = parser.isSet(verifyOption);
+
+    FileOperation operation;
+    operation.setVerify(verify);
+    // 0 on success, 1 if the user canceled and 2 if an error occurred
+    QObject::connect(&operation, &FileOperation::finished, &QCoreApplication::exit);
 
+    bool started;
     if (parser.isSet("copy")) {
         qDebug() << "Copying files...";
         QStringList args = parser.positionalArguments();
@@ -41,22 +46,7 @@ int main(int argc, char *argv[])
         args.removeLast(); // Remove the target path from the list
         qDebug() << "Source paths:" << args;
         qDebug() << "Target path:" << targetPath;
-
-        // Perform the copy operation
-        MainWindow w;
-        w.startCopyWithProgress(args, targetPath);
-
-        // Center the main window on the screen
-        w.setGeometry(
-                QStyle::alignedRect(
-                        Qt::LeftToRight,
-                        Qt::AlignCenter,
-                        w.size(),
-                        desktop.availableGeometry() // Get screen geometry
-                )
-        );
-
-        return a.exec();
+        started = operation.copy(args, targetPath);
     }
     else if (parser.isSet("move")) {
         qDebug() << "Moving files...";
@@ -69,46 +59,18 @@ int main(int argc, char *argv[])
         args.removeLast(); // Remove the target path from the list
         qDebug() << "Source paths:" << args;
         qDebug() << "Target path:" << targetPath;
-
-        // Perform the move operation
-        MainWindow w;
-        w.startCopyWithProgress(args, targetPath);
-        // Get the result of the operation
-        int result = a.exec();
-        qDebug() << "Result:" << result;
-        // If the result is 0, then the operation was successful
-        // TODO: We could do more checks here, e.g., if the target path exists,
-        // if its size matches the size of the source files, etc.
-        if (result == 0) {
-            QMessageBox::StandardButton reply = QMessageBox::question(
-                    nullptr,
-                    "Delete source files?",
-                    "Do you want to delete the following?\n\n" + args.join("\n"),
-                    QMessageBox::Yes | QMessageBox::No
-            );
-            if (reply == QMessageBox::Yes) {
-                qDebug() << "Deleting source files...";
-                // Recursively delete the source files
-                for (const QString &path : args) {
-                    QDir dir(path);
-                    if (dir.exists()) {
-                        dir.removeRecursively();
-                    }
-                    else {
-                        QFile file(path);
-                        if (file.exists()) {
-                            file.remove();
-                        }
-                    }
-                    if (QFile::exists(path)) {
-                        qWarning() << "Failed to delete" << path;
-                    }
-                }
-            }
-        }
+        started = operation.move(args, targetPath);
+    }
+    else if (parser.isSet("resume")) {
+        started = operation.resume(parser.value(resumeOption));
     }
     else {
-        qWarning() << "Please specify either --copy or --move.";
+        qWarning() << "Please specify either --copy, --move or --resume.";
+        return 1;
+    }
+
+    if (!started) {
         return 1;
     }
+    return a.exec();
 }